@@ -0,0 +1,719 @@
+/*
+ * Copyright (C) 2022 Keith Standiford
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Kernel benchmarks. Each benchmark takes BENCH_SAMPLES samples of one configuration and
+ * prints the minimum, median and 99th percentile as a line of CSV, between the lines
+ * "PICCOLO BENCHMARK BEGIN" and "PICCOLO BENCHMARK END", so the results of two builds
+ * can be captured from the console and compared. Lines starting with # are comments.
+ *
+ * Only the Piccolo OS and Pico SDK APIs are used, so the same suite runs wherever the kernel does.
+ */
+
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/sem.h"
+
+#include "kernel/kernel.h"
+
+#define BENCH_SAMPLES 101           // odd, so the median is one of the samples
+#define BENCH_BATCH 100             // operations timed together for one sample
+#define BENCH_CHURN 10              // tasks created and ended for one sample
+#define BENCH_SLEEP_US 1000         // how long each sleep in the jitter benchmark is
+#define BENCH_STACK 256             // stack size for the helper tasks
+#define BENCH_MAX_TASKS 64          // the most busy or periodic helper tasks any benchmark needs
+#define BENCH_MAX_BLOCKED 256       // the most blocked helper tasks, in the yield benchmark
+#define BENCH_MEDIA_TASKS 4         // periodic tasks in the deadline benchmark
+#define BENCH_MEDIA_PERIOD_US 4000  // their period, which is also their deadline
+#define BENCH_MEDIA_WORK_US 500     // the run time each of their jobs needs
+#define BENCH_MEDIA_BUDGET_US 800   // the run time each job is allowed in the EDF class
+#define BENCH_MEDIA_WINDOW_MS 20    // how long one sample of the deadline miss rate takes
+#define BENCH_TIMERS 256            // the most periodic jobs in the timer benchmark (up to BENCH_MAX_TASKS as tasks)
+#define BENCH_TIMER_PERIOD_US 4000  // their period
+#define BENCH_BURST 32              // interrupts in a burst in the deferred work benchmark
+#define BENCH_PAIRS 2               // producer and consumer pairs in the signal throughput benchmark
+#define BENCH_WINDOW_MS 5           // how long one sample of the signal throughput takes
+
+uint32_t samples[BENCH_SAMPLES];
+piccolo_os_task_t *blocked_tasks[BENCH_MAX_BLOCKED], *busy_tasks[BENCH_MAX_TASKS], *media_tasks[BENCH_MEDIA_TASKS];
+volatile bool stop;
+volatile bool media_edf;
+volatile uint32_t media_jobs[BENCH_MEDIA_TASKS], media_misses[BENCH_MEDIA_TASKS];
+absolute_time_t periodic_due[BENCH_TIMERS];
+uint32_t periodic_missed[BENCH_TIMERS];
+piccolo_timer_t periodic_timers[BENCH_TIMERS];
+volatile uint32_t periodic_samples;
+volatile uint32_t deferred_handled;
+uint32_t deferred_mailbox[PICCOLO_MAILBOX_BUFFER_SIZE(1, BENCH_BURST)];
+piccolo_os_task_t *producers[BENCH_PAIRS], *consumers[BENCH_PAIRS];
+volatile bool producers_stop;
+volatile uint32_t signals_received[BENCH_PAIRS];
+semaphore_t ping, pong;
+
+int compare_samples(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Sort the samples and print a CSV line: benchmark, configuration, unit, samples, min, median, p99
+ */
+void report(const char *benchmark, const char *configuration, const char *unit) {
+    qsort(samples, BENCH_SAMPLES, sizeof(samples[0]), compare_samples);
+    printf("%s,%s,%s,%d,%lu,%lu,%lu\n", benchmark, configuration, unit, BENCH_SAMPLES,
+        samples[0], samples[BENCH_SAMPLES / 2], samples[(BENCH_SAMPLES * 99 + 99) / 100 - 1]);
+}
+
+/*
+ * Time of a batch of operations since `start`, in nanoseconds per operation
+ */
+uint32_t batch_ns(uint32_t start) {
+    return (time_us_32() - start) * 1000 / BENCH_BATCH;
+}
+
+/*
+ * Start `count` helper tasks running `function`, and let them get going (or block).
+ * Returns how many could be created.
+ */
+int start_helpers(void (*function)(void *), piccolo_os_task_t **tasks, int count) {
+    int created;
+
+    for(created = 0; created < count; created++)
+        if(!(tasks[created] = piccolo_create_task_ex(function, NULL, BENCH_STACK, "bench"))) break;
+    if(created < count) printf("# out of memory creating %d tasks\n", count);
+    piccolo_sleep(10);
+    return created;
+}
+
+/*
+ * Stop the helper tasks, sending each a signal in case it is waiting for one, and let them end
+ */
+void stop_helpers(piccolo_os_task_t **tasks, int count) {
+    stop = true;
+    for(int i = 0; i < count; i++) piccolo_send_signal(tasks[i]);
+    piccolo_sleep(10);
+    stop = false;
+}
+
+/*
+ * How many tasks have ended so far
+ */
+uint32_t tasks_ended(void) {
+    piccolo_os_pool_statistics_t pool;
+    uint32_t ended = 0;
+
+    for(int size_class = 0; size_class < PICCOLO_OS_POOL_CLASSES; size_class++) {
+        piccolo_get_pool_statistics(size_class, &pool);
+        ended += pool.reclaimed;
+    }
+    return ended;
+}
+
+void yielder(void *argument) {
+    while(!stop) piccolo_yield();
+}
+
+void spinner(void *argument) {
+    while(!stop) tight_loop_contents();
+}
+
+void blocker(void *argument) {
+    piccolo_get_signal_blocking();
+}
+
+void ender(void *argument) {
+}
+
+void signal_partner(void *argument) {
+    piccolo_os_task_t *pinger = (piccolo_os_task_t *) argument;
+
+    while(1) {
+        piccolo_get_signal_blocking();
+        if(stop) return;
+        piccolo_send_signal(pinger);
+    }
+}
+
+uint32_t lite_signal_partner(piccolo_lite_task_t *lite) {
+    PICCOLO_LITE_BEGIN(lite);
+    while(1) {
+        PICCOLO_LITE_WAIT_SIGNAL(lite, 0);
+        piccolo_lite_get_signal(lite);
+        if(stop) break;
+        piccolo_send_signal((piccolo_os_task_t *) lite->argument);
+    }
+    PICCOLO_LITE_END(lite);
+}
+
+void semaphore_partner(void *argument) {
+    while(1) {
+        sem_acquire_blocking(&ping);
+        if(stop) return;
+        sem_release(&pong);
+    }
+}
+
+/*
+ * A pair in the signal throughput benchmark. The producer sends its consumer signals as fast as the
+ * consumer's signal channel takes them, and the consumer counts them. The argument is the pair.
+ */
+void producer(void *argument) {
+    piccolo_os_task_t *consumer = consumers[(uintptr_t) argument];
+
+    while(!producers_stop) piccolo_send_signal_blocking(consumer);
+}
+
+void consumer(void *argument) {
+    int32_t received;
+
+    while(1) {
+        received = piccolo_get_signal_all_blocking();
+        if(stop) return;
+        signals_received[(uintptr_t) argument] += received;
+    }
+}
+
+/*
+ * How long the calling task has run, by the kernel's own accounting. (With interrupts disabled, so
+ * it is not switched out between reading its total and the start of the slice it is in.)
+ */
+uint64_t run_time_us(void) {
+    piccolo_os_task_t *task = piccolo_get_task_id();
+    uint32_t interrupts = save_and_disable_interrupts();
+    uint64_t run_us = task->statistics.run_us + (time_us_32() - task->switched_at);
+
+    restore_interrupts(interrupts);
+    return run_us;
+}
+
+/*
+ * Burn `us` microseconds of the calling task's run time. Time spent switched out does not count,
+ * and neither does the speed of the loop, which depends on what the other core is doing.
+ */
+void work(uint32_t us) {
+    uint64_t until = run_time_us() + us;
+
+    while(run_time_us() < until) tight_loop_contents();
+}
+
+/*
+ * A periodic task: each period, a job of BENCH_MEDIA_WORK_US which must be done by the end of the period.
+ * It keeps its own schedule, and counts the jobs done late. In the EDF class it waits for its next
+ * release with `piccolo_edf_wait()`, otherwise it sleeps until then.
+ */
+void media_task(void *argument) {
+    int index = (uintptr_t) argument;
+    bool edf = media_edf;
+    absolute_time_t release, now;
+
+    if(edf && !piccolo_set_edf(piccolo_get_task_id(), BENCH_MEDIA_PERIOD_US, BENCH_MEDIA_BUDGET_US, 0)) {
+        printf("# media task %d not admitted to the EDF class\n", index);
+        edf = false;
+    }
+    release = get_absolute_time();
+    while(!stop) {
+        work(BENCH_MEDIA_WORK_US);
+        now = get_absolute_time();
+        if(absolute_time_diff_us(delayed_by_us(release, BENCH_MEDIA_PERIOD_US), now) > 0) media_misses[index]++;
+        media_jobs[index]++;
+        // the same release times as the kernel's, including starting again after falling a period behind
+        release = delayed_by_us(release, BENCH_MEDIA_PERIOD_US);
+        if(absolute_time_diff_us(release, now) >= BENCH_MEDIA_PERIOD_US) release = now;
+        if(edf) piccolo_edf_wait();
+        else piccolo_sleep_until(release);
+    }
+}
+
+/*
+ * A periodic job of the timer benchmark has come due: take a sample of how late it is. Run by a timer
+ * callback, or by a task doing the same job with piccolo_sleep_until().
+ */
+void periodic_job(absolute_time_t due) {
+    int64_t late = absolute_time_diff_us(due, get_absolute_time());
+    uint32_t sample = __atomic_fetch_add(&periodic_samples, 1, __ATOMIC_RELAXED);
+
+    if(sample < BENCH_SAMPLES) samples[sample] = late > 0 ? late : 0;
+}
+
+/*
+ * The timer is already set for its next expiry, past any periods it missed, so the one which has come due
+ * is that many periods back
+ */
+void periodic_callback(piccolo_timer_t *timer) {
+    int index = (uintptr_t) timer->argument;
+    uint32_t periods = 1 + timer->missed - periodic_missed[index];
+
+    periodic_missed[index] = timer->missed;
+    periodic_job(from_us_since_boot(to_us_since_boot(timer->expiry.deadline) - (uint64_t) periods * timer->period_us));
+}
+
+/* Like a periodic timer, the task skips the periods it has missed */
+void periodic_task(void *argument) {
+    absolute_time_t due = periodic_due[(uintptr_t) argument];
+    int64_t late;
+
+    while(!stop) {
+        piccolo_sleep_until(due);
+        periodic_job(due);
+        due = delayed_by_us(due, BENCH_TIMER_PERIOD_US);
+        if((late = absolute_time_diff_us(due, get_absolute_time())) >= 0)
+            due = delayed_by_us(due, (uint64_t) (late / BENCH_TIMER_PERIOD_US + 1) * BENCH_TIMER_PERIOD_US);
+    }
+}
+
+/*
+ * The other half of an interrupt service handler in the deferred work benchmark, run by a worker task
+ * or by a handler task which gets the data in messages
+ */
+void deferred_work(void *argument, const void *payload) {
+    deferred_handled += *(const uint32_t *) payload;
+}
+
+void message_handler(void *argument) {
+    uint32_t message;
+
+    while(1) {
+        piccolo_get_message_blocking(&message);
+        if(stop) return;
+        deferred_handled += message;
+    }
+}
+
+/*
+ * Pin the benchmark task to the core it is on, and give the affinity for a partner task on
+ * the same core, or on the other one. Without multi-core the other one can't be used.
+ */
+uint32_t partner_affinity(bool cross_core) {
+    uint core = get_core_num();
+
+    piccolo_set_affinity(piccolo_get_task_id(), 1u << core);
+    return 1u << (core ^ cross_core);
+}
+
+/*
+ * Yield latency with 1, 2 and 4 tasks yielding (the benchmark is one) and 0, 16, 64 and 256 tasks
+ * blocked on their signal channels. The scheduler only looks at the ready queues, so the number
+ * blocked should not matter. Then the same through the scheduler loop rather than the fast switch.
+ */
+void yield_benchmark(void) {
+    static const int ready_counts[] = {1, 2, 4};
+    static const int blocked_counts[] = {0, 16, 64, 256};
+    char configuration[48];
+    int ready, blocked, yielders, blockers, fast, sample, i;
+    uint32_t start;
+
+    for(fast = 1; fast >= 0; fast--) {
+        piccolo_fast_switch(fast);
+        for(ready = 0; ready < count_of(ready_counts); ready++)
+            for(blocked = 0; blocked < count_of(blocked_counts); blocked++) {
+                // only the whole matrix with the fast switch, it is the usual case
+                if(!fast && blocked) continue;
+                blockers = start_helpers(blocker, blocked_tasks, blocked_counts[blocked]);
+                yielders = start_helpers(yielder, busy_tasks, ready_counts[ready] - 1);
+                for(sample = 0; sample < BENCH_SAMPLES; sample++) {
+                    start = time_us_32();
+                    for(i = 0; i < BENCH_BATCH; i++) piccolo_yield();
+                    samples[sample] = batch_ns(start);
+                }
+                snprintf(configuration, sizeof(configuration), "ready %d blocked %d%s",
+                    yielders + 1, blockers, fast ? "" : " scheduler loop");
+                report("yield", configuration, "ns");
+                stop_helpers(busy_tasks, yielders);
+                stop_helpers(blocked_tasks, blockers);
+            }
+    }
+    piccolo_fast_switch(true);
+}
+
+/*
+ * Signal round trip: send a signal to a partner task, which sends one back. The partner is
+ * pinned to the same core as the benchmark, then to the other core.
+ */
+void signal_benchmark(void) {
+    piccolo_os_task_t *partner;
+    int cross, sample, i;
+    uint32_t start;
+
+    for(cross = 0; cross <= 1; cross++) {
+        if(!(partner = piccolo_create_task_on(signal_partner, piccolo_get_task_id(), BENCH_STACK, "bench",
+                                              partner_affinity(cross)))) {
+            printf("# no partner task %s\n", cross ? "on the other core" : "");
+            continue;
+        }
+        for(sample = 0; sample < BENCH_SAMPLES; sample++) {
+            start = time_us_32();
+            for(i = 0; i < BENCH_BATCH; i++) {
+                piccolo_send_signal(partner);
+                piccolo_get_signal_blocking();
+            }
+            samples[sample] = batch_ns(start);
+        }
+        report("signal round trip", cross ? "cross core" : "same core", "ns");
+        stop_helpers(&partner, 1);
+    }
+    piccolo_set_affinity(piccolo_get_task_id(), PICCOLO_AFFINITY_ANY);
+}
+
+/*
+ * Signal round trip between the benchmark task and a lightweight task, on the same core and on the
+ * other one. The lightweight task runs on its core's runner task, so each way is a switch to the
+ * runner and a call of the lightweight task's function.
+ */
+void lite_benchmark(void) {
+    piccolo_lite_task_t partner;
+    int cross, sample, i;
+    uint32_t start;
+
+    for(cross = 0; cross <= 1; cross++) {
+        if(!piccolo_lite_create_on(&partner, lite_signal_partner, piccolo_get_task_id(), partner_affinity(cross))) {
+            printf("# no lightweight partner task %s\n", cross ? "on the other core" : "");
+            continue;
+        }
+        for(sample = 0; sample < BENCH_SAMPLES; sample++) {
+            start = time_us_32();
+            for(i = 0; i < BENCH_BATCH; i++) {
+                piccolo_lite_send_signal(&partner);
+                piccolo_get_signal_blocking();
+            }
+            samples[sample] = batch_ns(start);
+        }
+        report("lite signal round trip", cross ? "cross core" : "same core", "ns");
+        stop = true;
+        piccolo_lite_send_signal(&partner);
+        piccolo_sleep(10);
+        stop = false;
+    }
+    piccolo_set_affinity(piccolo_get_task_id(), PICCOLO_AFFINITY_ANY);
+}
+
+/*
+ * Semaphore handoff: release a semaphore a partner task is waiting on, then wait for it
+ * to release another. Two handoffs per round trip. Same core, then cross core, as for signals.
+ */
+void semaphore_benchmark(void) {
+    int cross, sample, i;
+    uint32_t start;
+
+    for(cross = 0; cross <= 1; cross++) {
+        sem_init(&ping, 0, 1);
+        sem_init(&pong, 0, 1);
+        if(!piccolo_create_task_on(semaphore_partner, NULL, BENCH_STACK, "bench", partner_affinity(cross))) {
+            printf("# no partner task %s\n", cross ? "on the other core" : "");
+            continue;
+        }
+        for(sample = 0; sample < BENCH_SAMPLES; sample++) {
+            start = time_us_32();
+            for(i = 0; i < BENCH_BATCH; i++) {
+                sem_release(&ping);
+                sem_acquire_blocking(&pong);
+            }
+            samples[sample] = batch_ns(start);
+        }
+        report("semaphore round trip", cross ? "cross core" : "same core", "ns");
+        stop = true;
+        sem_release(&ping);
+        piccolo_sleep(10);
+        stop = false;
+    }
+    piccolo_set_affinity(piccolo_get_task_id(), PICCOLO_AFFINITY_ANY);
+}
+
+/*
+ * Task churn: create tasks which end at once, and wait for them all to end
+ */
+void churn_benchmark(void) {
+    int sample, i;
+    uint32_t start, ended;
+
+    for(sample = 0; sample < BENCH_SAMPLES; sample++) {
+        ended = tasks_ended();
+        start = time_us_32();
+        for(i = 0; i < BENCH_CHURN; i++)
+            if(!piccolo_create_task_ex(ender, NULL, BENCH_STACK, "bench")) {
+                printf("# out of memory\n");
+                return;
+            }
+        while(tasks_ended() - ended < BENCH_CHURN) piccolo_yield();
+        samples[sample] = (time_us_32() - start) * 1000 / BENCH_CHURN;
+    }
+    report("task create and end", "batches of 10", "ns");
+}
+
+/*
+ * Sleep jitter: how late a task wakes from a short sleep, with the cores idle and with tasks
+ * which never yield keeping them busy. Then with the benchmark task at a higher priority than
+ * the busy tasks, when it should not matter how many there are.
+ */
+void sleep_benchmark(void) {
+    static const int busy_counts[] = {0, 2, 4};
+    char configuration[48];
+    absolute_time_t deadline;
+    int64_t late;
+    int busy, spinners, raised, sample;
+
+    for(busy = 0; busy < count_of(busy_counts); busy++) {
+        spinners = start_helpers(spinner, busy_tasks, busy_counts[busy]);
+        for(raised = 0; raised <= (spinners ? 1 : 0); raised++) {
+            piccolo_set_priority(piccolo_get_task_id(), PICCOLO_OS_DEFAULT_PRIORITY + raised);
+            for(sample = 0; sample < BENCH_SAMPLES; sample++) {
+                deadline = delayed_by_us(get_absolute_time(), BENCH_SLEEP_US);
+                piccolo_sleep_until(deadline);
+                late = absolute_time_diff_us(deadline, get_absolute_time());
+                samples[sample] = late > 0 ? late : 0;
+            }
+            if(spinners) snprintf(configuration, sizeof(configuration), "%d busy tasks%s",
+                spinners, raised ? " higher priority" : "");
+            else snprintf(configuration, sizeof(configuration), "idle");
+            report("sleep wakeup late", configuration, "us");
+        }
+        piccolo_set_priority(piccolo_get_task_id(), PICCOLO_OS_DEFAULT_PRIORITY);
+        stop_helpers(busy_tasks, spinners);
+    }
+}
+
+/*
+ * Deadline misses: BENCH_MEDIA_TASKS periodic tasks, as best effort tasks and in the EDF class, with the cores
+ * idle and with tasks which never yield keeping them busy. Each sample is the percentage of the jobs done late
+ * in one window. Best effort tasks share the cores with the busy tasks, a time slice each, so they miss
+ * more as there are more busy tasks. EDF tasks run ahead of them, within a budget the work fits in, so on
+ * the device they should not miss. In the host simulation both cores share the host's CPUs with everything
+ * else, and a late SIGALRM or wakeup is late for every task, so expect some misses there even for EDF.
+ */
+void deadline_benchmark(void) {
+    static const int busy_counts[] = {0, 2, 4};
+    static piccolo_os_task_info_t info[BENCH_MEDIA_TASKS + BENCH_MAX_TASKS];
+    char configuration[48];
+    uint32_t jobs, misses, overruns, tasks;
+    int busy, spinners, edf, sample, i, j, created;
+
+    piccolo_set_priority(piccolo_get_task_id(), PICCOLO_OS_DEFAULT_PRIORITY + 1);   // keep the windows on time
+    for(busy = 0; busy < count_of(busy_counts); busy++) {
+        for(edf = 0; edf < 2; edf++) {
+            spinners = start_helpers(spinner, busy_tasks, busy_counts[busy]);
+            media_edf = edf;
+            for(created = 0; created < BENCH_MEDIA_TASKS; created++) {
+                media_jobs[created] = media_misses[created] = 0;
+                if(!(media_tasks[created] = piccolo_create_task_ex(media_task, (void *) (uintptr_t) created,
+                                                                   BENCH_STACK, "media"))) break;
+            }
+            piccolo_sleep(10);
+            for(sample = 0; sample < BENCH_SAMPLES; sample++) {
+                for(jobs = misses = 0, i = 0; i < created; i++) {
+                    jobs -= media_jobs[i];
+                    misses -= media_misses[i];
+                }
+                piccolo_sleep(BENCH_MEDIA_WINDOW_MS);
+                for(i = 0; i < created; i++) {
+                    jobs += media_jobs[i];
+                    misses += media_misses[i];
+                }
+                samples[sample] = jobs ? misses * 100 / jobs : 100;
+            }
+            snprintf(configuration, sizeof(configuration), "%s %d busy tasks", edf ? "EDF" : "best effort", spinners);
+            report("deadline missed", configuration, "%");
+            if(edf) {
+                // and what the kernel counted
+                tasks = piccolo_get_task_info(info, count_of(info));
+                if(tasks > count_of(info)) tasks = count_of(info);
+                for(overruns = misses = 0, i = 0; i < created; i++)
+                    for(j = 0; j < tasks; j++) if(info[j].task == media_tasks[i]) {
+                        overruns += info[j].statistics.edf_overruns;
+                        misses += info[j].statistics.edf_misses;
+                    }
+                printf("# EDF kernel counts: %lu deadline misses, %lu budget overruns\n", misses, overruns);
+            }
+            stop_helpers(media_tasks, created);
+            stop_helpers(busy_tasks, spinners);
+        }
+    }
+    piccolo_set_priority(piccolo_get_task_id(), PICCOLO_OS_DEFAULT_PRIORITY);
+}
+
+/*
+ * Periodic jobs as software timers, and as one task per job, with the cores idle and with two tasks which
+ * never yield keeping them busy. The jobs are spread evenly over the period. Each sample is how late one job
+ * came due. Both skip the periods a job has missed, so a job is only ever sampled against the due time it ran for. The tasks get the timer task's priority, so only the way the jobs are run differs. There is only
+ * room for BENCH_MAX_TASKS tasks; how many of each fit in some memory is printed as a comment.
+ */
+void timer_benchmark(void) {
+    static const int job_counts[] = {1, 16, 64, BENCH_TIMERS};
+    static const int busy_counts[] = {0, 2};
+    char configuration[48];
+    absolute_time_t start;
+    int jobs, busy, tasks, spinners, created, i;
+
+    printf("# a periodic job takes %d bytes as a software timer, %d as a task with a %d byte stack: %d or %d in 16 KB\n",
+        (int) sizeof(piccolo_timer_t), (int) (sizeof(piccolo_os_task_t) + BENCH_STACK), BENCH_STACK,
+        (int) (16384 / sizeof(piccolo_timer_t)), (int) (16384 / (sizeof(piccolo_os_task_t) + BENCH_STACK)));
+    piccolo_set_priority(piccolo_get_task_id(), PICCOLO_OS_TIMER_PRIORITY);     // start them all on time
+    for(jobs = 0; jobs < count_of(job_counts); jobs++) {
+        for(busy = 0; busy < count_of(busy_counts); busy++) {
+            for(tasks = 0; tasks < (job_counts[jobs] <= BENCH_MAX_TASKS ? 2 : 1); tasks++) {
+                spinners = start_helpers(spinner, busy_tasks, busy_counts[busy]);
+                start = make_timeout_time_us(BENCH_TIMER_PERIOD_US);
+                for(created = 0; created < job_counts[jobs]; created++) {
+                    periodic_due[created] = delayed_by_us(start, created * BENCH_TIMER_PERIOD_US / job_counts[jobs]);
+                    if(tasks) {
+                        if(!(blocked_tasks[created] = piccolo_create_task_ex(periodic_task, (void *) (uintptr_t) created,
+                                                                             BENCH_STACK, "periodic"))) break;
+                        piccolo_set_priority(blocked_tasks[created], PICCOLO_OS_TIMER_PRIORITY);
+                    }
+                    else {
+                        if(!piccolo_timer_create(&periodic_timers[created], periodic_callback, (void *) (uintptr_t) created)) break;
+                        periodic_missed[created] = 0;
+                        piccolo_timer_start(&periodic_timers[created],
+                            absolute_time_diff_us(get_absolute_time(), periodic_due[created]), BENCH_TIMER_PERIOD_US);
+                    }
+                }
+                piccolo_sleep(2 * BENCH_TIMER_PERIOD_US / 1000);    // settle, then take the samples
+                periodic_samples = 0;
+                while(periodic_samples < BENCH_SAMPLES) piccolo_sleep(1);
+                if(tasks) stop_helpers(blocked_tasks, created);
+                else for(i = 0; i < created; i++) piccolo_timer_stop(&periodic_timers[i]);
+                snprintf(configuration, sizeof(configuration), "%d %s%s", created, tasks ? "tasks" : "timers",
+                    spinners ? " 2 busy tasks" : "");
+                report("periodic job late", configuration, "us");
+                stop_helpers(busy_tasks, spinners);
+            }
+        }
+    }
+    piccolo_set_priority(piccolo_get_task_id(), PICCOLO_OS_DEFAULT_PRIORITY);
+}
+
+/*
+ * Interrupt service handlers handing a word of data to a task: in a message to a handler task, and as
+ * deferred work. A burst of BENCH_BURST handlers runs back to back with interrupts disabled, as they
+ * would be while the handlers run. Each sample is the time interrupts are disabled for per handler, then
+ * the time per handler from the start of the burst until its work has all been done. The handler task
+ * has the same priority and core as the worker.
+ */
+void deferred_benchmark(void) {
+    piccolo_os_work_statistics_t before, after;
+    piccolo_os_task_t *handler;
+    uint32_t interrupts, start, one = 1, batches[BENCH_SAMPLES];
+    int work, sample, i;
+
+    if(!piccolo_work_start()) {
+        printf("# no worker tasks\n");
+        return;
+    }
+    for(work = 0; work < 2; work++) {
+        if(!work) {
+            if(!(handler = piccolo_create_task_on(message_handler, NULL, BENCH_STACK, "handler", partner_affinity(false)))) {
+                printf("# no handler task\n");
+                continue;
+            }
+            piccolo_set_mailbox(handler, deferred_mailbox, sizeof(uint32_t), BENCH_BURST);
+            piccolo_set_priority(handler, PICCOLO_OS_WORK_PRIORITY);
+        }
+        else piccolo_set_affinity(piccolo_get_task_id(), 1u << get_core_num());
+        piccolo_get_work_statistics(get_core_num(), &before);
+        for(sample = 0; sample < BENCH_SAMPLES; sample++) {
+            deferred_handled = 0;
+            interrupts = save_and_disable_interrupts();
+            start = time_us_32();
+            for(i = 0; i < BENCH_BURST; i++) {
+                if(work) piccolo_work_post(deferred_work, NULL, &one, sizeof(one));
+                else piccolo_send_message(handler, &one);
+            }
+            samples[sample] = (time_us_32() - start) * 1000 / BENCH_BURST;
+            restore_interrupts(interrupts);
+            while(deferred_handled < BENCH_BURST) piccolo_yield();
+            batches[sample] = (time_us_32() - start) * 1000 / BENCH_BURST;
+        }
+        report("interrupts disabled per handler", work ? "deferred work" : "message to task", "ns");
+        for(sample = 0; sample < BENCH_SAMPLES; sample++) samples[sample] = batches[sample];
+        report("burst handled per handler", work ? "deferred work" : "message to task", "ns");
+        if(work) {
+            piccolo_get_work_statistics(get_core_num(), &after);
+            printf("# deferred work: %lu posted, %lu dropped, %lu batches, %lu worker wakeups\n",
+                after.posted - before.posted, after.dropped - before.dropped, after.batches - before.batches,
+                after.wakeups - before.wakeups);
+        }
+        else stop_helpers(&handler, 1);
+    }
+    piccolo_set_affinity(piccolo_get_task_id(), PICCOLO_AFFINITY_ANY);
+}
+
+/*
+ * Signal throughput: BENCH_PAIRS producers each send signals to their own consumer, and each sample
+ * is the signals received by all the consumers per millisecond over BENCH_WINDOW_MS. Every pair on one
+ * core, one pair per core, then one pair per core with each producer sending to a consumer on the other
+ * core. The pairs share nothing but the kernel, so with two cores they should get about twice as much done.
+ */
+void throughput_benchmark(void) {
+    static const char *configurations[] = {"1 core", "2 cores", "2 cores sending across"};
+    uint32_t start, received, total;
+    int configuration, sample, pair, pairs;
+
+    for(configuration = 0; configuration < count_of(configurations); configuration++) {
+        if(configuration && !PICCOLO_OS_MULTICORE) {
+            printf("# no second core for %s\n", configurations[configuration]);
+            continue;
+        }
+        for(pairs = 0; pairs < BENCH_PAIRS; pairs++) {
+            signals_received[pairs] = 0;
+            consumers[pairs] = piccolo_create_task_on(consumer, (void *) (uintptr_t) pairs, BENCH_STACK, "bench",
+                1u << (configuration == 0 ? 0 : (pairs & 1) ^ (configuration == 2)));
+            if(!consumers[pairs]) break;
+            producers[pairs] = piccolo_create_task_on(producer, (void *) (uintptr_t) pairs, BENCH_STACK, "bench",
+                1u << (configuration == 0 ? 0 : pairs & 1));
+            if(!producers[pairs]) {
+                stop_helpers(&consumers[pairs], 1);
+                break;
+            }
+        }
+        if(pairs < BENCH_PAIRS) printf("# out of memory creating %d pairs\n", BENCH_PAIRS);
+        piccolo_sleep(10);
+        for(sample = 0; sample < BENCH_SAMPLES; sample++) {
+            for(total = 0, pair = 0; pair < pairs; pair++) total += signals_received[pair];
+            start = time_us_32();
+            piccolo_sleep(BENCH_WINDOW_MS);
+            for(received = 0, pair = 0; pair < pairs; pair++) received += signals_received[pair];
+            samples[sample] = (uint64_t) (received - total) * 1000 / (time_us_32() - start);
+        }
+        report("signal throughput", configurations[configuration], "signals/ms");
+        // the producers first, so none sends to a consumer which has ended
+        producers_stop = true;
+        piccolo_sleep(10);
+        producers_stop = false;
+        stop_helpers(consumers, pairs);
+    }
+}
+
+void benchmarks(void) {
+    piccolo_sleep(10);
+    printf("PICCOLO BENCHMARK BEGIN\n");
+    printf("benchmark,configuration,unit,samples,min,median,p99\n");
+    yield_benchmark();
+    signal_benchmark();
+    throughput_benchmark();
+    lite_benchmark();
+    semaphore_benchmark();
+    churn_benchmark();
+    sleep_benchmark();
+    deadline_benchmark();
+    timer_benchmark();
+    deferred_benchmark();
+    printf("PICCOLO BENCHMARK END\n");
+#if PICCOLO_OS_HOST
+    exit(0);    // in the host simulation, there is nothing more to wait for
+#endif
+}
+
+int main() {
+    stdio_init_all();
+    piccolo_init();
+
+    sleep_ms(5000);  // pause to give user a chance to start putty
+
+    piccolo_create_task(benchmarks);
+    piccolo_start();
+
+  return 0; /* Never gonna happen */
+}
@@ -7,6 +7,7 @@
 
 #include "pico/stdlib.h"
 #include <stdio.h>
+#include <string.h>
 #include "pico/malloc.h"
 #include "hardware/structs/systick.h"
 #include "hardware/exception.h"
@@ -25,21 +26,37 @@ volatile extern int32_t sleep_ct;
  semaphore_t talking_stick;
 
 /*
- * This task blinks the LED. It also holds the semaphore talking_stick
- * while the LED is off. This is used to gate the reporter task and keep it
- * from printing.
+ * The blinker sets the LED_ON event each time it turns the LED on.
  */
-void blinker(void) {
-  gpio_init(LED_PIN);
-  gpio_set_dir(LED_PIN, GPIO_OUT);
-  while (true) {
+piccolo_event_group_t demo_events;
+#define LED_ON_EVENT 0x1
+
+/*
+ * This software timer blinks the LED, without a task (and its stack) of its own. It also holds 
+ * the semaphore talking_stick while the LED is off. This is used to gate the reporter task and 
+ * keep it from printing. A timer callback must not block, so if the reporter has the stick when
+ * the LED goes off, it tries again every 10 ms, and the LED stays off for 2 seconds from then.
+ */
+piccolo_timer_t blink_timer;
+
+void blinker(piccolo_timer_t *timer) {
+  static bool lit = false;
+
+  if (!lit) {
     gpio_put(LED_PIN, 1);
     sem_release(&talking_stick);
-    piccolo_sleep(2000);
-    gpio_put(LED_PIN, 0);
-    sem_acquire_blocking(&talking_stick);
-    piccolo_sleep(2000);
+    piccolo_event_group_set(&demo_events, LED_ON_EVENT);
+    lit = true;
+    piccolo_timer_start(timer, 2000000, 0);
+    return;
+  }
+  gpio_put(LED_PIN, 0);
+  if (!sem_try_acquire(&talking_stick)) {
+    piccolo_timer_start(timer, 10000, 0);
+    return;
   }
+  lit = false;
+  piccolo_timer_start(timer, 2000000, 0);
 }
 
 
@@ -60,8 +77,10 @@ int is_prime(unsigned int n)
  */
 uint32_t primes[2], totalPrimes;
 piccolo_os_task_t * reporter;
+uint8_t reporter_mailbox[PICCOLO_MAILBOX_BUFFER_SIZE(sizeof(int), 4)];
+piccolo_os_task_t * prime_finder;
 
-void find_primes(void) {
+void find_primes(void *argument) {
   int p;
 
   printf("task2: Created!\n");
@@ -69,27 +88,110 @@ void find_primes(void) {
     for (p=5;p;p+=2) if(is_prime(p)==1) {
     totalPrimes++;
     primes[get_core_num()]++;
-    // every 4096 prime numbers, send the reporter a signal
-    if(!(totalPrimes & 0xFFF)) piccolo_send_signal(reporter);
+    // every 4096 prime numbers, send the reporter the latest one
+    if(!(totalPrimes & 0xFFF)) piccolo_send_message(reporter, &p);
     }
   }
 }
 /*
- * Report on the progress of the prime number finder. Wait until he sends a signal
- * Then get the "talking stick" semaphore from the LED blinker task. We can only 
+ * Count the tasks which have ended (and been returned to the task pools),
+ * and how many task blocks the pools have taken from the heap
+ */
+uint32_t tasks_ended(uint32_t *blocks, uint32_t *bytes) {
+    piccolo_os_pool_statistics_t pool;
+    uint32_t ended = 0;
+
+    if(blocks) *blocks = 0;
+    if(bytes) *bytes = 0;
+    for(int size_class = 0; size_class < PICCOLO_OS_POOL_CLASSES; size_class++) {
+        piccolo_get_pool_statistics(size_class, &pool);
+        ended += pool.reclaimed;
+        if(blocks) *blocks += pool.allocated;
+        if(bytes) *bytes += pool.allocated * (pool.stack_size + sizeof(piccolo_os_task_t));
+    }
+    return ended;
+}
+
+/*
+ * Print the busiest tasks since the last time, like top. Tasks are matched up
+ * with the previous snapshot by their identifier. (A block reused by a new task
+ * since then can show a bogus figure for a report.)
+ */
+#define TOP_TASKS 16
+piccolo_os_task_info_t top_now[TOP_TASKS], top_before[TOP_TASKS];
+uint32_t top_tasks_before;
+absolute_time_t top_time_before;
+
+void print_top(void) {
+    absolute_time_t now = get_absolute_time();
+    uint64_t interval_us = absolute_time_diff_us(top_time_before, now);
+    uint64_t ran_us, waited_us;
+    uint32_t tasks, i, j, r;
+
+    tasks = piccolo_get_task_info(top_now, TOP_TASKS);
+    if(tasks > TOP_TASKS) tasks = TOP_TASKS;
+    for(i = 0; i < tasks; i++) {
+        ran_us = top_now[i].statistics.run_us;
+        for(waited_us = 0, r = 0; r < PICCOLO_WAIT_REASONS; r++) waited_us += top_now[i].statistics.wait_us[r];
+        for(j = 0; j < top_tasks_before; j++) if(top_before[j].task == top_now[i].task) {
+            ran_us -= top_before[j].statistics.run_us;
+            for(r = 0; r < PICCOLO_WAIT_REASONS; r++) waited_us -= top_before[j].statistics.wait_us[r];
+            break;
+        }
+        // only the tasks which took at least 1% of a core
+        if(ran_us * 100 < interval_us) continue;
+        printf("  task %p %-8s core %d cpu %3lld%% ran %lld ms waited %lld ms, %d yields %d preemptions %d migrations\n",
+            top_now[i].task, top_now[i].name ? top_now[i].name : "-", top_now[i].statistics.last_core,
+            ran_us * 100 / interval_us, ran_us / 1000, waited_us / 1000,
+            top_now[i].statistics.yields, top_now[i].statistics.preemptions, top_now[i].statistics.migrations);
+    }
+    memcpy(top_before, top_now, sizeof(top_before));
+    top_tasks_before = tasks;
+    top_time_before = now;
+}
+
+/*
+ * Report on the progress of the prime number finder. Wait until he sends a message
+ * with the latest prime. Then get the "talking stick" semaphore from the LED blinker. We can only 
  * talk when the green light is on! Then print a report. We also report on
- * how many tasks the garbage collector has reclaimed using a counter which
- * is only there as a debug feature at the moment...
+ * how many tasks have ended and been reclaimed, how much memory the task pools
+ * hold, how much stack the busy tasks need, on the work and lock contention of each core's scheduler,
+ * and on which tasks keep the cores busy...
  */
-extern uint32_t kills;
-void reporter_task(void){
+void reporter_task(void *argument) {
+    piccolo_os_core_statistics_t statistics;
+    uint32_t ended, blocks, bytes;
+    int core, prime;
+
     printf("Reporter Started\n");
     while(1) {
-        piccolo_get_signal_all_blocking();
+        piccolo_get_message_blocking(&prime);
         if(!sem_acquire_timeout_ms(&talking_stick,10000)) printf("sem acquire timeout SHOULD NOT have failed\n");
        
-        printf("Total primes %d, cores 0/1 %d/%d kills %d recycled %d bytes\n",
-            totalPrimes,primes[0], primes[1], kills, kills*sizeof(piccolo_os_task_t));
+        ended = tasks_ended(&blocks, &bytes);
+        printf("Total primes %d (latest %d), cores 0/1 %d/%d tasks ended %d, pools hold %d tasks in %d bytes\n",
+            totalPrimes, prime, primes[0], primes[1], ended, blocks, bytes);
+        // and how much of their stacks the prime finder and the reporter have needed
+#if PICCOLO_OS_HOST
+        printf("  stack used: n/a (host tasks run on host stacks)\n");
+#else
+        printf("  stack used: prime finder %d reporter %d of %d bytes\n",
+            piccolo_get_stack_high_water(prime_finder), piccolo_get_stack_high_water(reporter), reporter->stack_size);
+#endif
+        // and how the two schedulers are getting along
+        for(core=0;core<2;core++) {
+            piccolo_get_core_statistics(core,&statistics);
+            printf("  core %d: dispatches %d steals %d migrations %d run queue lock taken %d contended %d held %lld us\n",
+                core, statistics.dispatches, statistics.steals, statistics.migrations, statistics.lock_acquisitions,
+                statistics.lock_contended, statistics.lock_hold_us);
+            printf("          idle %lld us in %d wakeups\n", statistics.idle_us, statistics.idle_wakeups);
+        }
+        // and which tasks are keeping them busy
+        print_top();
+#if PICCOLO_OS_TRACE
+        // and what the schedulers have been doing lately (tools/trace_to_json.py makes it readable)
+        piccolo_trace_dump();
+#endif
         sem_release(&talking_stick);
     }
 }
@@ -97,128 +199,68 @@ void reporter_task(void){
 /*
  * The next two tasks are created periodically by the stress_tester task
  * only to quickly delete themselves. "z" dies immediatly whicle "sz" yields
- * once first.
+ * once first. They need hardly any stack, so they get a small one.
  */
-void sz(){
+#define helper_stack_size 256
+// and the demo tasks get the default stack
+#define demo_stack_size (PICCOLO_OS_STACK_SIZE * sizeof(uint32_t))
+void sz(void *argument){
     piccolo_yield();
     return;
 }
 
-void z(){
+void z(void *argument){
     int a = 1;
     return;
 }
 
-void stress_tester(void) {
+/*
+ * The same again as lightweight tasks, which need no stack of their own at all.
+ * Their structures are reused once they have ended.
+ */
+#define LITE_HELPERS 4
+piccolo_lite_task_t lite_helpers[LITE_HELPERS];
+
+uint32_t lite_sz(piccolo_lite_task_t *lite) {
+    PICCOLO_LITE_BEGIN(lite);
+    PICCOLO_LITE_YIELD(lite);
+    PICCOLO_LITE_END(lite);
+}
+
+uint32_t lite_z(piccolo_lite_task_t *lite) {
+    PICCOLO_LITE_BEGIN(lite);
+    PICCOLO_LITE_END(lite);
+}
+
+void stress_tester(void *argument) {
     /**
      * Force a slew of task create and deletes by creating lots of tasks
      * that die very quickly. Do this every few seconds. Note that we
      * are perfectly safe creating multiple tasks running the same function
      * since they all have seperate stacks. 
+     * Start a round each time the LED comes on, or after 3 seconds at most.
      * 
      */
     while(1) {
-        piccolo_create_task(z);
-        piccolo_create_task(z);
-        piccolo_create_task(z);
-        piccolo_create_task(sz);
-        piccolo_create_task(sz);
-        piccolo_create_task(sz);
-        piccolo_create_task(z);
-        piccolo_create_task(sz);
-        piccolo_create_task(z);
-        piccolo_create_task(sz);
-        piccolo_create_task(sz);
-
-        piccolo_sleep(3000);
+        piccolo_create_task_ex(z, NULL, helper_stack_size, "z");
+        piccolo_create_task_ex(z, NULL, helper_stack_size, "z");
+        piccolo_create_task_ex(z, NULL, helper_stack_size, "z");
+        piccolo_create_task_ex(sz, NULL, helper_stack_size, "sz");
+        piccolo_create_task_ex(sz, NULL, helper_stack_size, "sz");
+        piccolo_create_task_ex(sz, NULL, helper_stack_size, "sz");
+        piccolo_create_task_ex(z, NULL, helper_stack_size, "z");
+        piccolo_create_task_ex(sz, NULL, helper_stack_size, "sz");
+        piccolo_create_task_ex(z, NULL, helper_stack_size, "z");
+        piccolo_create_task_ex(sz, NULL, helper_stack_size, "sz");
+        piccolo_create_task_ex(sz, NULL, helper_stack_size, "sz");
+        for(int i = 0; i < LITE_HELPERS; i++) if(!lite_helpers[i].function || (lite_helpers[i].flags & PICCOLO_LITE_ENDED))
+            piccolo_lite_create(&lite_helpers[i], (i & 1) ? lite_sz : lite_z, NULL);
+
+        piccolo_event_group_wait_any(&demo_events, LED_ON_EVENT, true, 3000);
     }
 }
 
 
-void spinner2(void){
-    piccolo_os_task_t * task;
-    task = piccolo_get_task_id();
-    while(!piccolo_get_signal()) piccolo_yield();   // spin until we get a signal
-    piccolo_get_signal_blocking();                  // hang until we get a second one
-//    printf(" signal hang2 task %8X in %d out %d limit %d\n",task,task->signal_in,task->signal_out,task->signal_limit);
-    piccolo_get_signal_blocking();                  // hang until we get a third one
-//    printf(" semaphore hang task %8X in %d out %d limit %d\n",task,task->signal_in,task->signal_out,task->signal_limit);
-    sem_acquire_blocking(&talking_stick);           // then hang on the semaphore
-//    printf(" semaphore exit task %8X in %d out %d limit %d\n",task,task->signal_in,task->signal_out,task->signal_limit);
-    return;                                         // and exit
-}
-void spinner(){
-    int i,yielding=1,blocking=1, semaphore;
-    absolute_time_t start;
-    uint64_t time;
-    piccolo_os_task_t *spin1, *spin2;
-#define loops 1000
-    piccolo_sleep(10);
-    start = get_absolute_time();
-    for(i=0;i<loops;i++) piccolo_yield();
-    time = absolute_time_diff_us(start,get_absolute_time());
-    printf("\n");
-    printf("Yielding:%3d  Blocking:%3d Takes %6lld nanoseconds\n",yielding,blocking,time);
-
-    spin1 = piccolo_create_task(spinner2);
-    yielding++;
-    piccolo_sleep(10);
-    start = get_absolute_time();
-    for(i=0;i<loops;i++) piccolo_yield();
-    time = absolute_time_diff_us(start,get_absolute_time());
-    printf("Yielding:%3d  Blocking:%3d Takes %6lld nanoseconds\n",yielding,blocking,time);
-
-    spin2 = piccolo_create_task(spinner2);
-    yielding++;
-    piccolo_sleep(10);
-    start = get_absolute_time();
-    for(i=0;i<loops;i++) piccolo_yield();
-    time = absolute_time_diff_us(start,get_absolute_time());
-    printf("Yielding:%3d  Blocking:%3d Takes %6lld nanoseconds\n",yielding,blocking,time);
-
-    piccolo_send_signal(spin1);
-    piccolo_send_signal(spin2);     // send them both to signal blocking
-    yielding -=2;
-    blocking +=2;
-    piccolo_sleep(2000);
-    start = get_absolute_time();
-    for(i=0;i<loops;i++) piccolo_yield();
-    time = absolute_time_diff_us(start,get_absolute_time());
-    printf("Yielding:%3d  Blocking:%3d Takes %6lld nanoseconds\n",yielding,blocking,time);
-
-    sem_try_acquire(&talking_stick);           // Eat the permit that should be there
-    piccolo_send_signal(spin1);
-    piccolo_send_signal(spin2);     // send them both to semaphores
-    yielding = 1;
-    blocking = 1;
-    semaphore = 2;
-    piccolo_sleep(2000);
-    start = get_absolute_time();
-    for(i=0;i<loops;i++) piccolo_yield();
-    time = absolute_time_diff_us(start,get_absolute_time());
-    printf("Yielding:%3d  Blocking:%3d On Semaphore:%3d Takes %6lld nanoseconds\n",yielding,blocking,semaphore, time);
-
-    sem_release(&talking_stick);    // one of them will die
-    semaphore--;
-    piccolo_sleep(2000);
-    start = get_absolute_time();
-    for(i=0;i<loops;i++) piccolo_yield();
-    time = absolute_time_diff_us(start,get_absolute_time());
-    printf("Yielding:%3d  Blocking:%3d On Semaphore:%3d Takes %6lld nanoseconds\n",yielding,blocking,semaphore, time);
-
-    sem_release(&talking_stick);    // one of them will die
-    piccolo_sleep(20);
-    sem_release(&talking_stick);    // replace the permit
-
-    //start the LED blinker
-    piccolo_create_task(blinker);
-    printf("\nStart the prime finder, his reporter and the stress tester, and then depart!\n");
-    piccolo_create_task(stress_tester);
-    reporter = piccolo_create_task(reporter_task);
-    piccolo_create_task(find_primes);
-}
-
-
 int main() {
     stdio_init_all();
     piccolo_init();
@@ -230,10 +272,19 @@ int main() {
 
     // initialize the semaphore 
     sem_init(&talking_stick,1,1);
+    piccolo_event_group_init(&demo_events);
 
-    // test a few things for timing first
-    // the spinner task will start everything else ...
-    piccolo_create_task(spinner);
+    //start the LED blinker
+    gpio_init(LED_PIN);
+    gpio_set_dir(LED_PIN, GPIO_OUT);
+    piccolo_timer_create(&blink_timer, blinker, NULL);
+    piccolo_timer_start(&blink_timer, 0, 0);
+    // then the prime finder, his reporter and the stress tester. (The kernel timings are in bench.c)
+    // (named, so the task snapshot the reporter prints shows which is which)
+    piccolo_create_task_ex(stress_tester, NULL, demo_stack_size, "stress tester");
+    reporter = piccolo_create_task_ex(reporter_task, NULL, demo_stack_size, "reporter");
+    piccolo_set_mailbox(reporter, reporter_mailbox, sizeof(int), 4);
+    prime_finder = piccolo_create_task_ex(find_primes, NULL, demo_stack_size, "prime finder");
 
     printf("PICCOLO OS Demo Starting...\n");
     // and begin!
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2022 Keith Standiford
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Coroutine task demo. Coroutine workers share a "printer" semaphore with an ordinary task, wait for
+ * replies provided by it (piccolo::completion) and for its signals, then a summary is printed. Every
+ * awaitable of coroutine.hpp is used, so this also shows the C++ layer builds and runs wherever the
+ * kernel does.
+ */
+
+#include "pico/stdlib.h"
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/sem.h"
+
+#include "kernel/kernel.h"
+#include "kernel/coroutine.hpp"
+
+#define DEMO_WORKERS 3              // coroutine tasks sharing the printer
+#define DEMO_ROUNDS 20              // times each of them uses it
+#define DEMO_HOLD_MS 2              // how long each use takes
+#define DEMO_TIMEOUT_MS 5           // how long a worker waits for the printer before giving up on a round
+#define DEMO_SIGNALS 10             // signals the ordinary task sends the listener
+
+static semaphore_t printer;
+static piccolo::completion<int> reply;
+static piccolo_lite_task_t *listener_lite;
+
+static std::atomic<uint32_t> printed[DEMO_WORKERS], timed_out[DEMO_WORKERS];
+static std::atomic<uint32_t> signals_taken, reply_value, coroutines_done;
+
+/* Use the printer for a while, if it comes free in time */
+static piccolo::task<bool> print(uint32_t timeout_ms) {
+    bool acquired = co_await piccolo::acquire(&printer, timeout_ms);
+
+    if(!acquired) co_return false;
+    co_await piccolo::sleep(DEMO_HOLD_MS);
+    sem_release(&printer);
+    co_return true;
+}
+
+static piccolo::task<> worker(int id) {
+    for(int round = 0; round < DEMO_ROUNDS; round++) {
+        piccolo::task<bool> job = print(id ? DEMO_TIMEOUT_MS : 0);    // worker 0 always waits its turn
+
+        if(!job) break;
+        if(co_await std::move(job)) printed[id]++;
+        else timed_out[id]++;
+        co_await piccolo::yield();
+    }
+    coroutines_done++;
+}
+
+static piccolo::task<> requester(void) {
+    reply_value = co_await reply;
+    coroutines_done++;
+}
+
+static piccolo::task<> listener(void) {
+    int32_t taken;      // not awaited straight in the condition, for GCC 12 (see coroutine.hpp)
+
+    while((taken = co_await piccolo::get_signal(100)) > 0) signals_taken++;
+    coroutines_done++;
+}
+
+/* An ordinary task, which hogs the printer now and then, answers the requester and signals the listener */
+static void hog(void) {
+    for(int signal = 0; signal < DEMO_SIGNALS; signal++) {
+        sem_acquire_blocking(&printer);
+        piccolo_sleep(3 * DEMO_HOLD_MS);
+        sem_release(&printer);
+        piccolo_lite_send_signal(listener_lite);
+        piccolo_sleep(DEMO_HOLD_MS);
+    }
+    reply.complete(42);
+    piccolo_end_task();
+}
+
+static void demo(void) {
+    uint32_t started = time_us_32();
+
+    sem_init(&printer, 1, 1);
+    for(int id = 0; id < DEMO_WORKERS; id++) piccolo::spawn(worker(id));
+    piccolo::spawn(requester());
+    listener_lite = piccolo::spawn(listener());
+    piccolo_create_task(hog);
+
+    while(coroutines_done < DEMO_WORKERS + 2) piccolo_sleep(10);
+    for(int id = 0; id < DEMO_WORKERS; id++)
+        printf("worker %d: printed %lu times, gave up %lu times\n", id, printed[id].load(), timed_out[id].load());
+    printf("listener took %lu of %d signals, requester got %lu\n", signals_taken.load(), DEMO_SIGNALS,
+           reply_value.load());
+    printf("done in %lu ms\n", (time_us_32() - started) / 1000);
+#if PICCOLO_OS_HOST
+    exit(0);    // in the host simulation, there is nothing more to wait for
+#endif
+    piccolo_end_task();
+}
+
+int main() {
+    stdio_init_all();
+    piccolo_init();
+
+    sleep_ms(5000);  // pause to give user a chance to start putty
+
+    piccolo_create_task(demo);
+    piccolo_start();
+
+  return 0; /* Never gonna happen */
+}
@@ -0,0 +1,34 @@
+/*
+ * Host simulation: hardware/exception.h. Handlers are recorded but never called: the host port
+ * does what the kernel's SVCall, PendSV and SysTick handlers do itself (host/port.c).
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_EXCEPTION_H
+#define _HARDWARE_EXCEPTION_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum exception_number {
+    NMI_EXCEPTION = -14,
+    HARDFAULT_EXCEPTION = -13,
+    SVCALL_EXCEPTION = -5,
+    PENDSV_EXCEPTION = -2,
+    SYSTICK_EXCEPTION = -1,
+};
+
+typedef void (*exception_handler_t)(void);
+
+exception_handler_t exception_set_exclusive_handler(enum exception_number num, exception_handler_t handler);
+void exception_restore_handler(enum exception_number num, exception_handler_t original_handler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,24 @@
+/*
+ * Host simulation: hardware/irq.h
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_IRQ_H
+#define _HARDWARE_IRQ_H
+
+#include "pico.h"
+#include "hardware/exception.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VTABLE_FIRST_IRQ 16
+#define TIMER_IRQ_0 0
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,17 @@
+/*
+ * Host simulation: hardware/regs/addressmap.h. The private peripheral bus is a block of memory.
+ * hw_set_bits() on the ICSR in it clears a pending SysTick, the only ICSR bit the port needs.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_REGS_ADDRESSMAP_H
+#define _HARDWARE_REGS_ADDRESSMAP_H
+
+#include <stdint.h>
+
+extern uint32_t __piccolo_host_ppb[];
+
+#define PPB_BASE ((uintptr_t) __piccolo_host_ppb)
+
+#endif
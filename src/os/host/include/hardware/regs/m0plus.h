@@ -0,0 +1,21 @@
+/*
+ * Host simulation: hardware/regs/m0plus.h, the registers the kernel touches
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_REGS_M0PLUS_H
+#define _HARDWARE_REGS_M0PLUS_H
+
+#define M0PLUS_ICSR_OFFSET 0x0000ed04
+#define M0PLUS_ICSR_PENDSVSET_BITS 0x10000000
+#define M0PLUS_ICSR_PENDSVCLR_BITS 0x08000000
+#define M0PLUS_ICSR_PENDSTSET_BITS 0x04000000
+#define M0PLUS_ICSR_PENDSTCLR_BITS 0x02000000
+
+#define M0PLUS_SHPR2_OFFSET 0x0000ed1c
+#define M0PLUS_SHPR2_BITS 0xc0000000
+#define M0PLUS_SHPR3_OFFSET 0x0000ed20
+#define M0PLUS_SHPR3_BITS 0xc0c00000
+
+#endif
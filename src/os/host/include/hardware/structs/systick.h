@@ -0,0 +1,33 @@
+/*
+ * Host simulation: hardware/structs/systick.h. Each core has its own SysTick, as on the
+ * RP2040, so systick_hw is the calling core's. Only the enable and interrupt bits of csr,
+ * and rvr, the ticks per period (one per microsecond), mean anything.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_STRUCTS_SYSTICK_H
+#define _HARDWARE_STRUCTS_SYSTICK_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    io_rw_32 csr;
+    io_rw_32 rvr;
+    io_rw_32 cvr;
+    io_ro_32 calib;
+} systick_hw_t;
+
+systick_hw_t *__piccolo_host_systick(void);
+
+#define systick_hw (__piccolo_host_systick())
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ * Host simulation: hardware/sync.h. The 32 spin locks, the event register behind __sev()
+ * and __wfe(), and masking interrupts, for the cores the host port runs (host/port.c).
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_SYNC_H
+#define _HARDWARE_SYNC_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef volatile uint32_t spin_lock_t;
+
+#define PICO_SPINLOCK_ID_IRQ 9
+#define PICO_SPINLOCK_ID_TIMER 10
+#define PICO_SPINLOCK_ID_HARDWARE_CLAIM 11
+#define PICO_SPINLOCK_ID_RAND 12
+#define PICO_SPINLOCK_ID_OS1 14
+#define PICO_SPINLOCK_ID_OS2 15
+#define PICO_SPINLOCK_ID_STRIPED_FIRST 16
+#define PICO_SPINLOCK_ID_STRIPED_LAST 23
+#define PICO_SPINLOCK_ID_CLAIM_FREE_FIRST 24
+#define PICO_SPINLOCK_ID_CLAIM_FREE_LAST 31
+
+static inline void __dmb(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void __dsb(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void __isb(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void __mem_fence_acquire(void) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
+
+static inline void __mem_fence_release(void) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void __sev(void);
+void __wfe(void);
+void __wfi(void);
+
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+spin_lock_t *spin_lock_instance(uint lock_num);
+uint spin_lock_get_num(spin_lock_t *lock);
+void spin_lock_unsafe_blocking(spin_lock_t *lock);
+void spin_unlock_unsafe(spin_lock_t *lock);
+uint32_t spin_lock_blocking(spin_lock_t *lock);
+bool is_spin_locked(spin_lock_t *lock);
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq);
+spin_lock_t *spin_lock_init(uint lock_num);
+uint next_striped_spin_lock_num(void);
+void spin_lock_claim(uint lock_num);
+void spin_lock_unclaim(uint lock_num);
+int spin_lock_claim_unused(bool required);
+bool spin_lock_is_claimed(uint lock_num);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ * @file pico.h
+ * @brief Host simulation: the base of the Pico SDK headers
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * The headers under `host/include` stand in for the few Pico SDK headers the kernel, the demo
+ * and the benchmarks use, with the SDK's names and types. What is behind them is in `host/port.c`
+ * (the cores, interrupts, spin locks, SysTick and the alarms) and `host/sdk.c` (the rest).
+ */
+
+#ifndef _PICO_H
+#define _PICO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PICO_ON_DEVICE 0
+#define PICO_NO_HARDWARE 1
+
+typedef unsigned int uint;
+typedef volatile uint32_t io_rw_32;
+typedef const volatile uint32_t io_ro_32;
+typedef volatile uint32_t io_wo_32;
+typedef uint64_t absolute_time_t;
+
+#define __force_inline inline __attribute__((always_inline))
+#define __time_critical_func(func_name) func_name
+#define __not_in_flash_func(func_name) func_name
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+static inline void tight_loop_contents(void) {}
+
+uint get_core_num(void);
+uint __get_current_exception(void);
+void hw_set_bits(io_rw_32 *addr, uint32_t mask);
+void hw_clear_bits(io_rw_32 *addr, uint32_t mask);
+void panic(const char *fmt, ...) __attribute__((noreturn));
+
+// the config header the device build adds with PICO_CONFIG_HEADER_FILES
+#include "lock_core.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
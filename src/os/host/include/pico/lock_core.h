@@ -0,0 +1,29 @@
+/*
+ * Host simulation: pico/lock_core.h. The lock_internal_* hooks come from the Piccolo OS
+ * overrides, which pico.h has already included, as on the device.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_LOCK_CORE_H
+#define _PICO_LOCK_CORE_H
+
+#include "pico.h"
+#include "pico/time.h"
+#include "hardware/sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct lock_core {
+    spin_lock_t *spin_lock;
+} lock_core_t;
+
+void lock_init(lock_core_t *core, uint lock_num);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,21 @@
+/*
+ * Host simulation: pico/malloc.h. Like the SDK's pico_malloc, the host build wraps malloc()
+ * and friends at link time (see host/sdk.c), so there is nothing to declare.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_MALLOC_H
+#define _PICO_MALLOC_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,22 @@
+/*
+ * Host simulation: pico/stdio.h. The console is the process's stdout.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_STDIO_H
+#define _PICO_STDIO_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool stdio_init_all(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
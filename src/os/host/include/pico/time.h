@@ -0,0 +1,83 @@
+/*
+ * Host simulation: pico/time.h. An absolute_time_t is microseconds since the process started.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_TIME_H
+#define _PICO_TIME_H
+
+#include "pico.h"
+#include "hardware/timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static const absolute_time_t at_the_end_of_time = INT64_MAX;
+static const absolute_time_t nil_time = 0;
+
+static inline uint64_t to_us_since_boot(absolute_time_t t) {
+    return t;
+}
+
+static inline void update_us_since_boot(absolute_time_t *t, uint64_t us_since_boot) {
+    *t = us_since_boot;
+}
+
+static inline absolute_time_t from_us_since_boot(uint64_t us_since_boot) {
+    return us_since_boot;
+}
+
+static inline absolute_time_t get_absolute_time(void) {
+    return time_us_64();
+}
+
+static inline uint32_t to_ms_since_boot(absolute_time_t t) {
+    return (uint32_t) (t / 1000);
+}
+
+static inline absolute_time_t delayed_by_us(const absolute_time_t t, uint64_t us) {
+    uint64_t delayed = t + us;
+
+    return (delayed < t || delayed > (uint64_t) INT64_MAX) ? at_the_end_of_time : delayed;
+}
+
+static inline absolute_time_t delayed_by_ms(const absolute_time_t t, uint32_t ms) {
+    return delayed_by_us(t, ms * 1000ull);
+}
+
+static inline absolute_time_t make_timeout_time_us(uint64_t us) {
+    return delayed_by_us(get_absolute_time(), us);
+}
+
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms) {
+    return delayed_by_ms(get_absolute_time(), ms);
+}
+
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) {
+    return (int64_t) (to - from);
+}
+
+static inline absolute_time_t absolute_time_min(absolute_time_t a, absolute_time_t b) {
+    return a < b ? a : b;
+}
+
+static inline bool is_at_the_end_of_time(absolute_time_t t) {
+    return t == at_the_end_of_time;
+}
+
+static inline bool is_nil_time(absolute_time_t t) {
+    return !t;
+}
+
+void sleep_until(absolute_time_t target);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+bool best_effort_wfe_or_timeout(absolute_time_t timeout_timestamp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
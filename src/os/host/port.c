@@ -0,0 +1,705 @@
+/**
+ * @file port.c
+ * @brief Piccolo OS host simulation: the cores, the context switch and the interrupts
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Runs the kernel unchanged as a Linux process, so it can be debugged, sanitized and measured
+ * without a board. This file stands in for `context_switch.s` and the RP2040 hardware the
+ * kernel uses:
+ *
+ * - Each core is a thread. Core 0 is the thread which runs main(), core 1 is started by
+ *   multicore_launch_core1().
+ * - Each task runs on a ucontext with a stack of \ref HOST_STACK_SIZE bytes from the host. The
+ *   stack in the task block only holds the kernel's canary. The kernel keeps a pointer to the
+ *   ucontext where it would keep the task's stack pointer, so either core can resume the task.
+ * - The scheduler loop runs "in handler mode": the current exception is SVCall and SIGALRM
+ *   is blocked.
+ * - SysTick is SIGALRM, sent to a core's thread each time slice while the core's SysTick is
+ *   enabled. It preempts the task, unless interrupts are masked. Then it stays pending until
+ *   they are unmasked or the kernel clears it, as it would on the NVIC.
+ * - A yield or a tick stops the task and goes to the core's handler context, which does what
+ *   `__isr_PENDSV` does: `__piccolo_fast_switch()` to the next task, or back to the scheduler loop.
+ *   Without \ref PICCOLO_OS_FAST_SWITCH a yield goes straight back to the loop, as `__isr_SVCALL` does.
+ *   PendSV pended through the ICSR (to preempt for a task of higher priority) is taken as soon as
+ *   interrupts are unmasked.
+ * - Masking interrupts only masks SysTick. The spin locks are atomic words, and the event
+ *   register behind `__sev()` and `__wfe()` is a flag per core with a condition variable to sleep on.
+ *   The alarm callbacks run when their core waits for an event, which is all the kernel needs of them.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <ucontext.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/structs/systick.h"
+#include "hardware/exception.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+
+#include "kernel.h"
+
+#define HOST_STACK_SIZE (64 * 1024)         // each task's stack on the host
+#define HOST_HANDLER_STACK_SIZE (64 * 1024) // each core's handler stack
+#define HOST_CORE_STACK_SIZE (1024 * 1024)  // core 1's thread
+#define HOST_CONTEXT_BUCKETS 64             // in the table of task contexts, a power of 2
+#define HOST_SPINS 64                       // spins on a taken spin lock before giving the CPU away
+#define HOST_WFE_MAX_US 1000                // the longest a wait for an event sleeps before looking again
+
+#define HOST_SVCALL (VTABLE_FIRST_IRQ + SVCALL_EXCEPTION)
+#define HOST_PENDSV (VTABLE_FIRST_IRQ + PENDSV_EXCEPTION)
+#define HOST_SYSTICK (VTABLE_FIRST_IRQ + SYSTICK_EXCEPTION)
+#define HOST_SYSTICK_ON 3                   // csr: counter and interrupt enabled
+
+uint32_t *__time_critical_func(__piccolo_fast_switch)(uint32_t *stack_ptr);
+
+/**
+ * @brief A task's context on the host
+ * \ingroup Intern
+ * Found by the top of the task block's stack, so a task block the pool hands out again gets
+ * the same context (and host stack) back.
+ */
+typedef struct host_context {
+    ucontext_t context;                 /**< the task's registers while it is not running **/
+    uint32_t *stack_top;                /**< the key: the top of the task block's stack **/
+    void (*start)(void);                /**< the task function **/
+    uintptr_t argument;                 /**< and its argument **/
+    struct host_context *next;          /**< next in the same bucket **/
+    char stack[HOST_STACK_SIZE];        /**< the stack the task really runs on **/
+} host_context_t;
+
+/**
+ * @brief One simulated core
+ * \ingroup Intern
+ */
+typedef struct {
+    pthread_t thread;                   /**< the thread which is the core **/
+    volatile bool started;              /**< thread is valid **/
+    ucontext_t kernel;                  /**< the scheduler loop, in `__piccolo_pre_switch()` **/
+    ucontext_t handler;                 /**< where a task which stops goes to be switched out **/
+    char *handler_stack;                /**< the handler's stack, like the main stack on the device **/
+    host_context_t *volatile running;   /**< the context of the task running on the core **/
+    host_context_t *stopping;           /**< the task the handler is switching out **/
+    host_context_t *stopped;            /**< the task which went back to the scheduler loop **/
+    systick_hw_t systick;               /**< the core's SysTick registers **/
+    volatile bool tick_pending;         /**< SysTick is pending (ICSR PENDSTSET) **/
+    bool switch_pending;                /**< PendSV is pending (ICSR PENDSVSET) **/
+    volatile bool event;                /**< the event register **/
+} host_core_t;
+
+/**
+ * @brief The state of the core a thread is, which on the device is in the core's registers
+ * \ingroup Intern
+ */
+typedef struct {
+    volatile uint core;                 /**< the core number **/
+    volatile uint32_t masked;           /**< interrupts masked (PRIMASK) **/
+    volatile uint exception;            /**< the exception being handled, 0 in thread mode (IPSR) **/
+} host_thread_t;
+
+/**
+ * @brief A hardware alarm
+ * \ingroup Intern
+ */
+typedef struct {
+    bool claimed;                       /**< in use **/
+    volatile bool armed;                /**< target is set and the callback has not run yet **/
+    uint core;                          /**< the core which set the callback, which its interrupt goes to **/
+    absolute_time_t target;             /**< when it fires **/
+    hardware_alarm_callback_t callback; /**< what it calls **/
+} host_alarm_t;
+
+static host_core_t host_cores[2];
+static __thread host_thread_t host_thread;
+static host_alarm_t host_alarms[NUM_TIMERS];
+static spin_lock_t host_spin_locks[32];
+static volatile uint32_t host_spin_locks_claimed;
+static host_context_t *host_contexts[HOST_CONTEXT_BUCKETS];
+static exception_handler_t host_exception_handlers[VTABLE_FIRST_IRQ];
+static pthread_mutex_t host_mutex = PTHREAD_MUTEX_INITIALIZER;  // contexts and claims
+static pthread_mutex_t host_event_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t host_event_cond;
+static volatile uint32_t host_event_sleepers;
+
+uint32_t __piccolo_host_ppb[0x10000 / sizeof(uint32_t)];
+#define HOST_ICSR ((io_rw_32 *) (PPB_BASE + M0PLUS_ICSR_OFFSET))
+
+static void host_stop(uint exception);
+
+/**
+ * @brief The calling thread's core state
+ * \ingroup Intern
+ * A task can stop on one thread and carry on on the other, so the address of a thread local
+ * must not be kept across a switch. It is always fetched through here, which the compiler
+ * can't inline or treat as pure.
+ */
+static __attribute__((noinline, noipa)) host_thread_t *host_this_thread(void) {
+    return &host_thread;
+}
+
+uint get_core_num(void) {
+    return host_this_thread()->core;
+}
+
+uint __get_current_exception(void) {
+    return host_this_thread()->exception;
+}
+
+uint32_t __piccolo_host_interrupts_disabled(void) {
+    return host_this_thread()->masked;
+}
+
+systick_hw_t *__piccolo_host_systick(void) {
+    return &host_cores[get_core_num()].systick;
+}
+
+/**
+ * @brief Unmask interrupts, and take a SysTick which came while they were masked
+ * \ingroup Intern
+ */
+static void host_unmask(void) {
+    host_thread_t *thread = host_this_thread();
+
+    thread->masked = 0;
+    if(thread->exception) return;
+    if(host_cores[thread->core].tick_pending) host_stop(HOST_SYSTICK);
+    else if(host_cores[thread->core].switch_pending) host_stop(HOST_PENDSV);
+}
+
+uint32_t save_and_disable_interrupts(void) {
+    host_thread_t *thread = host_this_thread();
+    uint32_t status = thread->masked;
+
+    thread->masked = 1;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    return status;
+}
+
+void restore_interrupts(uint32_t status) {
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    if(status) host_this_thread()->masked = 1;
+    else host_unmask();
+}
+
+/**
+ * @brief Writes to the private peripheral bus
+ * \ingroup Intern
+ * Pending PendSV and clearing a pending SysTick or PendSV in the ICSR are the only writes which do 
+ * anything. A yield does not go through the ICSR on the host, but the kernel pends PendSV to preempt 
+ * the running task, always with interrupts masked, so it is taken when they are unmasked.
+ */
+void hw_set_bits(io_rw_32 *addr, uint32_t mask) {
+    if(addr == HOST_ICSR) {
+        host_core_t *core = &host_cores[get_core_num()];
+
+        if(mask & M0PLUS_ICSR_PENDSTCLR_BITS) core->tick_pending = false;
+        if(mask & M0PLUS_ICSR_PENDSVCLR_BITS) core->switch_pending = false;
+        if(mask & M0PLUS_ICSR_PENDSVSET_BITS) core->switch_pending = true;
+        return;
+    }
+    __atomic_fetch_or(addr, mask, __ATOMIC_SEQ_CST);
+}
+
+void hw_clear_bits(io_rw_32 *addr, uint32_t mask) {
+    __atomic_fetch_and(addr, ~mask, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * The context switch
+ */
+
+/**
+ * @brief Handle a yield or a tick: switch the task which stopped out
+ * \ingroup Intern
+ * Runs on the core's handler stack, with interrupts masked and SIGALRM blocked, and never returns.
+ * Does what `__isr_PENDSV` does: the fast switch, or back to the scheduler loop.
+ */
+static void host_handler(void) {
+    host_thread_t *thread = host_this_thread();
+    host_core_t *core = &host_cores[thread->core];
+    host_context_t *task = core->stopping, *next = NULL;
+
+#if PICCOLO_OS_FAST_SWITCH
+    if(thread->exception != HOST_SVCALL) next = (host_context_t *) __piccolo_fast_switch((uint32_t *) task);
+#endif
+    if(next) {
+        core->running = next;
+        setcontext(&next->context);
+    }
+    core->stopped = task;
+    setcontext(&core->kernel);
+}
+
+/**
+ * @brief Stop the running task, as taking an exception would
+ * \ingroup Intern
+ * @param exception the exception number: SVCall, PendSV or SysTick
+ *
+ * Returns when the task is switched back in, perhaps on the other core. Interrupts stay masked
+ * (and the thread stays in "handler mode") until the task is back on its own stack, so a tick
+ * can't land on the handler or the kernel while they switch.
+ */
+static void host_stop(uint exception) {
+    host_thread_t *thread = host_this_thread();
+    uint32_t was_masked = thread->masked;
+    host_core_t *core;
+    host_context_t *task;
+
+    thread->masked = 1;
+    core = &host_cores[thread->core];
+    if(exception == HOST_SYSTICK) core->tick_pending = false;
+    if(exception == HOST_PENDSV) core->switch_pending = false;
+    thread->exception = exception;
+    task = core->running;
+    core->stopping = task;
+    makecontext(&core->handler, host_handler, 0);
+    swapcontext(&task->context, &core->handler);
+
+    // switched back in, by whichever core picked the task
+    thread = host_this_thread();
+    thread->exception = 0;
+    if(was_masked) thread->masked = 1;
+    else host_unmask();
+}
+
+/**
+ * @brief Where every task's context starts
+ * \ingroup Intern
+ * Calls the task function with its argument, then ends the task, like the LR the device
+ * puts in a new task's exception frame.
+ */
+static void host_task_start(void) {
+    host_thread_t *thread = host_this_thread();
+    host_context_t *task = host_cores[thread->core].running;
+
+    thread->exception = 0;
+    host_unmask();
+    ((void (*)(uintptr_t)) task->start)(task->argument);
+    piccolo_end_task();
+}
+
+/**
+ * @brief Yield: stop the task, for the fast switch (PendSV) or the scheduler loop (SVCall)
+ * \ingroup Intern
+ */
+void __piccolo_host_yield(void) {
+    host_stop(PICCOLO_OS_FAST_SWITCH ? HOST_PENDSV : HOST_SVCALL);
+}
+
+/**
+ * @brief Set up a task's context
+ * \ingroup Intern
+ * @param task_stack the top of the task block's stack
+ * @param pointer_to_task_function the task function
+ * @param starting_argument its argument
+ * @return uint32_t* what the kernel keeps as the task's stack pointer: its host context
+ */
+uint32_t *__piccolo_os_create_task(uint32_t *task_stack,
+            void (*pointer_to_task_function)(void), uintptr_t starting_argument) {
+    host_context_t **bucket = &host_contexts[((uintptr_t) task_stack >> 4) & (HOST_CONTEXT_BUCKETS - 1)];
+    host_context_t *context;
+    uint32_t save = save_and_disable_interrupts();
+
+    pthread_mutex_lock(&host_mutex);
+    for(context = *bucket; context && context->stack_top != task_stack; context = context->next);
+    if(!context) {
+        if(!(context = malloc(sizeof(host_context_t)))) panic("no memory for a task context");
+        context->stack_top = task_stack;
+        context->next = *bucket;
+        *bucket = context;
+    }
+    pthread_mutex_unlock(&host_mutex);
+
+    context->start = pointer_to_task_function;
+    context->argument = starting_argument;
+    getcontext(&context->context);
+    context->context.uc_stack.ss_sp = context->stack;
+    context->context.uc_stack.ss_size = sizeof(context->stack);
+    context->context.uc_link = NULL;
+    sigemptyset(&context->context.uc_sigmask);     // tasks take ticks
+    makecontext(&context->context, host_task_start, 0);
+    restore_interrupts(save);
+    return (uint32_t *) context;
+}
+
+/**
+ * @brief Switch the scheduler to handler mode
+ * \ingroup Intern
+ * From here on the thread is the core's kernel. Also sets up the core's handler context.
+ */
+void __piccolo_task_init(void) {
+    host_thread_t *thread = host_this_thread();
+    host_core_t *core = &host_cores[thread->core];
+
+    thread->exception = HOST_SVCALL;
+    if(!(core->handler_stack = malloc(HOST_HANDLER_STACK_SIZE))) panic("no memory for a handler stack");
+    getcontext(&core->handler);     // SIGALRM is blocked here, so in the handler too
+    core->handler.uc_stack.ss_sp = core->handler_stack;
+    core->handler.uc_stack.ss_size = HOST_HANDLER_STACK_SIZE;
+    core->handler.uc_link = NULL;
+}
+
+/**
+ * @brief Run a task until it stops, and go back to the scheduler loop
+ * \ingroup Intern
+ * @param stack the task's stack pointer, its host context
+ * @return uint32_t* the stack pointer of the task which came back, perhaps another after fast switches
+ */
+uint32_t *__piccolo_pre_switch(uint32_t *stack) {
+    host_core_t *core = &host_cores[get_core_num()];
+    host_context_t *task = (host_context_t *) stack;
+
+    core->running = task;
+    swapcontext(&core->kernel, &task->context);
+    return (uint32_t *) core->stopped;
+}
+
+/**
+ * @brief SysTick
+ * \ingroup Intern
+ * Preempts the running task, or leaves the tick pending when interrupts are masked or the
+ * core is in the kernel. A tick the kernel cleared is ignored: SIGALRM stays queued while
+ * the kernel runs, and is only delivered when the next task starts.
+ */
+static void host_systick(int signal) {
+    host_thread_t *thread = host_this_thread();
+    host_core_t *core = &host_cores[thread->core];
+
+    // the tick thread made it pending. The kernel may have cleared it since.
+    if(core->tick_pending && !thread->masked && !thread->exception) host_stop(HOST_SYSTICK);
+}
+
+/**
+ * @brief The tick thread: SysTick for both cores
+ * \ingroup Intern
+ * Both cores tick together, once every \ref PICCOLO_OS_TIME_SLICE microseconds, which is what
+ * the kernel sets rvr to. The tick is made pending, as the NVIC would, and SIGALRM delivers it.
+ */
+static void *host_tick_thread(void *unused) {
+    struct timespec next, now;
+    uint core;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while(1) {
+        next.tv_nsec += (PICCOLO_OS_TIME_SLICE ? PICCOLO_OS_TIME_SLICE : 1000) * 1000L;
+        if(next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if(now.tv_sec > next.tv_sec + 1) next = now;     // the host fell far behind: don't catch up
+        for(core = 0; core < 2; core++)
+            if(host_cores[core].started && host_cores[core].systick.rvr
+                    && (host_cores[core].systick.csr & HOST_SYSTICK_ON) == HOST_SYSTICK_ON) {
+                host_cores[core].tick_pending = true;
+                pthread_kill(host_cores[core].thread, SIGALRM);
+            }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Set up the simulation, before main()
+ * \ingroup Intern
+ * The thread running main() is core 0. SIGALRM is blocked, so only a task's context takes ticks,
+ * and every thread created from here on starts with it blocked.
+ */
+static __attribute__((constructor)) void host_init(void) {
+    struct sigaction action = {0};
+    pthread_condattr_t attributes;
+    pthread_t tick_thread;
+    sigset_t alarm;
+
+    sigemptyset(&alarm);
+    sigaddset(&alarm, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &alarm, NULL);
+    action.sa_handler = host_systick;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGALRM, &action, NULL);
+
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&host_event_cond, &attributes);
+
+    host_cores[0].thread = pthread_self();
+    host_cores[0].started = true;
+    pthread_create(&tick_thread, NULL, host_tick_thread, NULL);
+}
+
+static void *host_core1(void *entry) {
+    host_this_thread()->core = 1;
+    ((void (*)(void)) entry)();
+    return NULL;
+}
+
+void multicore_launch_core1(void (*entry)(void)) {
+    pthread_attr_t attributes;
+
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, HOST_CORE_STACK_SIZE);
+    if(pthread_create(&host_cores[1].thread, &attributes, host_core1, (void *) entry)) panic("can't start core 1");
+    host_cores[1].started = true;
+}
+
+/*
+ * Never called: the host port does what these handlers do (see above), but the kernel installs them.
+ */
+void __isr_SVCALL(void) {
+    panic("__isr_SVCALL called on the host");
+}
+
+void __isr_PENDSV(void) {
+    panic("__isr_PENDSV called on the host");
+}
+
+exception_handler_t exception_set_exclusive_handler(enum exception_number num, exception_handler_t handler) {
+    exception_handler_t original = host_exception_handlers[VTABLE_FIRST_IRQ + num];
+
+    host_exception_handlers[VTABLE_FIRST_IRQ + num] = handler;
+    return original;
+}
+
+void exception_restore_handler(enum exception_number num, exception_handler_t original_handler) {
+    host_exception_handlers[VTABLE_FIRST_IRQ + num] = original_handler;
+}
+
+/*
+ * Spin locks
+ */
+
+spin_lock_t *spin_lock_instance(uint lock_num) {
+    return &host_spin_locks[lock_num];
+}
+
+uint spin_lock_get_num(spin_lock_t *lock) {
+    return (uint) (lock - host_spin_locks);
+}
+
+void spin_lock_unsafe_blocking(spin_lock_t *lock) {
+    uint spins = 0;
+
+    while(__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE))
+        while(*lock)
+            if(++spins % HOST_SPINS == 0) sched_yield();    // the owner may be waiting for this CPU
+}
+
+void spin_unlock_unsafe(spin_lock_t *lock) {
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+uint32_t spin_lock_blocking(spin_lock_t *lock) {
+    uint32_t save = save_and_disable_interrupts();
+
+    spin_lock_unsafe_blocking(lock);
+    return save;
+}
+
+bool is_spin_locked(spin_lock_t *lock) {
+    return *lock != 0;
+}
+
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq) {
+    spin_unlock_unsafe(lock);
+    restore_interrupts(saved_irq);
+}
+
+spin_lock_t *spin_lock_init(uint lock_num) {
+    spin_lock_t *lock = spin_lock_instance(lock_num);
+
+    spin_unlock_unsafe(lock);
+    return lock;
+}
+
+uint next_striped_spin_lock_num(void) {
+    static uint next = PICO_SPINLOCK_ID_STRIPED_FIRST;
+    uint lock_num = __atomic_fetch_add(&next, 1, __ATOMIC_RELAXED);
+
+    return PICO_SPINLOCK_ID_STRIPED_FIRST
+        + (lock_num - PICO_SPINLOCK_ID_STRIPED_FIRST) % (PICO_SPINLOCK_ID_STRIPED_LAST - PICO_SPINLOCK_ID_STRIPED_FIRST + 1);
+}
+
+void spin_lock_claim(uint lock_num) {
+    if(__atomic_fetch_or(&host_spin_locks_claimed, 1u << lock_num, __ATOMIC_SEQ_CST) & (1u << lock_num))
+        panic("Spinlock %d is already claimed", lock_num);
+}
+
+void spin_lock_unclaim(uint lock_num) {
+    __atomic_fetch_and(&host_spin_locks_claimed, ~(1u << lock_num), __ATOMIC_SEQ_CST);
+}
+
+int spin_lock_claim_unused(bool required) {
+    uint lock_num;
+
+    for(lock_num = PICO_SPINLOCK_ID_CLAIM_FREE_FIRST; lock_num <= PICO_SPINLOCK_ID_CLAIM_FREE_LAST; lock_num++)
+        if(!(__atomic_fetch_or(&host_spin_locks_claimed, 1u << lock_num, __ATOMIC_SEQ_CST) & (1u << lock_num)))
+            return lock_num;
+    if(required) panic("No spinlocks are available");
+    return -1;
+}
+
+bool spin_lock_is_claimed(uint lock_num) {
+    return (host_spin_locks_claimed & (1u << lock_num)) != 0;
+}
+
+/*
+ * The event register, and the alarms which end a wait for an event
+ */
+
+void __sev(void) {
+    __atomic_store_n(&host_cores[0].event, true, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&host_cores[1].event, true, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&host_event_sleepers, __ATOMIC_SEQ_CST)) {
+        uint32_t save = save_and_disable_interrupts();
+
+        pthread_mutex_lock(&host_event_mutex);
+        pthread_cond_broadcast(&host_event_cond);
+        pthread_mutex_unlock(&host_event_mutex);
+        restore_interrupts(save);
+    }
+}
+
+/**
+ * @brief Run the callbacks of this core's alarms which are due, as their interrupts would
+ * \ingroup Intern
+ */
+static void host_fire_alarms(uint core) {
+    host_thread_t *thread = host_this_thread();
+    uint exception = thread->exception;
+    uint alarm_num;
+
+    for(alarm_num = 0; alarm_num < NUM_TIMERS; alarm_num++) {
+        host_alarm_t *alarm = &host_alarms[alarm_num];
+
+        if(alarm->armed && alarm->core == core && time_reached(alarm->target)) {
+            alarm->armed = false;
+            thread->exception = VTABLE_FIRST_IRQ + TIMER_IRQ_0 + alarm_num;
+            if(alarm->callback) alarm->callback(alarm_num);
+            thread->exception = exception;
+        }
+    }
+}
+
+/**
+ * @brief Wait for an event, an alarm of this core, or `until`
+ * \ingroup Intern
+ * Like WFE: returns at once if the event register was set, and clears it. Never sleeps longer
+ * than \ref HOST_WFE_MAX_US, since the callers all loop and look again.
+ */
+static void host_wait_for_event(absolute_time_t until) {
+    uint core_num = get_core_num();
+    host_core_t *core = &host_cores[core_num];
+    absolute_time_t deadline = delayed_by_us(get_absolute_time(), HOST_WFE_MAX_US);
+    struct timespec wake;
+    int64_t wait_us;
+    uint32_t save;
+    uint alarm_num;
+
+    if(__atomic_exchange_n(&core->event, false, __ATOMIC_SEQ_CST)) return;
+
+    save = save_and_disable_interrupts();
+    if(until < deadline) deadline = until;
+    for(alarm_num = 0; alarm_num < NUM_TIMERS; alarm_num++)
+        if(host_alarms[alarm_num].armed && host_alarms[alarm_num].core == core_num
+                && host_alarms[alarm_num].target < deadline)
+            deadline = host_alarms[alarm_num].target;
+
+    wait_us = absolute_time_diff_us(get_absolute_time(), deadline);
+    if(wait_us > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &wake);
+        wake.tv_sec += wait_us / 1000000;
+        wake.tv_nsec += (wait_us % 1000000) * 1000;
+        if(wake.tv_nsec >= 1000000000L) {
+            wake.tv_sec++;
+            wake.tv_nsec -= 1000000000L;
+        }
+        pthread_mutex_lock(&host_event_mutex);
+        __atomic_add_fetch(&host_event_sleepers, 1, __ATOMIC_SEQ_CST);
+        while(!__atomic_load_n(&core->event, __ATOMIC_SEQ_CST)
+                && pthread_cond_timedwait(&host_event_cond, &host_event_mutex, &wake) == 0);
+        __atomic_sub_fetch(&host_event_sleepers, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&host_event_mutex);
+    }
+    core->event = false;
+
+    host_fire_alarms(core_num);
+    restore_interrupts(save);
+}
+
+void __wfe(void) {
+    host_wait_for_event(at_the_end_of_time);
+}
+
+void __wfi(void) {
+    host_wait_for_event(at_the_end_of_time);
+}
+
+bool best_effort_wfe_or_timeout(absolute_time_t timeout_timestamp) {
+    if(time_reached(timeout_timestamp)) return true;
+    host_wait_for_event(timeout_timestamp);
+    return time_reached(timeout_timestamp);
+}
+
+void hardware_alarm_claim(uint alarm_num) {
+    pthread_mutex_lock(&host_mutex);
+    if(host_alarms[alarm_num].claimed) panic("Hardware alarm %d already claimed", alarm_num);
+    host_alarms[alarm_num].claimed = true;
+    pthread_mutex_unlock(&host_mutex);
+}
+
+int hardware_alarm_claim_unused(bool required) {
+    int alarm_num;
+
+    pthread_mutex_lock(&host_mutex);
+    for(alarm_num = 0; alarm_num < NUM_TIMERS && host_alarms[alarm_num].claimed; alarm_num++);
+    if(alarm_num < NUM_TIMERS) host_alarms[alarm_num].claimed = true;
+    else alarm_num = -1;
+    pthread_mutex_unlock(&host_mutex);
+    if(alarm_num < 0 && required) panic("No alarms available");
+    return alarm_num;
+}
+
+void hardware_alarm_unclaim(uint alarm_num) {
+    host_alarms[alarm_num].claimed = false;
+}
+
+bool hardware_alarm_is_claimed(uint alarm_num) {
+    return host_alarms[alarm_num].claimed;
+}
+
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback) {
+    host_alarms[alarm_num].core = get_core_num();
+    host_alarms[alarm_num].callback = callback;
+}
+
+/**
+ * @brief Arm an alarm
+ * \ingroup Intern
+ * @return true if the target has already passed, so the alarm was not armed (as the SDK does)
+ */
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t t) {
+    if(time_reached(t)) return true;
+    host_alarms[alarm_num].target = t;
+    host_alarms[alarm_num].armed = true;
+    return false;
+}
+
+void hardware_alarm_cancel(uint alarm_num) {
+    host_alarms[alarm_num].armed = false;
+}
+
+void hardware_alarm_force_irq(uint alarm_num) {
+    host_alarms[alarm_num].target = 0;
+    host_alarms[alarm_num].armed = true;
+    __sev();
+}
@@ -0,0 +1,278 @@
+/**
+ * @file sdk.c
+ * @brief Piccolo OS host simulation: the rest of the Pico SDK
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Time, sleeping, the console, GPIO, semaphores and the locking around the C library. The
+ * semaphores are the SDK's, built on the lock_core hooks, so they block the task through the
+ * Piccolo OS overrides as they do on the device.
+ *
+ * As pico_malloc and pico_stdio do on the device, malloc() and printf() and friends are
+ * wrapped at link time, and run with interrupts masked. A task preempted inside the C
+ * library would leave its locks held by the thread, which the next task on that thread
+ * could then take too.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "pico/stdlib.h"
+#include "pico/sem.h"
+#include "hardware/sync.h"
+
+/*
+ * Time
+ */
+
+static struct timespec host_boot_time;
+
+static __attribute__((constructor)) void host_boot(void) {
+    clock_gettime(CLOCK_MONOTONIC, &host_boot_time);
+}
+
+uint64_t time_us_64(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) (now.tv_sec - host_boot_time.tv_sec) * 1000000
+        + (now.tv_nsec - host_boot_time.tv_nsec) / 1000;
+}
+
+void busy_wait_until(absolute_time_t t) {
+    while(!time_reached(t)) tight_loop_contents();
+}
+
+void busy_wait_us(uint64_t delay_us) {
+    busy_wait_until(delayed_by_us(get_absolute_time(), delay_us));
+}
+
+void busy_wait_us_32(uint32_t delay_us) {
+    busy_wait_us(delay_us);
+}
+
+void busy_wait_ms(uint32_t delay_ms) {
+    busy_wait_us(delay_ms * 1000ull);
+}
+
+void sleep_until(absolute_time_t target) {
+    sync_internal_yield_until_before(target);       // a task sleeps in the scheduler
+    while(!best_effort_wfe_or_timeout(target)) tight_loop_contents();
+}
+
+void sleep_us(uint64_t us) {
+    sleep_until(make_timeout_time_us(us));
+}
+
+void sleep_ms(uint32_t ms) {
+    sleep_us(ms * 1000ull);
+}
+
+/*
+ * Console, GPIO and panic
+ */
+
+bool stdio_init_all(void) {
+    setvbuf(stdout, NULL, _IOLBF, 0);   // a line at a time even into a pipe, like a serial console
+    return true;
+}
+
+static uint32_t host_gpio_out;
+
+void gpio_init(uint gpio) {
+    host_gpio_out &= ~(1u << gpio);
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+}
+
+void gpio_put(uint gpio, bool value) {
+    if(value) host_gpio_out |= 1u << gpio;
+    else host_gpio_out &= ~(1u << gpio);
+}
+
+bool gpio_get(uint gpio) {
+    return (host_gpio_out >> gpio) & 1;
+}
+
+void panic(const char *fmt, ...) {
+    va_list args;
+
+    save_and_disable_interrupts();
+    fputs("\n*** PANIC ***\n\n", stderr);
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+    abort();
+}
+
+/*
+ * The C library, with interrupts masked
+ */
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *mem, size_t size);
+void __real_free(void *mem);
+int __real_vprintf(const char *format, va_list args);
+int __real_puts(const char *string);
+int __real_putchar(int c);
+
+void *__wrap_malloc(size_t size) {
+    uint32_t save = save_and_disable_interrupts();
+    void *mem = __real_malloc(size);
+
+    restore_interrupts(save);
+    return mem;
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    uint32_t save = save_and_disable_interrupts();
+    void *mem = __real_calloc(count, size);
+
+    restore_interrupts(save);
+    return mem;
+}
+
+void *__wrap_realloc(void *mem, size_t size) {
+    uint32_t save = save_and_disable_interrupts();
+
+    mem = __real_realloc(mem, size);
+    restore_interrupts(save);
+    return mem;
+}
+
+void __wrap_free(void *mem) {
+    uint32_t save = save_and_disable_interrupts();
+
+    __real_free(mem);
+    restore_interrupts(save);
+}
+
+int __wrap_vprintf(const char *format, va_list args) {
+    uint32_t save = save_and_disable_interrupts();
+    int printed = __real_vprintf(format, args);
+
+    restore_interrupts(save);
+    return printed;
+}
+
+int __wrap_printf(const char *format, ...) {
+    va_list args;
+    int printed;
+
+    va_start(args, format);
+    printed = __wrap_vprintf(format, args);
+    va_end(args);
+    return printed;
+}
+
+int __wrap_puts(const char *string) {
+    uint32_t save = save_and_disable_interrupts();
+    int printed = __real_puts(string);
+
+    restore_interrupts(save);
+    return printed;
+}
+
+int __wrap_putchar(int c) {
+    uint32_t save = save_and_disable_interrupts();
+
+    c = __real_putchar(c);
+    restore_interrupts(save);
+    return c;
+}
+
+/*
+ * Semaphores, as in the SDK's pico_sync
+ */
+
+void lock_init(lock_core_t *core, uint lock_num) {
+    core->spin_lock = spin_lock_instance(lock_num);
+}
+
+void sem_init(semaphore_t *sem, int16_t initial_permits, int16_t max_permits) {
+    lock_init(&sem->core, next_striped_spin_lock_num());
+    sem->permits = initial_permits;
+    sem->max_permits = max_permits;
+    __mem_fence_release();
+}
+
+int sem_available(semaphore_t *sem) {
+    return *(volatile int16_t *) &sem->permits;
+}
+
+void sem_acquire_blocking(semaphore_t *sem) {
+    do {
+        uint32_t save = spin_lock_blocking(sem->core.spin_lock);
+
+        if(sem->permits > 0) {
+            sem->permits--;
+            lock_internal_spin_unlock_with_notify(&sem->core, save);
+            break;
+        }
+        lock_internal_spin_unlock_with_wait(&sem->core, save);
+    } while(true);
+}
+
+bool sem_acquire_block_until(semaphore_t *sem, absolute_time_t until) {
+    do {
+        uint32_t save = spin_lock_blocking(sem->core.spin_lock);
+
+        if(sem->permits > 0) {
+            sem->permits--;
+            lock_internal_spin_unlock_with_notify(&sem->core, save);
+            return true;
+        }
+        if(lock_internal_spin_unlock_with_best_effort_wait_or_timeout(&sem->core, save, until)) return false;
+    } while(true);
+}
+
+bool sem_acquire_timeout_ms(semaphore_t *sem, uint32_t timeout_ms) {
+    return sem_acquire_block_until(sem, make_timeout_time_ms(timeout_ms));
+}
+
+bool sem_acquire_timeout_us(semaphore_t *sem, uint32_t timeout_us) {
+    return sem_acquire_block_until(sem, make_timeout_time_us(timeout_us));
+}
+
+bool sem_try_acquire(semaphore_t *sem) {
+    uint32_t save = spin_lock_blocking(sem->core.spin_lock);
+
+    if(sem->permits > 0) {
+        sem->permits--;
+        lock_internal_spin_unlock_with_notify(&sem->core, save);
+        return true;
+    }
+    spin_unlock(sem->core.spin_lock, save);
+    return false;
+}
+
+bool sem_release(semaphore_t *sem) {
+    uint32_t save = spin_lock_blocking(sem->core.spin_lock);
+
+    if(sem->permits < sem->max_permits) {
+        sem->permits++;
+        lock_internal_spin_unlock_with_notify(&sem->core, save);
+        return true;
+    }
+    spin_unlock(sem->core.spin_lock, save);
+    return false;
+}
+
+void sem_reset(semaphore_t *sem, int16_t permits) {
+    uint32_t save = spin_lock_blocking(sem->core.spin_lock);
+
+    if(permits > sem->permits) {
+        sem->permits = permits;
+        lock_internal_spin_unlock_with_notify(&sem->core, save);
+    } else {
+        sem->permits = permits;
+        spin_unlock(sem->core.spin_lock, save);
+    }
+}
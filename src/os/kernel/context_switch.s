@@ -39,6 +39,7 @@ __isr_SVCALL:
     stmia r0!, {r4,r5, r6, r7}
     subs r0, #16 /* fix r0 to point to end of stack frame, 36 bytes from original r0 */
 
+__piccolo_kernel_return:    /* __isr_PENDSV joins here to go back to the scheduler loop */
 	/* load kernel state from stack*/
 
     /*
@@ -68,6 +69,54 @@ __isr_SVCALL:
 
     pop {pc}
 
+.type __isr_PENDSV, %function
+.global __isr_PENDSV
+__isr_PENDSV:
+	/* Save the user state exactly as __isr_SVCALL does */
+	mrs r0, psp
+
+    subs r0, #4
+    mov r1, lr
+    str r1, [r0]
+
+    subs r0, #16
+    stmia r0!, {r4,r5, r6, r7}
+    
+    mov	r4, r8
+	mov	r5, r9
+	mov	r6, r10
+	mov	r7, r11
+    subs r0, #32
+    stmia r0!, {r4,r5, r6, r7}
+    subs r0, #16 /* fix r0 to point to end of stack frame, 36 bytes from original r0 */
+
+	/* ask the scheduler for the next task. r0 is still needed if we fall back to the scheduler loop */
+    push {r0, r1}  /* two words keeps the stack 8 byte aligned */
+    ldr r3, =__piccolo_fast_switch
+    blx r3
+    pop {r1, r2}
+    cmp r0, #0
+    bne 1f
+    mov r0, r1
+    b __piccolo_kernel_return  /* NULL: let piccolo_start() decide */
+
+1:
+	/* load the next task's user state, as __piccolo_pre_switch does */
+    ldmia	r0!,{r4-r7}
+	mov	r8, r4
+	mov	r9, r5
+	mov	r10, r6
+	mov	r11, r7
+	ldmia	r0!,{r4-r7}
+    ldmia	r0!,{r1}
+    mov lr, r1
+	msr psp, r0
+
+	/* and return straight to it */
+	bx lr
+
+.ltorg
+
 .type __piccolo_pre_switch,%function
 .thumb_func
 .global __piccolo_pre_switch
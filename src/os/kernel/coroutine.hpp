@@ -0,0 +1,437 @@
+/**
+ * @file coroutine.hpp
+ * @brief Piccolo OS C++20 coroutine tasks
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Header only. A `piccolo::task<T>` is a coroutine returning a T. It starts when it is awaited, by another
+ * coroutine task, and `co_await`ing it runs it to completion (suspending as often as it needs to) and gives its
+ * result. A `piccolo::task<>` started with `piccolo::spawn()` runs on its own: each one is driven by a lightweight
+ * task (see `piccolo_lite_create()`), so it runs on its core's runner task stack, and costs only its coroutine
+ * frames, which come from the kernel's frame pools (`piccolo_frame_allocate()`), not the heap.
+ *
+ * While it waits on one of the awaitables here (and only those) a coroutine task gives the core to the others:
+ *
+ * @code
+ * piccolo::task<bool> modem_ready(piccolo::completion<int> &reply) {
+ *     bool acquired = co_await piccolo::acquire(&uart_lock, 100);
+ *
+ *     if(!acquired) co_return false;
+ *     send_command("AT");
+ *     int status = co_await reply;                 // completed by the UART receive task
+ *     sem_release(&uart_lock);
+ *     co_return status == 0;
+ * }
+ *
+ * piccolo::task<> modem(void) {
+ *     bool ready;
+ *     int32_t signalled;
+ *
+ *     while(!(ready = co_await modem_ready(reply))) co_await piccolo::sleep(1000);
+ *     while((signalled = co_await piccolo::get_signal(5000)) > 0) poll_modem();    // from piccolo_lite_send_signal()
+ * }
+ * @endcode
+ *
+ * Like a lightweight task, a coroutine task must not block its runner task with the blocking kernel calls
+ * (`piccolo_sleep()`, `sem_acquire_blocking()` and so on), which would hold up all the others on its core.
+ *
+ * @note Needs C++20 (GCC 10 or later). GCC 12.2 miscompiles a coroutine with no local variables which awaits
+ * straight in an `if` or `while` condition (its frame is corrupted), so assign such a result to a variable.
+ */
+
+#ifndef PICCOLO_COROUTINE_HPP
+#define PICCOLO_COROUTINE_HPP
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include "pico/sem.h"
+
+#include "kernel.h"
+
+namespace piccolo {
+
+template<typename T = void> class task;
+
+extern "C" piccolo_os_internals_t piccolo_ctx;
+
+/** @defgroup Intern The Piccolo Plus Internals
+ *
+ * @{
+ */
+
+namespace detail {
+
+/**
+ * @brief What drives a spawned coroutine task: its lightweight task, and where to resume it
+ *
+ * Roots are taken from the frame pools and never freed. The root of a task which has ended is reused by the
+ * next `spawn()`. (Its lightweight task's flags say it has ended once the runner has finished with it.)
+ */
+struct root {
+    piccolo_lite_task_t lite;                   /**< the lightweight task which resumes the coroutines **/
+    std::coroutine_handle<> top;                /**< the spawned task **/
+    std::coroutine_handle<> resume_at;          /**< the coroutine waiting innermost, to resume next **/
+    uint32_t wait;                              /**< what it waits on (\ref piccolo_lite_flag_values) **/
+    bool (*ready)(void *);                      /**< if not NULL, resume only once this returns true... **/
+    void *ready_argument;                       /**< ...for this **/
+    root *next;                                 /**< next of all the roots **/
+};
+
+/** All the roots, protected by the global lock **/
+inline root *roots;
+
+/** The root each core's runner is driving **/
+inline root *running[2];
+
+/**
+ * @brief Get the root of the coroutine task running on this core
+ *
+ */
+inline root *this_root(void) {
+    return running[get_core_num()];
+}
+
+/**
+ * @brief Have the running coroutine task wait on `flags`, then resume `handle`
+ *
+ */
+inline void wait(std::coroutine_handle<> handle, uint32_t flags) {
+    root *current = this_root();
+
+    current->resume_at = handle;
+    current->wait = flags;
+}
+
+/**
+ * @brief The lightweight task function of a spawned coroutine task
+ *
+ * Resumes the coroutine which is waiting, which runs until it (or one it awaits) waits again, or the spawned
+ * task ends, when its frame is destroyed.
+ */
+inline uint32_t drive(piccolo_lite_task_t *lite) {
+    root *current = (root *) lite->argument;
+
+    running[get_core_num()] = current;
+    if(current->ready && !current->ready(current->ready_argument)) return current->wait;     // woken too soon
+    current->ready = nullptr;
+    current->wait = PICCOLO_LITE_READY;
+    current->resume_at.resume();
+    if(!current->top.done()) return current->wait;
+    current->top.destroy();
+    return PICCOLO_LITE_ENDED;
+}
+
+/**
+ * @brief What a coroutine task's frame holds besides the coroutine itself. The parts which don't depend on T.
+ *
+ */
+struct promise_base {
+    std::coroutine_handle<> continuation;       /**< the coroutine awaiting this one, if any **/
+
+    /** Frames come from the frame pools **/
+    static void *operator new(std::size_t size) noexcept { return piccolo_frame_allocate(size); }
+    static void operator delete(void *frame, std::size_t size) { piccolo_frame_free(frame, size); }
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    /** When it ends, carry straight on with the coroutine awaiting it **/
+    struct final_awaiter {
+        bool await_ready() noexcept { return false; }
+        template<typename P> std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle) noexcept {
+            std::coroutine_handle<> continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    final_awaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { std::terminate(); }
+};
+
+template<typename T> struct promise : promise_base {
+    std::optional<T> value;                     /**< what the coroutine returned **/
+
+    task<T> get_return_object() noexcept;
+    static task<T> get_return_object_on_allocation_failure() noexcept;
+    template<typename U> void return_value(U &&result) { value.emplace(std::forward<U>(result)); }
+    T result() { return std::move(*value); }
+};
+
+template<> struct promise<void> : promise_base {
+    task<void> get_return_object() noexcept;
+    static task<void> get_return_object_on_allocation_failure() noexcept;
+    void return_void() noexcept {}
+    void result() {}
+};
+
+}
+
+/**@}**/
+
+/**
+ * @brief A coroutine returning a T
+ *
+ * Does nothing until it is awaited, or spawned (`spawn()`). A task whose frame could not be allocated is empty
+ * (it converts to false): check before awaiting one which may be, since awaiting it panics. `spawn()` takes empty
+ * tasks, and fails.
+ */
+template<typename T> class task {
+public:
+    using promise_type = detail::promise<T>;
+
+    task() noexcept = default;
+    explicit task(std::coroutine_handle<promise_type> handle) noexcept : handle(handle) {}
+    task(task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    task &operator=(task &&other) noexcept {
+        if(this != &other) {
+            if(handle) handle.destroy();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    task(const task &) = delete;
+    task &operator=(const task &) = delete;
+    ~task() { if(handle) handle.destroy(); }
+
+    explicit operator bool() const noexcept { return (bool) handle; }
+
+    /** Awaiting a task runs it, and carries on with its result when it ends. Awaiting an empty task panics. **/
+    auto operator co_await() && noexcept {
+        struct awaiter {
+            std::coroutine_handle<promise_type> handle;
+            bool await_ready() noexcept {
+                if(!handle) panic("Piccolo awaited a coroutine task with no frame\n");
+                return false;
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+            T await_resume() { return handle.promise().result(); }
+        };
+        return awaiter{handle};
+    }
+
+    /** Give up the coroutine, for `spawn()` **/
+    std::coroutine_handle<promise_type> release() noexcept { return std::exchange(handle, nullptr); }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+template<typename T> task<T> detail::promise<T>::get_return_object() noexcept {
+    return task<T>(std::coroutine_handle<detail::promise<T>>::from_promise(*this));
+}
+template<typename T> task<T> detail::promise<T>::get_return_object_on_allocation_failure() noexcept { return task<T>(); }
+inline task<void> detail::promise<void>::get_return_object() noexcept {
+    return task<void>(std::coroutine_handle<detail::promise<void>>::from_promise(*this));
+}
+inline task<void> detail::promise<void>::get_return_object_on_allocation_failure() noexcept { return task<void>(); }
+
+/**
+ * @brief Start a coroutine task running on its own
+ *
+ * @param coroutine the task. It is destroyed when it ends.
+ * @param affinity the cores it may run on (\ref piccolo_os_affinity)
+ * @return piccolo_lite_task_t* the lightweight task which drives it, to send it signals (`piccolo_lite_send_signal()`),
+ * or NULL if the task is empty or there is no memory, when the task is destroyed
+ *
+ * Call from a task, or before `piccolo_start()`.
+ */
+inline piccolo_lite_task_t *spawn(task<> &&coroutine, uint32_t affinity = PICCOLO_AFFINITY_ANY) {
+    std::coroutine_handle<> handle = coroutine.release();
+    detail::root *root;
+    uint32_t lock;
+
+    if(!handle) return nullptr;
+    // reuse the root of a task which has ended, if there is one
+    lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    for(root = detail::roots; root && !(root->lite.flags & PICCOLO_LITE_ENDED); root = root->next);
+    if(root) root->lite.flags = PICCOLO_LITE_READY;     // ours
+    spin_unlock(piccolo_ctx.piccolo_lock, lock);
+    if(!root) {
+        if(!(root = (detail::root *) piccolo_frame_allocate(sizeof(detail::root)))) {
+            handle.destroy();
+            return nullptr;
+        }
+        root->lite.flags = PICCOLO_LITE_READY;
+        lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+        root->next = detail::roots;
+        detail::roots = root;
+        spin_unlock(piccolo_ctx.piccolo_lock, lock);
+    }
+    root->top = root->resume_at = handle;
+    root->ready = nullptr;
+    if(!piccolo_lite_create_on(&root->lite, detail::drive, root, affinity)) {
+        handle.destroy();
+        root->lite.flags = PICCOLO_LITE_ENDED;         // free for the next one
+        return nullptr;
+    }
+    return &root->lite;
+}
+
+/**
+ * @brief Get the lightweight task driving the running coroutine task, for others to send signals to
+ *
+ */
+inline piccolo_lite_task_t *this_lite(void) {
+    return &detail::this_root()->lite;
+}
+
+/**
+ * @brief Let the other lightweight and coroutine tasks of the core run, then carry on
+ *
+ */
+struct yield {
+    bool await_ready() noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) noexcept { detail::wait(handle, PICCOLO_LITE_READY); }
+    void await_resume() noexcept {}
+};
+
+/**
+ * @brief Sleep until an absolute time
+ *
+ */
+struct sleep_until {
+    absolute_time_t until;                      /**< when to wake **/
+
+    explicit sleep_until(absolute_time_t until) noexcept : until(until) {}
+    bool await_ready() noexcept { return time_reached(until); }
+    void await_suspend(std::coroutine_handle<> handle) noexcept {
+        detail::this_root()->lite.wakeup.deadline = until;
+        detail::wait(handle, PICCOLO_LITE_SLEEPING);
+    }
+    void await_resume() noexcept {}
+};
+
+/**
+ * @brief Sleep for a number of milliseconds, as `piccolo_sleep()`
+ *
+ */
+struct sleep : sleep_until {
+    explicit sleep(uint32_t ms) noexcept : sleep_until(make_timeout_time_ms(ms)) {}
+};
+
+/**
+ * @brief Take a signal sent to the coroutine task, waiting for one for up to `timeout_ms` milliseconds (0 for no timeout)
+ *
+ * Gives 1 if a signal was taken, 0 on timeout. Signals are sent with `piccolo_lite_send_signal()`,
+ * to the lightweight task `spawn()` (or `this_lite()`) gave.
+ */
+struct get_signal {
+    uint32_t timeout_ms;                        /**< how long to wait, 0 for ever **/
+    bool taken = false;                         /**< a signal was taken without waiting **/
+
+    explicit get_signal(uint32_t timeout_ms = 0) noexcept : timeout_ms(timeout_ms) {}
+    bool await_ready() noexcept { return taken = piccolo_lite_get_signal(this_lite()) > 0; }
+    void await_suspend(std::coroutine_handle<> handle) noexcept {
+        if(timeout_ms) detail::this_root()->lite.wakeup.deadline = make_timeout_time_ms(timeout_ms);
+        detail::wait(handle, PICCOLO_LITE_GET_SIGNAL_BLOCKED | (timeout_ms ? PICCOLO_LITE_SLEEPING : 0));
+    }
+    int32_t await_resume() noexcept { return taken ? 1 : piccolo_lite_get_signal(this_lite()); }
+};
+
+/**
+ * @brief Acquire an SDK semaphore, waiting for up to `timeout_ms` milliseconds (0 for no timeout)
+ *
+ * Gives true if it was acquired, false on timeout. While the semaphore is taken the coroutine task waits on it
+ * like a task does (`piccolo_lite_wait_lock()`), and tries again each time it is released.
+ */
+struct acquire {
+    semaphore_t *semaphore;                     /**< what to acquire **/
+    uint32_t timeout_ms;                        /**< how long to wait, 0 for ever **/
+    absolute_time_t until;                      /**< when to give up **/
+    bool acquired = false;                      /**< it has been acquired **/
+
+    explicit acquire(semaphore_t *semaphore, uint32_t timeout_ms = 0) noexcept
+        : semaphore(semaphore), timeout_ms(timeout_ms), until(make_timeout_time_ms(timeout_ms)) {}
+
+    /** Try to acquire it. If it is taken, and the timeout has not passed, wait on it, and give false. **/
+    bool settled() noexcept {
+        piccolo_lite_task_t *lite = this_lite();
+
+        while(!(acquired = sem_try_acquire(semaphore))) {
+            if(timeout_ms && time_reached(until)) return true;
+            piccolo_lite_wait_lock(lite, &semaphore->core);     // before looking again, so a release wakes us
+            if(sem_available(semaphore) <= 0) return false;
+            piccolo_lite_wait_lock(lite, nullptr);
+        }
+        return true;
+    }
+
+    bool await_ready() noexcept { return settled(); }
+    void await_suspend(std::coroutine_handle<> handle) noexcept {
+        detail::root *root = detail::this_root();
+
+        root->ready = [](void *acquire) { return ((struct acquire *) acquire)->settled(); };
+        root->ready_argument = this;
+        if(timeout_ms) root->lite.wakeup.deadline = until;
+        detail::wait(handle, PICCOLO_LITE_SUSPENDED | (timeout_ms ? PICCOLO_LITE_SLEEPING : 0));
+    }
+    bool await_resume() noexcept { return acquired; }
+};
+
+/**
+ * @brief A result which one coroutine task waits for, and anything else (a task, an interrupt service handler,
+ * another coroutine task) provides
+ *
+ * One coroutine task may `co_await` it, which gives the value once `complete()` has been called.
+ * `reset()` makes it ready for the next result.
+ */
+template<typename T = void> class completion {
+public:
+    /** Provide the result, and wake the coroutine task waiting for it **/
+    template<typename... U> void complete(U &&... result) {
+        piccolo_lite_task_t *lite;
+
+        if constexpr(!std::is_void_v<T>) value.emplace(std::forward<U>(result)...);
+        done.store(true);                       // after the value, before looking for a waiter
+        if((lite = waiter.load())) piccolo_lite_wake(lite);
+    }
+
+    /** Whether it has been completed **/
+    bool ready() const noexcept { return done.load(); }
+
+    /** Forget the result, so it can be completed again **/
+    void reset() noexcept {
+        done.store(false);
+        waiter.store(nullptr);
+        if constexpr(!std::is_void_v<T>) value.reset();
+    }
+
+    auto operator co_await() noexcept {
+        struct awaiter {
+            completion &owner;
+            bool await_ready() noexcept { return owner.done.load(); }
+            bool await_suspend(std::coroutine_handle<> handle) noexcept {
+                detail::root *root = detail::this_root();
+
+                owner.waiter.store(&root->lite);    // before looking again, so complete() sees it or we see it done
+                if(owner.done.load()) return false;
+                root->ready = [](void *completion) { return ((class completion *) completion)->done.load(); };
+                root->ready_argument = &owner;
+                detail::wait(handle, PICCOLO_LITE_SUSPENDED);
+                return true;
+            }
+            T await_resume() {
+                if constexpr(!std::is_void_v<T>) return *owner.value;
+            }
+        };
+        return awaiter{*this};
+    }
+
+private:
+    struct empty {};
+    std::atomic<bool> done{false};
+    std::atomic<piccolo_lite_task_t *> waiter{nullptr};
+    std::conditional_t<std::is_void_v<T>, empty, std::optional<std::conditional_t<std::is_void_v<T>, int, T>>> value;
+};
+
+}
+
+#endif
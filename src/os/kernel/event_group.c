@@ -0,0 +1,155 @@
+/**
+ * @file event_group.c
+ * @brief Piccolo OS event groups
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * An event group is a word of event flags. Setting or clearing flags takes the global
+ * `piccolo_lock` (sending a signal takes the receiver's signal lock instead), and tells the
+ * schedulers that the tasks on their blocked queues may be able to run. A waiting task sits on the blocked queue with the
+ * group and the flags it wants recorded in its task structure, and the scheduler wakes it
+ * when the flags are set (or its timeout runs out), so nothing polls.
+ */
+
+#include "hardware/sync.h"
+
+#include "kernel.h"
+#include "run_queue.h"
+
+extern piccolo_os_internals_t piccolo_ctx;
+
+uint32_t __piccolo_event_group_wait(piccolo_event_group_t *group, uint32_t bits, bool wait_all,
+                                    bool clear, uint32_t timeout_ms);
+
+/**
+ * @brief Initialize an event group with all its flags clear
+ *
+ * @param group the event group
+ */
+void piccolo_event_group_init(piccolo_event_group_t *group) {
+    group->bits = 0;
+}
+
+/**
+ * @brief Set event flags in a group
+ *
+ * @param group the event group
+ * @param bits the flags to set
+ * @return uint32_t the flags set in the group afterwards
+ *
+ * Safe to call from interrupt service handlers and timer callbacks.
+ */
+uint32_t piccolo_event_group_set(piccolo_event_group_t *group, uint32_t bits) {
+    uint32_t lock, result;
+
+    lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    result = group->bits |= bits;
+    piccolo_blocked_changed();   // a waiting task may now be able to run
+    spin_unlock(piccolo_ctx.piccolo_lock, lock);
+    return result;
+}
+
+/**
+ * @brief Clear event flags in a group
+ *
+ * @param group the event group
+ * @param bits the flags to clear
+ * @return uint32_t the flags set in the group before they were cleared
+ *
+ * Safe to call from interrupt service handlers and timer callbacks.
+ */
+uint32_t piccolo_event_group_clear(piccolo_event_group_t *group, uint32_t bits) {
+    uint32_t lock, result;
+
+    lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    result = group->bits;
+    group->bits = result & ~bits;
+    spin_unlock(piccolo_ctx.piccolo_lock, lock);
+    return result;
+}
+
+/**
+ * @brief Get the event flags set in a group
+ *
+ * @param group the event group
+ * @return uint32_t the flags set in the group
+ */
+uint32_t piccolo_event_group_get(piccolo_event_group_t *group) {
+    return group->bits;
+}
+
+/**
+ * @brief Helper for the event group wait functions
+ *
+ * @param group the event group
+ * @param bits the flags to wait for
+ * @param wait_all true to wait until all of `bits` are set, false to wait for any one of them
+ * @param clear true to clear the flags waited for when the wait succeeds
+ * @param timeout_ms non zero if timeout enabled
+ * @return uint32_t the flags waited for which were set, or 0 on timeout
+ * \ingroup Intern
+ * If the condition already holds, return at once. Otherwise block until it does, or the timeout expires.
+ * The condition is checked (and the flags cleared) under the lock, so when several tasks wait with `clear`
+ * only one of them gets each setting of a flag.
+ */
+uint32_t __piccolo_event_group_wait(piccolo_event_group_t *group, uint32_t bits, bool wait_all,
+                                    bool clear, uint32_t timeout_ms) {
+    uint32_t lock, result;
+    bool we_blocked = false;
+    piccolo_os_task_t *task;
+
+    task = piccolo_get_task_id();
+    while(1) {
+        lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+        if(piccolo_event_group_satisfied(group->bits, bits, wait_all)) {
+            result = group->bits & bits;
+            if(clear) group->bits &= ~bits;
+            spin_unlock(piccolo_ctx.piccolo_lock, lock);
+            return result;
+        }
+        // we will block unless we already did and our timeout has expired
+        if(we_blocked && timeout_ms && time_reached(task->wakeup.deadline)) {
+            spin_unlock(piccolo_ctx.piccolo_lock, lock);
+            return 0;
+        }
+        // set time out (only the first time) and blocking flags
+        if(!we_blocked) task->wakeup.deadline = delayed_by_ms(get_absolute_time(), timeout_ms);
+        we_blocked = true;
+        task->event_group = group;
+        task->event_bits = bits;
+        task->event_wait_all = wait_all;
+        task->task_flags |= (PICCOLO_TASK_EVENT_BLOCKED | ((timeout_ms)? PICCOLO_TASK_SLEEPING:0));
+
+        // clear the lock and yield with flags set. This will block
+        spin_unlock(piccolo_ctx.piccolo_lock, lock);
+        piccolo_yield();
+    }
+}
+
+/**
+ * @brief Wait until any one of a set of event flags is set
+ *
+ * @param group the event group
+ * @param bits the flags to wait for
+ * @param clear true to clear `bits` in the group when the wait succeeds
+ * @param timeout_ms maximum time in ms to wait, or 0 to wait forever
+ * @return uint32_t the flags of `bits` which were set, or 0 if a timeout occurred
+ */
+uint32_t piccolo_event_group_wait_any(piccolo_event_group_t *group, uint32_t bits, bool clear, uint32_t timeout_ms) {
+    return __piccolo_event_group_wait(group, bits, false, clear, timeout_ms);
+}
+
+/**
+ * @brief Wait until all of a set of event flags are set
+ *
+ * @param group the event group
+ * @param bits the flags to wait for
+ * @param clear true to clear `bits` in the group when the wait succeeds
+ * @param timeout_ms maximum time in ms to wait, or 0 to wait forever
+ * @return uint32_t `bits`, or 0 if a timeout occurred
+ */
+uint32_t piccolo_event_group_wait_all(piccolo_event_group_t *group, uint32_t bits, bool clear, uint32_t timeout_ms) {
+    return __piccolo_event_group_wait(group, bits, true, clear, timeout_ms);
+}
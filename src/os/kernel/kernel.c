@@ -24,29 +24,37 @@
 #include "pico/stdlib.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "pico/multicore.h"
 #include "hardware/structs/systick.h"
 #include "hardware/exception.h"
 #include "hardware/irq.h"
 #include "hardware/sync.h"
-#include "hardware/structs/mpu.h"
+#include "hardware/timer.h"
 #include "pico/malloc.h"
 
 #include "kernel.h"
+#include "run_queue.h"
+#include "task_pool.h"
+#include "trace.h"
 
 
-uint32_t *__piccolo_os_create_task(uint32_t *stack,
-                                       void (*start)(void), uint32_t);
 void __piccolo_task_init(void);
 uint32_t *__piccolo_pre_switch(uint32_t *stack); 
 void __piccolo_task_init_stack(uint32_t *stack);
 uint32_t *__piccolo_os_create_task(uint32_t *task_stack,
-            void (*pointer_to_task_function)(void), uint32_t starting_argument);
-int32_t __piccolo_send_signal(piccolo_os_task_t* task,bool block, uint32_t timeout_ms);
-int32_t __piccolo_get_signal(bool block, uint32_t timeout_ms, bool get_all);
-void __piccolo_garbage_man(void);
-void __piccolo_idle( int32_t uSec);
+            void (*pointer_to_task_function)(void), uintptr_t starting_argument);
+piccolo_os_task_t* __piccolo_create_task(void (*pointer_to_task_function)(void), uintptr_t starting_argument,
+                                         uint32_t stack_size, const char *name, uint32_t affinity);
+void __piccolo_idle(uint32_t uSec);
+void __piccolo_idle_alarm(uint alarm_num);
 void __piccolo_start_core1(void);
+void __piccolo_check_blocked(piccolo_os_run_queue_t *run_queue);
+void __piccolo_wake_receiver(piccolo_os_task_t *task);
+void __piccolo_wake_senders(piccolo_os_task_t *to_task);
+void __piccolo_expire_timers(piccolo_os_run_queue_t *run_queue);
+piccolo_os_task_t *__piccolo_steal_task(uint core);
+uint32_t *__piccolo_fast_switch(uint32_t *stack_ptr);
 
 
 piccolo_os_internals_t piccolo_ctx;
@@ -79,6 +87,8 @@ piccolo_os_task_t* piccolo_get_task_id(){
 }
 
 
+#if !PICCOLO_OS_HOST    // the host port has its own (see host/port.c)
+
 /**
  * @brief Initialize user task stack for execution 
  * 
@@ -104,7 +114,7 @@ piccolo_os_task_t* piccolo_get_task_id(){
  * \note The starting arguement is placed in R0, but only used internally for the totally fake idle task.
  */
 uint32_t *__piccolo_os_create_task(uint32_t *task_stack,
-            void (*pointer_to_task_function)(void), uint32_t starting_argument) {
+            void (*pointer_to_task_function)(void), uintptr_t starting_argument) {
 
   /* This task_stack frame needs to mimic would be saved by hardware and by the
    * software (in isr_svcall) */
@@ -146,39 +156,119 @@ uint32_t *__piccolo_os_create_task(uint32_t *task_stack,
   return task_stack;
 }
 
+#endif
+
 /**
  * @brief Create a new task and initialize it's stack.
  * 
  * @param pointer_to_task_function The task function to call initially
  * @return Task identifier (Pointer ti task structure) or 0 if create failed
  * 
- * Allocates a new task and initializes its stack to the start of the given function.
- * Inserts the task at the end of the scheduler task list.
+ * Creates a task with the default stack size of \ref PICCOLO_OS_STACK_SIZE words
+ * (see `piccolo_create_task_ex()`).
  * Can be called to create a new task while the scheduler is running. 
  * (In other words, a running task can create another task at runtime.)
  * 
  */
 piccolo_os_task_t* piccolo_create_task(void (*pointer_to_task_function)(void)) {
-    piccolo_os_task_t* task, *last_task;
+    return __piccolo_create_task(pointer_to_task_function, 0, PICCOLO_OS_STACK_SIZE * sizeof(uint32_t), NULL,
+                                 PICCOLO_AFFINITY_ANY);
+}
 
-    // allocate the space for the task
-    task = (piccolo_os_task_t*) malloc(sizeof (piccolo_os_task_t));
+/**
+ * @brief Create a new task with a given stack size, starting argument and name.
+ * 
+ * @param pointer_to_task_function The task function to call initially
+ * @param argument Passed to the task function when it starts
+ * @param stack_size Size of the task stack in bytes (at least \ref PICCOLO_OS_MINIMUM_STACK_SIZE)
+ * @param name Task name for debugging output, or NULL. The string is not copied.
+ * @return Task identifier (Pointer to task structure) or 0 if create failed
+ * 
+ * Tasks which do little (helpers which wait for a signal and end, for example) can be given 
+ * a much smaller stack than the default, so many more of them fit in memory.
+ * Can be called to create a new task while the scheduler is running. 
+ */
+piccolo_os_task_t* piccolo_create_task_ex(void (*pointer_to_task_function)(void *), void *argument,
+                                          uint32_t stack_size, const char *name) {
+    if(stack_size < PICCOLO_OS_MINIMUM_STACK_SIZE) return NULL;
+    return __piccolo_create_task((void (*)(void)) pointer_to_task_function, (uintptr_t) argument, stack_size, name,
+                                 PICCOLO_AFFINITY_ANY);
+}
+
+/**
+ * @brief Create a new task which may only run on the given cores.
+ * 
+ * @param pointer_to_task_function The task function to call initially
+ * @param argument Passed to the task function when it starts
+ * @param stack_size Size of the task stack in bytes (at least \ref PICCOLO_OS_MINIMUM_STACK_SIZE)
+ * @param name Task name for debugging output, or NULL. The string is not copied.
+ * @param affinity The cores the task may run on (\ref piccolo_os_affinity)
+ * @return Task identifier (Pointer to task structure) or 0 if create failed
+ * 
+ * As `piccolo_create_task_ex()`, but the task starts on, and stays on, the cores in `affinity`.
+ * Without \ref PICCOLO_OS_MULTICORE only core 0 runs tasks, so a task pinned to core 1 is not created.
+ */
+piccolo_os_task_t* piccolo_create_task_on(void (*pointer_to_task_function)(void *), void *argument,
+                                          uint32_t stack_size, const char *name, uint32_t affinity) {
+    if(stack_size < PICCOLO_OS_MINIMUM_STACK_SIZE) return NULL;
+    return __piccolo_create_task((void (*)(void)) pointer_to_task_function, (uintptr_t) argument, stack_size, name,
+                                 affinity);
+}
+
+/**
+ * @brief Allocate a task and its stack, and make it ready to run.
+ * 
+ * \ingroup Intern
+ * @param pointer_to_task_function The task function to call initially
+ * @param starting_argument Value placed in R0 when the task starts
+ * @param stack_size Size of the task stack in bytes
+ * @param name Task name, or NULL
+ * @param affinity The cores the task may run on
+ * @return Task identifier (Pointer to task structure) or 0 if create failed
+ * 
+ * The task structure and its stack come from the task pool for the stack size (see \ref task_pool.c).
+ * Inserts the task at the end of the scheduler task list, and on the ready queue of the core
+ * with fewer tasks ready to run, of those it may run on.
+ */
+piccolo_os_task_t* __piccolo_create_task(void (*pointer_to_task_function)(void), uintptr_t starting_argument,
+                                         uint32_t stack_size, const char *name, uint32_t affinity) {
+    piccolo_os_task_t* task;
+    piccolo_os_run_queue_t *run_queue;
+
+    affinity &= piccolo_cores();
+    if(!affinity) return NULL;      // no core it may run on
+
+    // get the space for the task and its stack
+    task = piccolo_task_pool_allocate(stack_size);
     if(task == NULL) return task;   // fails
     
+    task->name = name;
+#if PICCOLO_OS_STACK_PAINTING
+    for(uint32_t i = 1; i < task->stack_size / sizeof(uint32_t); i++) task->stack[i] = PICCOLO_OS_STACK_PAINT;
+#endif
+    task->stack[0] = PICCOLO_OS_STACK_CANARY;
     task->task_flags = 0;  // Mark Task as runnable, and not running
-    task->wakeup = get_absolute_time();
+    task->priority = PICCOLO_OS_DEFAULT_PRIORITY;
+    task->affinity = affinity;
+    task->wakeup.deadline = get_absolute_time();
     task->signal_in = task->signal_out = 0;
     task->signal_limit = PICCOLO_OS_MAX_SIGNAL;
+    task->senders_blocked = 0;
+    task->mailbox = NULL;
+    task->message_size = 0;
+    task->event_group = NULL;
+    task->edf.period_us = 0;
+    task->edf.load = 0;
+    task->edf.scheduled = false;
+    task->edf.started_running = false;
+    task->statistics = (piccolo_os_task_statistics_t) {0};
 //    printf("Make task %d ",task->stack);
-    task->stack_ptr =
-        __piccolo_os_create_task(task->stack + PICCOLO_OS_STACK_SIZE, pointer_to_task_function,0);
+    task->stack_ptr = __piccolo_os_create_task(task->stack + task->stack_size / sizeof(uint32_t),
+                                               pointer_to_task_function, starting_argument);
     
     // Lock the task scheduler structure to insert in task list
     uint32_t lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
 
-    // Bail out the scheduler in the odd case that all the tasks were previously deleted
-    if(piccolo_ctx.current_task == NULL) piccolo_ctx.current_task = task;
-
     task->next_task = NULL;
     if(piccolo_ctx.task_list_head) {
         // there is already an existing task. Just tack the new one on the end
@@ -195,17 +285,297 @@ piccolo_os_task_t* piccolo_create_task(void (*pointer_to_task_function)(void)) {
     // and unlock and reenable interrupts
     spin_unlock(piccolo_ctx.piccolo_lock,lock_value);
 
+    PICCOLO_TRACE(PICCOLO_TRACE_TASK_CREATE, task, task->stack_size);
+
+    // Now it can be scheduled. Start it on the core with the fewest ready tasks, of those it may use
+    task->core = 0;
+    if(affinity == PICCOLO_AFFINITY_CORE1
+       || (affinity == PICCOLO_AFFINITY_ANY && piccolo_ctx.run_queue[1].ready_count < piccolo_ctx.run_queue[0].ready_count))
+        task->core = 1;
+    run_queue = &piccolo_ctx.run_queue[task->core];
+    lock_value = piccolo_run_queue_lock(run_queue);
+    piccolo_run_queue_make_ready(run_queue, task);
+    piccolo_run_queue_unlock(run_queue, lock_value);
+
   return task;
 }
 
+/**
+ * @brief Change the cores a task may run on
+ * 
+ * @param task the task
+ * @param affinity the cores it may run on from now on (\ref piccolo_os_affinity)
+ * @return true if the affinity was changed, false if it names no core which runs tasks, or the task is in 
+ * the EDF class (which keeps it on the core it was admitted to)
+ * 
+ * A ready or blocked task is moved to an allowed core at once, staying blocked if it was. A running 
+ * task moves when it next stops running. If that is the calling task, it yields so it moves now.
+ */
+bool piccolo_set_affinity(piccolo_os_task_t *task, uint32_t affinity) {
+    piccolo_os_run_queue_t *run_queue = piccolo_ctx.run_queue;
+    uint32_t lock_value, lock_value0, lock_value1;
+    bool yield = false;
+
+    affinity &= piccolo_cores();
+    if(!affinity || task->edf.period_us) return false;
+
+    // Tasks only change cores with the global lock and the lock of the core they leave held. Take both
+    // run queue locks too, in that order, since the task may be on either.
+    lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    lock_value0 = piccolo_run_queue_lock(&run_queue[0]);
+    lock_value1 = piccolo_run_queue_lock(&run_queue[1]);
+    if(task->task_flags & PICCOLO_TASK_RUNNING) {
+        task->affinity = affinity;
+        yield = task == piccolo_ctx.this_task[get_core_num()] && !piccolo_task_can_run_on(task, task->core);
+    }
+    else {
+        piccolo_run_queue_detach(&run_queue[task->core], task);
+        task->affinity = affinity;
+        if(!piccolo_task_can_run_on(task, task->core)) {
+            run_queue[task->core].statistics.migrations++;
+            task->core ^= 1;
+            task->statistics.migrations++;
+        }
+        piccolo_run_queue_attach(&run_queue[task->core], task);
+    }
+    piccolo_run_queue_unlock(&run_queue[1], lock_value1);
+    piccolo_run_queue_unlock(&run_queue[0], lock_value0);
+    spin_unlock(piccolo_ctx.piccolo_lock, lock_value);
+
+    __sev();        // the core the task is now on may be idle
+    if(yield) piccolo_yield();
+    return true;
+}
+
+/**
+ * @brief Get the cores a task may run on
+ * 
+ * @param task the task
+ * @return uint32_t its \ref piccolo_os_affinity mask
+ */
+uint32_t piccolo_get_affinity(piccolo_os_task_t *task) {
+    return task->affinity;
+}
+
+/**
+ * @brief Change the priority of a task
+ * 
+ * @param task the task
+ * @param priority its new priority, less than \ref PICCOLO_OS_PRIORITY_LEVELS. Higher numbers run first.
+ * @return true if the priority was changed, false if it is out of range
+ * 
+ * A ready task goes to the tail of the ready queue for its new priority, and preempts the task 
+ * running on its core if that has lower priority. A running task which drops below a ready task 
+ * gives way to it. A blocked task has the new priority when it is woken. For a task in the EDF class
+ * it is the priority it runs at when over budget.
+ */
+bool piccolo_set_priority(piccolo_os_task_t *task, uint32_t priority) {
+    piccolo_os_run_queue_t *run_queue;
+    piccolo_os_task_t *next_task;
+    uint32_t lock_value, run_queue_lock_value;
+
+    if(priority >= PICCOLO_OS_PRIORITY_LEVELS) return false;
+
+    // tasks only move between cores with the global lock held, so task->core can't change under us
+    lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    run_queue = &piccolo_ctx.run_queue[task->core];
+    run_queue_lock_value = piccolo_run_queue_lock(run_queue);
+    if(!(task->task_flags & (PICCOLO_TASK_RUNNING | PICCOLO_TASK_BLOCKING))) {
+        piccolo_run_queue_remove_ready(run_queue, task);
+        task->priority = priority;
+        piccolo_run_queue_make_ready(run_queue, task);
+    }
+    else {
+        task->priority = priority;
+        if((task->task_flags & PICCOLO_TASK_RUNNING) && (next_task = piccolo_run_queue_peek_ready(run_queue)))
+            piccolo_run_queue_preempt(run_queue, next_task);
+    }
+    piccolo_run_queue_unlock(run_queue, run_queue_lock_value);
+    spin_unlock(piccolo_ctx.piccolo_lock, lock_value);
+    return true;
+}
+
+/**
+ * @brief Get the priority of a task
+ * 
+ * @param task the task
+ * @return uint32_t its priority
+ */
+uint32_t piccolo_get_priority(piccolo_os_task_t *task) {
+    return task->priority;
+}
+
+/**
+ * @brief Set how long tasks of one priority run before another task of that priority gets a turn
+ * 
+ * @param priority the priority
+ * @param slice_us the time slice in microseconds, rounded up to whole ticks (\ref PICCOLO_OS_TIME_SLICE), 
+ * or 0 for no limit: a task runs until it yields, blocks or a task of higher priority is ready
+ * 
+ * A task of higher priority preempts whatever is left of a slice. Tasks which are ready already 
+ * keep the slice they were given.
+ */
+void piccolo_set_time_slice(uint32_t priority, uint32_t slice_us) {
+#if PICCOLO_OS_TIME_SLICE
+    if(priority < PICCOLO_OS_PRIORITY_LEVELS)
+        piccolo_ctx.time_slice[priority] = (slice_us + PICCOLO_OS_TIME_SLICE - 1) / PICCOLO_OS_TIME_SLICE;
+#endif
+}
+
+/**
+ * @brief How long the running task has run in its current EDF job since it was switched in
+ * 
+ * @param task the running task
+ * @return uint32_t microseconds not yet charged to the job's `used_us`
+ * \ingroup Intern
+ * From the switch in, or from the start of the job if it started part way through the slice.
+ */
+__force_inline static uint32_t __piccolo_job_ran(piccolo_os_task_t *task) {
+    return time_us_32() - (task->edf.started_running ? task->edf.started_at : task->switched_at);
+}
+
+/**
+ * @brief Put a task in the earliest deadline first (EDF) class, change its timing, or take it out
+ * 
+ * @param task the task
+ * @param period_us the time between the releases of its jobs, or 0 to make it a best effort task again
+ * @param budget_us the run time each job may take
+ * @param deadline_us the time after its release by which each job must be done, or 0 for the period
+ * @return true if the task was admitted (or left the class), false if the timing makes no sense
+ * (the budget must not be more than the deadline, nor the deadline more than the period), 
+ * or no core the task may run on has room for it (\ref PICCOLO_OS_EDF_MAX_LOAD). It is then unchanged.
+ * 
+ * The task is pinned to the least loaded core with room for it, and its first job is released now. 
+ * The task calls `piccolo_edf_wait()` when each job is done. A job runs ahead of all the best effort tasks 
+ * until it is done or has run for its budget, then at the task's priority until the next release. 
+ * Leaving the class gives the task back the affinity it had.
+ * 
+ * A task moves as for `piccolo_set_affinity()`: at once if it is not running, otherwise when it next stops.
+ */
+bool piccolo_set_edf(piccolo_os_task_t *task, uint32_t period_us, uint32_t budget_us, uint32_t deadline_us) {
+    piccolo_os_run_queue_t *run_queue = piccolo_ctx.run_queue;
+    uint32_t lock_value, lock_value0, lock_value1, affinity, load = 0;
+    int core, best = -1;
+    bool admitted, running, yield = false;
+
+    if(!deadline_us) deadline_us = period_us;
+    if(period_us) {
+        if(!budget_us || budget_us > deadline_us || deadline_us > period_us) return false;
+        load = (uint64_t) budget_us * 1000000 / deadline_us;
+    }
+
+    // Tasks only change cores with the global lock and the lock of the core they leave held. Take both
+    // run queue locks too, in that order, since the task may be on either.
+    // The loads are only changed with the global lock held.
+    lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    lock_value0 = piccolo_run_queue_lock(&run_queue[0]);
+    lock_value1 = piccolo_run_queue_lock(&run_queue[1]);
+    running = task->task_flags & PICCOLO_TASK_RUNNING;
+    if(!running) piccolo_run_queue_detach(&run_queue[task->core], task);    // before its queue changes
+
+    // give back the load it has now while looking for room
+    if(task->edf.period_us) run_queue[task->core].edf_load -= task->edf.load;
+    affinity = task->edf.period_us ? task->edf.affinity : task->affinity;
+    if(period_us) {
+        for(core = 0; core < 2; core++)
+            if(((affinity >> core) & 1) && run_queue[core].edf_load + load <= PICCOLO_OS_EDF_MAX_LOAD * 10000
+                    && (best < 0 || run_queue[core].edf_load < run_queue[best].edf_load)) best = core;
+    }
+    admitted = !period_us || best >= 0;
+    if(!admitted) {
+        if(task->edf.period_us) run_queue[task->core].edf_load += task->edf.load;
+    }
+    else if(!period_us) {
+        task->affinity = affinity;
+        task->edf.period_us = 0;
+        task->edf.load = 0;
+        task->edf.scheduled = false;
+    }
+    else {
+        task->affinity = 1u << best;
+        task->edf.affinity = affinity;
+        task->edf.period_us = period_us;
+        task->edf.budget_us = budget_us;
+        task->edf.deadline_us = deadline_us;
+        task->edf.load = load;
+        run_queue[best].edf_load += load;
+        task->edf.release = get_absolute_time();
+        task->edf.node.deadline = delayed_by_us(task->edf.release, deadline_us);
+        // a running task's job starts now, part way through its slice
+        task->edf.used_us = 0;
+        task->edf.started_at = time_us_32();
+        task->edf.started_running = running;
+        task->edf.scheduled = true;
+    }
+
+    if(running) yield = task == piccolo_ctx.this_task[get_core_num()] && !piccolo_task_can_run_on(task, task->core);
+    else {
+        if(!piccolo_task_can_run_on(task, task->core)) {
+            run_queue[task->core].statistics.migrations++;
+            task->core ^= 1;
+            task->statistics.migrations++;
+        }
+        piccolo_run_queue_attach(&run_queue[task->core], task);
+    }
+    piccolo_run_queue_unlock(&run_queue[1], lock_value1);
+    piccolo_run_queue_unlock(&run_queue[0], lock_value0);
+    spin_unlock(piccolo_ctx.piccolo_lock, lock_value);
+
+    __sev();        // the core the task is now on may be idle
+    if(yield) piccolo_yield();
+    return admitted;
+}
+
+/**
+ * @brief End the calling task's current EDF job, and wait for the release of the next one
+ * 
+ * A job which ends after its deadline is counted as a miss. The next job is released one period after this 
+ * one was, with its deadline that long after. The task sleeps until then, unless it is already late. A task 
+ * which has fallen a whole period behind starts its next job now, rather than catching up with jobs 
+ * which would all miss. For a task not in the EDF class, just yields.
+ */
+void piccolo_edf_wait(void) {
+    uint core = get_core_num();
+    piccolo_os_run_queue_t *run_queue = &piccolo_ctx.run_queue[core];
+    piccolo_os_task_t *task = (piccolo_os_task_t *) piccolo_ctx.this_task[core];
+    absolute_time_t now;
+    uint32_t lock_value, ran;
+
+    if(!task->edf.period_us) {
+        piccolo_yield();
+        return;
+    }
+    // With the lock held this task is not preempted, so stays on this core, and nothing else changes its EDF state
+    lock_value = piccolo_run_queue_lock(run_queue);
+    now = get_absolute_time();
+    ran = __piccolo_job_ran(task);
+    if(task->edf.scheduled && task->edf.used_us + ran > task->edf.budget_us) task->statistics.edf_overruns++;
+    if(absolute_time_diff_us(task->edf.node.deadline, now) > 0) task->statistics.edf_misses++;
+    task->statistics.edf_jobs++;
+
+    task->edf.release = delayed_by_us(task->edf.release, task->edf.period_us);
+    if(absolute_time_diff_us(task->edf.release, now) >= task->edf.period_us) task->edf.release = now;
+    task->edf.node.deadline = delayed_by_us(task->edf.release, task->edf.deadline_us);
+    // what this slice has run so far belongs to the job just done, so the next is charged from now
+    task->edf.used_us = 0;
+    task->edf.started_at = time_us_32();
+    task->edf.started_running = true;
+    task->edf.scheduled = true;
+    if(absolute_time_diff_us(now, task->edf.release) > 0) {
+        task->wakeup.deadline = task->edf.release;
+        task->task_flags |= PICCOLO_TASK_SLEEPING;
+    }
+    piccolo_run_queue_unlock(run_queue, lock_value);
+    piccolo_yield();
+}
+
 /**
  * @brief Ends the current task, never returns
  * 
  * Marks the current task as dead (ZOMBIE) and yields, so the scheduler can remove it.
  * (The scheduler must do this, since we cannot free the memory for a task
  * while it is running!). The scheduler will immediately remove a ZOMBIE task
- * from the scheduler chain, add it to the zombies list and signal the garbage
- * collector to return the task space to free memory.
+ * from the scheduler chain and return the task space to its task pool.
  * 
  * @note A task that executes a `return` will also be ended.
  */
@@ -259,7 +629,7 @@ void piccolo_sleep_until(absolute_time_t until) {
     if(time_reached(until)) return;
 
     task = piccolo_get_task_id();
-    task->wakeup = until;
+    task->wakeup.deadline = until;
     task->task_flags |= PICCOLO_TASK_SLEEPING;
     piccolo_yield();  
 }
@@ -269,40 +639,52 @@ void piccolo_sleep_until(absolute_time_t until) {
  * @param task pointer to task to send to
  * @param block true if blocking on send
  * @param timeout_ms non zero if timeout enabled on blocking
+ * @param message message to copy into the task's mailbox with the signal, or NULL
  * @return 1 if signal sent. <0 if no room, or timeout occurred on blocking
+ * (-2 if there is a message but the task has no mailbox)
  * \ingroup Intern
  * Send a signal to the designated task. If there is space the signal is sent.
+ * If the task has a mailbox, the message (or zeroes, for a plain signal) is copied into
+ * the slot for the signal before the signal is visible to the receiver.
  * If there is no room for the signal, return the error unless blocking was requested.
- * If blocking is necessary, start a timeout as well, if one was requested.
+ * If blocking is necessary, start a timeout as well, if one was requested, and keep blocking until
+ * the signal is sent or the timeout expires. A blocked sender is counted in the receiver's `senders_blocked`, 
+ * so the receiver knows to wake it when it takes a signal.
+ * If the receiver is blocked waiting for a signal, it is moved straight to its ready queue.
  * 
- * @note Since multiple senders are allowed, we must grab the spinlock. 
+ * @note Since multiple senders are allowed, we must grab a spinlock: the receiver's signal lock, which
+ * senders to tasks hashed to other signal locks, and the scheduler, do not wait for.
  */
-int32_t __piccolo_send_signal(piccolo_os_task_t* task,bool block, uint32_t timeout_ms){
-    uint32_t lock, inptr, flags; 
+int32_t __piccolo_send_signal(piccolo_os_task_t* task,bool block, uint32_t timeout_ms, const void *message){
+    uint32_t lock, inptr; 
     bool we_blocked = false;
     bool not_done = true;
     int32_t result = 1;
     piccolo_os_task_t* owntask;
+    spin_lock_t *signal_lock;
 
+    if(message && !task->mailbox) return -2;
     owntask = piccolo_get_task_id();
+    signal_lock = piccolo_signal_lock(task);
     do {
-        lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+        lock = spin_lock_blocking(signal_lock);
+        if(we_blocked) task->senders_blocked--;         // we are not blocked now
         inptr = (uint32_t) task->signal_in + 1;         // increment in pointer
         if ( inptr == task->signal_limit) inptr = 0;    // modulo limit
         if( inptr == task->signal_out) {                // in+1 == out means FULL. Oh dear...
             result = -1;
-            if(block && !we_blocked) {          // we will try blocking unless we already tried
+            // we will block unless we already did and our timeout has expired
+            if(block && !(we_blocked && timeout_ms && time_reached(owntask->wakeup.deadline))) {
+                // set time out (only the first time) and blocking flags
+                if(!we_blocked) owntask->wakeup.deadline = delayed_by_ms(get_absolute_time(),timeout_ms);
                 we_blocked = true;
-
-                // set time out and blocking flags
-                owntask->wakeup = delayed_by_ms(get_absolute_time(),timeout_ms);
                 owntask->task_flags |= (
                     ((timeout_ms)? PICCOLO_TASK_SLEEPING:0) | PICCOLO_TASK_SEND_SIGNAL_BLOCKED);
-                flags = owntask->task_flags;
                 owntask->task_sending_to = task;
+                task->senders_blocked++;
 
                 // clear the lock and yield with flags set
-                spin_unlock(piccolo_ctx.piccolo_lock,lock);
+                spin_unlock(signal_lock,lock);
                 piccolo_yield();
 
                 // Repeat the loop one more time
@@ -310,12 +692,20 @@ int32_t __piccolo_send_signal(piccolo_os_task_t* task,bool block, uint32_t timeo
             }
         } else {
 
-            // We have room for a signal!
+            // We have room for a signal! Fill its message slot first, if there is a mailbox
+            if(task->mailbox) {
+                if(message) memcpy(task->mailbox + inptr * task->message_size, message, task->message_size);
+                else memset(task->mailbox + inptr * task->message_size, 0, task->message_size);
+                __mem_fence_release();
+            }
             task->signal_in = inptr;        // signal is sent
+            PICCOLO_TRACE(PICCOLO_TRACE_SIGNAL_SEND, task, owntask);
+            __dmb();                        // before we look to see if the receiver is blocked
+            if(task->task_flags & PICCOLO_TASK_GET_SIGNAL_BLOCKED) __piccolo_wake_receiver(task);
             result = 1;
         }
         not_done = false;
-        spin_unlock(piccolo_ctx.piccolo_lock,lock);
+        spin_unlock(signal_lock,lock);
     } while (not_done);
 
 
@@ -332,7 +722,7 @@ int32_t __piccolo_send_signal(piccolo_os_task_t* task,bool block, uint32_t timeo
  * 
  */
 inline int32_t piccolo_send_signal(piccolo_os_task_t* toTask) {
-    return __piccolo_send_signal(toTask,false, 0);
+    return __piccolo_send_signal(toTask,false, 0, NULL);
 };
 /**
  * @brief Send a signal to the specified task. If the signal channel is full, block until it is not.
@@ -344,7 +734,7 @@ inline int32_t piccolo_send_signal(piccolo_os_task_t* toTask) {
  * If there is no room for the signal, block until space is available.
  */
 inline int32_t piccolo_send_signal_blocking(piccolo_os_task_t* toTask) {
-    return __piccolo_send_signal(toTask,true, 0);
+    return __piccolo_send_signal(toTask,true, 0, NULL);
 };
 /**
  * @brief Send a signal to a specified task. If the channel is full, block with a timeout until it is not.
@@ -358,7 +748,7 @@ inline int32_t piccolo_send_signal_blocking(piccolo_os_task_t* toTask) {
  * 
  */
 inline int32_t piccolo_send_signal_blocking_timeout(piccolo_os_task_t* toTask,uint32_t timeout_ms) {
-    return __piccolo_send_signal(toTask,true, timeout_ms);
+    return __piccolo_send_signal(toTask,true, timeout_ms, NULL);
 };
 
 /**
@@ -367,15 +757,19 @@ inline int32_t piccolo_send_signal_blocking_timeout(piccolo_os_task_t* toTask,ui
  * @param block true if blocking on send
  * @param timeout_ms non zero if timeout enabled on blocking
  * @param get_all if true, get ALL signal available. Otherwise just get one. 
+ * @param message where to copy the message from the task's mailbox, or NULL (only if not `get_all`)
  * @return Number of signals received. Can be zero on timeout or non-blocking
+ * (-2 if a message is wanted but the task has no mailbox)
  * \ingroup Intern
  * Get a signal for the current task. Return the number received.
  * If there are no signals available, return zero unless blocking was requested.
- * If blocking is necessary, start a timeout as well if one was requested.
+ * If blocking is necessary, start a timeout as well if one was requested, and keep blocking until
+ * a signal arrives or the timeout expires. Taking signals makes room, so any senders blocked
+ * on the full channel are woken.
  * 
  * @note With only ONE receiver, we do not have to lock anything. 
  */
-int32_t __piccolo_get_signal(bool block, uint32_t timeout_ms, bool get_all){
+int32_t __piccolo_get_signal(bool block, uint32_t timeout_ms, bool get_all, void *message){
     uint32_t outptr, inptr; 
     bool we_blocked = false;
     bool not_done = true;
@@ -383,15 +777,16 @@ int32_t __piccolo_get_signal(bool block, uint32_t timeout_ms, bool get_all){
     piccolo_os_task_t * task;
 
     task = piccolo_get_task_id();
+    if(message && !task->mailbox) return -2;
     do {
         outptr = (uint32_t) task->signal_out;         
         if( outptr == task->signal_in) {                // in == out means empty. Oh dear...
             result = 0;
-            if(block && !we_blocked) {          // we will try blocking unless we already tried
+            // we will block unless we already did and our timeout has expired
+            if(block && !(we_blocked && timeout_ms && time_reached(task->wakeup.deadline))) {
+                // set time out (only the first time) and blocking flags
+                if(!we_blocked) task->wakeup.deadline = delayed_by_ms(get_absolute_time(),timeout_ms);
                 we_blocked = true;
-
-                // set time out and blocking flags
-                task->wakeup = delayed_by_ms(get_absolute_time(),timeout_ms);
                 task->task_flags |= ( 
                     PICCOLO_TASK_GET_SIGNAL_BLOCKED | ((timeout_ms)? PICCOLO_TASK_SLEEPING:0));
                 // yield with flags set. This will block
@@ -412,8 +807,16 @@ int32_t __piccolo_get_signal(bool block, uint32_t timeout_ms, bool get_all){
                 result = 1;
                 outptr += 1;
                 if(outptr == task->signal_limit) outptr = 0;  // increment out pointer mod limit
+                if(message) {
+                    // copy the message out before the slot can be reused
+                    __mem_fence_acquire();
+                    memcpy(message, task->mailbox + outptr * task->message_size, task->message_size);
+                    __mem_fence_release();
+                }
                 task->signal_out = outptr;                      // and update task values
             }
+            __dmb();                        // before we look for blocked senders
+            if(task->senders_blocked) __piccolo_wake_senders(task);   // they may send now
         }
         not_done = false;
     } while (not_done);
@@ -436,8 +839,10 @@ inline int32_t piccolo_get_signal() {
     // in == out is empty
     if(task->signal_in == task->signal_out) return 0;
     // increment out, but never set it >= limit ...
-    if((i=task->signal_out++) >= task->signal_limit) i = 0;
+    if((i = task->signal_out + 1) >= task->signal_limit) i = 0;
     task->signal_out = i;
+    __dmb();
+    if(task->senders_blocked) __piccolo_wake_senders(task);   // a sender may be blocked waiting for room
     // return success
     return 1;
 }
@@ -449,7 +854,7 @@ inline int32_t piccolo_get_signal() {
  * 
  */
 inline int32_t piccolo_get_signal_blocking() {
-    return __piccolo_get_signal(true, 0, false);
+    return __piccolo_get_signal(true, 0, false, NULL);
 }
 /**
  * @brief Attempt to get a signal. If none were available, block with a timeout until one arrives.
@@ -459,7 +864,7 @@ inline int32_t piccolo_get_signal_blocking() {
  * 
  */
 inline int32_t piccolo_get_signal_blocking_timeout(uint32_t timeout_ms){
-    return __piccolo_get_signal(true, timeout_ms, false);
+    return __piccolo_get_signal(true, timeout_ms, false, NULL);
 }
 
 /**
@@ -471,7 +876,7 @@ inline int32_t piccolo_get_signal_blocking_timeout(uint32_t timeout_ms){
  * 
  */
 inline int32_t piccolo_get_signal_all(){
-    return __piccolo_get_signal(false, 0, true);
+    return __piccolo_get_signal(false, 0, true, NULL);
 }
 
 /**
@@ -483,7 +888,7 @@ inline int32_t piccolo_get_signal_all(){
  * 
  */
 inline int32_t piccolo_get_signal_all_blocking(){
-    return __piccolo_get_signal(true, 0, true);
+    return __piccolo_get_signal(true, 0, true, NULL);
 }
 /**
  * @brief Get all the signals available. If none were available, block with a timeout until one arrives.
@@ -497,38 +902,10 @@ inline int32_t piccolo_get_signal_all_blocking(){
  */
 
 inline int32_t piccolo_get_signal_all_blocking_timeout(uint32_t timeout_ms){
-    return __piccolo_get_signal(true, timeout_ms, true);
+    return __piccolo_get_signal(true, timeout_ms, true, NULL);
 }
 
-uint32_t kills = 0;
-/**
- * @brief Task to delete dead tasks.
- * 
- * \ingroup Intern
- * The task is created during the scheduler start-up on core 0.
- * When it runs, it tries to free the space for all the dead tasks on 
- * the zombies list. (The scheduler cannot call free, because it
- * is an interrupt handler and would break the mutex that protects
- * free and malloc). 
- * 
- */
-void __piccolo_garbage_man(void) {
-    uint32_t lock;
-    piccolo_os_task_t *temp;
-    while (1) { 
-        piccolo_get_signal_all_blocking();  // wait for dead bodies to appear ...
-//        piccolo_yield();
-        while (piccolo_ctx.zombies) {
-            lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
-            // we could have been fooled by the other core or preemption
-            // so check things again while we have the lock
-            if(temp = (piccolo_os_task_t *) piccolo_ctx.zombies) piccolo_ctx.zombies = temp->next_task;
-            spin_unlock(piccolo_ctx.piccolo_lock,lock);
-            if(temp) free(temp);
-            kills++;
-        }
-    }
-}
+#if !PICCOLO_OS_HOST
 
 /**
  * @brief Switch the scheduler to handler mode
@@ -545,11 +922,14 @@ void __piccolo_task_init(void) {
   __piccolo_task_init_stack((uint32_t *)((uint32_t)(dummy + 48) & ~((uint32_t) 7)));  // Create phony 8 byte aligned stack & SVC back to ourselves
 }
 
+#endif
+
 extern void __isr_SVCALL(void);
+extern void __isr_PENDSV(void);
 /**
  * @brief Initialize the piccolo run time environment
  * 
- * Set the scheduler task list to empty and set up the context switching, 
+ * Set the scheduler task list and run queues to empty and set up the context switching, 
  * interrupt handlers, interrupt priorities and interlocks (spinlocks) for the scheduler.
  * 
  * @note Also called internally on Core 1 when multi-core is enabled. On core1 only the interrupt
@@ -565,20 +945,69 @@ void piccolo_init() {
         piccolo_ctx.this_task[1] = (piccolo_os_task_t *) 1;
         piccolo_ctx.task_list_head = NULL;
         piccolo_ctx.task_list_tail = NULL;
-        piccolo_ctx.current_task = NULL;
-        piccolo_ctx.zombies = NULL;
 
         // claim the spinlock, initialize it and save it's instance
         spin_lock_claim(PICCOLO_SPIN_LOCK_ID);
         piccolo_ctx.piccolo_lock = spin_lock_init(PICCOLO_SPIN_LOCK_ID);
 
+        // and the (empty) run queues for each core, each with its own spin lock
+        for(int core = 0; core < 2; core++) {
+            piccolo_os_run_queue_t *run_queue = &piccolo_ctx.run_queue[core];
+            run_queue->lock = spin_lock_init(spin_lock_claim_unused(true));
+            run_queue->ready_bitmap = 0;
+            run_queue->ready_count = 0;
+            run_queue->stealable_count = 0;
+            for(int i = 0; i < PICCOLO_OS_PRIORITY_LEVELS; i++)
+                run_queue->ready_queue[i].head = run_queue->ready_queue[i].tail = NULL;
+            run_queue->blocked_queue.head = run_queue->blocked_queue.tail = NULL;
+            for(int i = 0; i < PICCOLO_OS_LOCK_WAIT_QUEUES; i++)
+                run_queue->lock_wait_queue[i].head = run_queue->lock_wait_queue[i].tail = NULL;
+            run_queue->blocked_changed = false;
+            run_queue->preempt = false;
+            run_queue->timer_queue.root = NULL;
+            run_queue->edf_queue.root = NULL;
+            run_queue->edf_load = 0;
+            run_queue->statistics = (piccolo_os_core_statistics_t) {0};
+        }
+
+        // The signal channels have their own, so sending does not wait on the task list. Only the first is a must:
+        // if the claimable spin locks run out, the rest share the ones claimed.
+        piccolo_ctx.signal_lock[0] = spin_lock_init(spin_lock_claim_unused(true));
+        for(int i = 1, claimed = 1, id; i < PICCOLO_OS_SIGNAL_LOCKS; i++) {
+            if((id = spin_lock_claim_unused(false)) >= 0) {
+                piccolo_ctx.signal_lock[i] = spin_lock_init(id);
+                claimed++;
+            }
+            else piccolo_ctx.signal_lock[i] = piccolo_ctx.signal_lock[i % claimed];
+        }
+
+        piccolo_task_pool_init();
+        for(int i = 0; i < PICCOLO_OS_PRIORITY_LEVELS; i++) piccolo_ctx.time_slice[i] = 1;
+        // No lightweight tasks yet. Each core's runner is created with its first one.
+        for(int core = 0; core < 2; core++) piccolo_ctx.lite_runner[core] = (piccolo_os_lite_runner_t) {0};
+        // and no software timers. The timer task is created with the first.
+        piccolo_ctx.timer_service = (piccolo_os_timer_service_t) {0};
+        // nor workers for deferred work, until piccolo_work_start()
+        for(int core = 0; core < 2; core++) memset(&piccolo_ctx.work_queue[core], 0, sizeof(piccolo_os_work_queue_t));
+
         // Install the exception handlers for Systick and SVC
+        // With the fast switch, yields (PendSV) and preemption (Systick) switch straight from task to task
+#if PICCOLO_OS_FAST_SWITCH
+        piccolo_ctx.fast_switch = true;
+        exception_set_exclusive_handler(SYSTICK_EXCEPTION,&__isr_PENDSV);
+        exception_set_exclusive_handler(PENDSV_EXCEPTION,&__isr_PENDSV);
+#else
         exception_set_exclusive_handler(SYSTICK_EXCEPTION,&__isr_SVCALL);
+#endif
         exception_set_exclusive_handler(SVCALL_EXCEPTION,&__isr_SVCALL);
     }
 
     // things from here on happen on ALL cores...
 
+    // Each core has its own alarm to end its idle time. Its interrupt is enabled on the core which sets the callback.
+    piccolo_ctx.run_queue[get_core_num()].idle_alarm = hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(piccolo_ctx.run_queue[get_core_num()].idle_alarm, __piccolo_idle_alarm);
+
     /*
     * set interrupt priority for SVC, PENDSV and Systick to 'all bits on'
     * for LOWEST interrupt priority. We do not want ANY of them to preempt
@@ -594,21 +1023,508 @@ void piccolo_init() {
 /**
  * @brief Internal Idle "task" used by the scheduler to sleep the core
  * 
- * @param uSec the number of microseconds to sleep
+ * @param uSec the number of microseconds to sleep, or \ref PICCOLO_OS_IDLE_FOREVER
  * \ingroup Intern
  * Enter sleep mode and then "yield" back to the scheduler. Entry and parameter passing
  * is set up in a dummy stack frame before switching context.
+ * SysTick is already off. The core's idle alarm is armed for the end of the sleep, and the core waits 
+ * for events (WFE) until the alarm fires, a task on this core is made ready, the blocked queue needs 
+ * checking, or the other core has tasks to spare. Any interrupt, and waking a task (which sends an event),
+ * ends the wait so these can be checked. The time spent here is added to the core's idle statistics.
  * 
  * \note Can be running on **both** cores with different sleep times
  * 
  */
-__attribute__ ((noinline)) void __piccolo_idle( int32_t uSec)  {
+__attribute__ ((noinline)) void __piccolo_idle(uint32_t uSec)  {
+    uint core = get_core_num();
+    piccolo_os_run_queue_t *run_queue = &piccolo_ctx.run_queue[core];
+    piccolo_os_run_queue_t *other_run_queue = &piccolo_ctx.run_queue[core ^ 1];
+    bool forever = (uSec == PICCOLO_OS_IDLE_FOREVER);
+    absolute_time_t until = make_timeout_time_us(uSec);
+    uint32_t start = time_us_32();
+    bool alarm_passed = false;
+
+    PICCOLO_TRACE(PICCOLO_TRACE_IDLE_ENTER, core, uSec);
+
+    if(!forever) alarm_passed = hardware_alarm_set_target(run_queue->idle_alarm, until);
+    if(!alarm_passed) {
+        while(!run_queue->ready_count && !run_queue->blocked_changed
+                && (other_run_queue->ready_count < 2 || !other_run_queue->stealable_count)
+                && (forever || !time_reached(until))) __wfe();
+        if(!forever) hardware_alarm_cancel(run_queue->idle_alarm);
+    }
+    run_queue->statistics.idle_us += time_us_32() - start;
+    run_queue->statistics.idle_wakeups++;
+    PICCOLO_TRACE(PICCOLO_TRACE_IDLE_EXIT, core, 0);
     do {
-        if(uSec>= 0) sleep_us(uSec);
         piccolo_yield();            // This should never return!
     } while (1);
 }
 
+/**
+ * @brief Idle alarm callback
+ * 
+ * @param alarm_num the core's idle alarm
+ * \ingroup Intern
+ * Nothing to do. Returning from the interrupt ends the idle task's wait for an event.
+ */
+void __piccolo_idle_alarm(uint alarm_num) {
+}
+
+/**
+ * @brief Move any tasks waiting on event groups which can now run to their ready queues
+ * 
+ * @param run_queue the run queue to check
+ * \ingroup Intern
+ * Checks the tasks on the blocked queue waiting for event flags. Tasks which can run are made ready.
+ * (Tasks waiting on signals are woken directly by the task at the other end of the channel.)
+ * 
+ * @note The caller must hold the run queue lock.
+ */
+void __time_critical_func(__piccolo_check_blocked)(piccolo_os_run_queue_t *run_queue) {
+    piccolo_os_task_t *task, *next_task;
+
+    run_queue->blocked_changed = false;     // clear first, so a change during the check is not lost
+    __mem_fence_acquire();
+
+    for(task = run_queue->blocked_queue.head; task; task = next_task) {
+        next_task = task->queue_next;
+        if((task->task_flags & PICCOLO_TASK_EVENT_BLOCKED) && piccolo_task_wait_satisfied(task))
+            piccolo_run_queue_wake(run_queue, task);
+    }
+}
+
+/**
+ * @brief Wake a task blocked waiting for a signal
+ * 
+ * @param task the receiving task, which has just been sent a signal
+ * \ingroup Intern
+ * Moves the task from the blocked queue straight to its ready queue. A task only moves to the 
+ * other core with the global lock and the run queue lock of the core it leaves held, so once its core's 
+ * lock is held and it is still on that core, it stays there. If it moved first, try the core it moved to.
+ * 
+ * @note Called with the task's signal lock held, from tasks or interrupt service handlers.
+ */
+void __time_critical_func(__piccolo_wake_receiver)(piccolo_os_task_t *task) {
+    piccolo_os_run_queue_t *run_queue;
+    uint32_t lock_value;
+    uint core;
+    bool moved;
+
+    do {
+        core = task->core;
+        run_queue = &piccolo_ctx.run_queue[core];
+        lock_value = piccolo_run_queue_lock(run_queue);
+        moved = task->core != core;
+        if(!moved) piccolo_run_queue_release(run_queue, core, task, PICCOLO_TASK_GET_SIGNAL_BLOCKED);
+        piccolo_run_queue_unlock(run_queue, lock_value);
+    } while(moved);
+}
+
+/**
+ * @brief Wake the tasks blocked sending to a task whose signal channel was full
+ * 
+ * @param to_task the receiving task, which has just taken signals
+ * \ingroup Intern
+ * Only called when the receiver's `senders_blocked` count says a sender is waiting, so 
+ * looking through the blocked queues is rare. A sender which has not yielded yet is still
+ * the running task on its core.
+ */
+void __time_critical_func(__piccolo_wake_senders)(piccolo_os_task_t *to_task) {
+    piccolo_os_run_queue_t *run_queue;
+    piccolo_os_task_t *task, *next_task;
+    uint32_t lock_value;
+
+    for(uint core = 0; core < 2; core++) {
+        run_queue = &piccolo_ctx.run_queue[core];
+        lock_value = piccolo_run_queue_lock(run_queue);
+        for(task = run_queue->blocked_queue.head; task; task = next_task) {
+            next_task = task->queue_next;
+            if(task->task_sending_to == to_task)
+                piccolo_run_queue_release(run_queue, core, task, PICCOLO_TASK_SEND_SIGNAL_BLOCKED);
+        }
+        task = (piccolo_os_task_t *) piccolo_ctx.this_task[core];
+        if((uintptr_t) task > 1 && task->task_sending_to == to_task)
+            piccolo_run_queue_release(run_queue, core, task, PICCOLO_TASK_SEND_SIGNAL_BLOCKED);
+        piccolo_run_queue_unlock(run_queue, lock_value);
+    }
+}
+
+/**
+ * @brief Wake up all the tasks whose timeout has expired
+ * 
+ * @param run_queue the run queue to check
+ * \ingroup Intern
+ * The timer queue is ordered by wakeup time, so only the tasks which are 
+ * actually due are looked at.
+ * 
+ * @note The caller must hold the run queue lock.
+ */
+void __time_critical_func(__piccolo_expire_timers)(piccolo_os_run_queue_t *run_queue) {
+    piccolo_timer_node_t *node;
+    uint64_t now = to_us_since_boot(get_absolute_time());
+
+    while((node = piccolo_timer_queue_peek(&run_queue->timer_queue)) && to_us_since_boot(node->deadline) <= now)
+        piccolo_run_queue_wake(run_queue, piccolo_timer_owner(node, piccolo_os_task_t, wakeup));
+}
+
+/**
+ * @brief Let the task about to run have the rest of the current time slice
+ * \ingroup Intern
+ * Systick runs freely, one tick per time slice, so a switch does not have to touch it. A task
+ * switched in carries on with the slice the last task left. Systick is only started if it is
+ * off (it is stopped while the core idles). A tick which came during the switch was meant for 
+ * the task which just stopped, so it is cleared, as is PendSV pended by a task of higher priority
+ * being made ready during the switch, which has been taken into account already.
+ * NOTE: setting Time Slice to 0 will disable Systick and turn off preemptive scheduling!
+ */
+__force_inline static void __piccolo_continue_time_slice(void) {
+    if(!(systick_hw->csr & 1)) {
+        systick_hw->rvr = PICCOLO_OS_TIME_SLICE; // set for interval
+        systick_hw->cvr = 0;    // reset the current counter
+        __dsb();                // make sure systick is set
+        __isb();                // and it is really ready
+        systick_hw->csr = 3;    // Enable systick timer and IRQ, select 1 usec clock    
+    }
+    hw_set_bits((io_rw_32 *)(PPB_BASE + M0PLUS_ICSR_OFFSET), M0PLUS_ICSR_PENDSTCLR_BITS | M0PLUS_ICSR_PENDSVCLR_BITS);
+}
+
+/**
+ * @brief Check for a timeout which is due, without the run queue lock
+ * \ingroup Intern
+ * @param run_queue the run queue of this core
+ * @return true if the earliest timeout may have expired
+ * 
+ * Timer nodes live in task blocks, which are never freed, so reading one the other core is 
+ * removing is safe. At worst the timeout is noticed at the next switch.
+ */
+__force_inline static bool __piccolo_timer_due(piccolo_os_run_queue_t *run_queue) {
+    piccolo_timer_node_t *node = piccolo_timer_queue_peek(&run_queue->timer_queue);
+
+    return node && time_reached(node->deadline);
+}
+
+/**
+ * @brief Check that a task which just stopped running stayed within its stack
+ * \ingroup Intern
+ * @param task the task
+ */
+__force_inline static void __piccolo_check_stack(piccolo_os_task_t *task) {
+#if PICCOLO_OS_STACK_CHECK
+    // (in the host simulation the stack pointer is the task's host context, which is elsewhere)
+    if(task->stack[0] != PICCOLO_OS_STACK_CANARY || (!PICCOLO_OS_HOST && task->stack_ptr <= task->stack))
+        panic("Piccolo task %p %s overflowed its %d byte stack!\n", task,
+            task->name ? task->name : "", task->stack_size);
+#endif
+}
+
+/**
+ * @brief Add the time slice a task has just finished to its statistics
+ * 
+ * @param task the task which has stopped running
+ * @param core the core it ran on
+ * @param preempted true if it stopped for a task of higher priority
+ * \ingroup Intern
+ * Called with the run queue lock held, before the task is blocked or made ready. A switch made in the
+ * SysTick handler, or for a task of higher priority, for a task which is not blocking is a preemption.
+ * Anything else, the task asked for. The time is charged to the current job of an EDF task, which leaves
+ * the EDF class until its next release if that takes it over budget.
+ */
+__force_inline static void __piccolo_account_run(piccolo_os_task_t *task, uint core, bool preempted) {
+    uint32_t ran = time_us_32() - task->switched_at;
+
+    task->statistics.run_us += ran;
+    task->statistics.core_run_us[core] += ran;
+    task->statistics.last_core = core;
+    if(task->edf.period_us) {
+        task->edf.used_us += __piccolo_job_ran(task);
+        task->edf.started_running = false;
+        if(task->edf.scheduled && task->edf.used_us > task->edf.budget_us) {
+            task->edf.scheduled = false;    // over budget, so best effort until its next release
+            task->statistics.edf_overruns++;
+        }
+    }
+    if(!(task->task_flags & PICCOLO_TASK_BLOCKING)
+            && (preempted || __get_current_exception() == VTABLE_FIRST_IRQ + SYSTICK_EXCEPTION))
+        task->statistics.preemptions++;
+    else task->statistics.yields++;
+}
+
+/**
+ * @brief Decide where a task which stopped without blocking goes back on its ready queue
+ * 
+ * @param task the task which has stopped running
+ * @param preempted true if it stopped for a task of higher priority
+ * @return true if it keeps its place at the head of the queue, false if it goes to the tail
+ * \ingroup Intern
+ * A task preempted for a task of higher priority keeps its place, as does one whose time slice still
+ * has ticks left when SysTick stops it, or an EDF job within budget (which has no slice, its deadline 
+ * orders it). A task which yielded, or whose slice is over, goes behind the other tasks of its priority 
+ * with a new slice.
+ */
+__force_inline static bool __piccolo_keeps_place(piccolo_os_task_t *task, bool preempted) {
+    if(preempted) return true;
+    if(__get_current_exception() != VTABLE_FIRST_IRQ + SYSTICK_EXCEPTION) return false;
+    if(task->edf.scheduled) return true;
+    if(!task->slice_left || --task->slice_left) return true;
+    task->slice_left = piccolo_ctx.time_slice[task->priority];     // for when it is the only one to run
+    return false;
+}
+
+/**
+ * @brief Check whether a task which stopped without blocking must give way to a ready task
+ * 
+ * @param run_queue the run queue of this core
+ * @param task the task
+ * @param keep_place the result of \ref __piccolo_keeps_place for the task
+ * @return true if a task which runs before it is ready (\ref piccolo_task_before), or one it does not run
+ * before if the task goes to the tail
+ * \ingroup Intern
+ */
+__force_inline static bool __piccolo_must_switch(piccolo_os_run_queue_t *run_queue, piccolo_os_task_t *task, bool keep_place) {
+    piccolo_os_task_t *next_task = piccolo_run_queue_peek_ready(run_queue);
+
+    if(!next_task) return false;
+    if(keep_place) return piccolo_task_before(next_task, task);
+    return !piccolo_task_before(task, next_task);
+}
+
+/**
+ * @brief Check whether the running EDF job has used up its budget
+ * 
+ * @param task the running task
+ * @return true if it is in the EDF class and its current job has run for longer than its budget
+ * \ingroup Intern
+ * Then it must stop, so \ref __piccolo_account_run can drop it from the EDF class until its next release.
+ */
+__force_inline static bool __piccolo_over_budget(piccolo_os_task_t *task) {
+    return task->edf.scheduled && task->edf.used_us + __piccolo_job_ran(task) > task->edf.budget_us;
+}
+
+/**
+ * @brief Switch straight from the running task to the next one, without going back to the scheduler loop
+ * 
+ * @param stack_ptr the stack pointer of the task which stopped, with its registers saved
+ * @return uint32_t* the stack pointer of the task to run next, or NULL to let `piccolo_start()` decide
+ * \ingroup Intern
+ * Called from the PendSV (and Systick) handler in `context_switch.s`. Does what the scheduler loop
+ * does for the common case: the task which stopped goes back on its ready queue or is blocked, and 
+ * the next task from the ready queues runs (perhaps the same task).
+ * Anything else goes back to the scheduler loop: when no task was running (the idle task), the task ended
+ * or must move to the other core, or it blocked with nothing else ready on this core (so the core must steal or idle). Then nothing has
+ * been changed, and the loop does all the work as usual.
+ * 
+ * If the task is still runnable and is the only candidate (nothing else ready, nothing to wake, or only tasks 
+ * of its own priority or lower while it keeps its place), it just carries on, without touching Systick, 
+ * and without taking the run queue lock unless a timeout or an event group needs checking. (This is checked without the lock, 
+ * so a task made ready by the other core at that moment waits for the next switch.)
+ */
+uint32_t *__time_critical_func(__piccolo_fast_switch)(uint32_t *stack_ptr) {
+    uint core = get_core_num();
+    piccolo_os_run_queue_t *run_queue = &piccolo_ctx.run_queue[core];
+    piccolo_os_task_t *task = (piccolo_os_task_t *) piccolo_ctx.this_task[core];
+    piccolo_os_task_t *next_task;
+    uint32_t lock_value;
+    bool preempted, keep_place, over_budget;
+
+    if(!piccolo_ctx.fast_switch || (uintptr_t) task <= 1 || (task->task_flags & PICCOLO_TASK_ZOMBIE)
+            || !piccolo_task_can_run_on(task, core)) return NULL;
+
+    // Yield and preemption may both be pending. Only switch once.
+    hw_set_bits((io_rw_32 *)(PPB_BASE + M0PLUS_ICSR_OFFSET), M0PLUS_ICSR_PENDSTCLR_BITS | M0PLUS_ICSR_PENDSVCLR_BITS);
+    preempted = run_queue->preempt;
+    run_queue->preempt = false;
+
+    task->stack_ptr = stack_ptr;
+    __piccolo_check_stack(task);
+
+    // Is there anything else to do? If not, carry on with the same task.
+    keep_place = !(task->task_flags & PICCOLO_TASK_BLOCKING) && __piccolo_keeps_place(task, preempted);
+    over_budget = __piccolo_over_budget(task);
+    if(!(task->task_flags & PICCOLO_TASK_BLOCKING) && !over_budget && !run_queue->blocked_changed
+            && !__piccolo_timer_due(run_queue) && !__piccolo_must_switch(run_queue, task, keep_place)) {
+        run_queue->statistics.resumes++;
+        return stack_ptr;
+    }
+
+    lock_value = piccolo_run_queue_lock(run_queue);
+    if(piccolo_timer_queue_peek(&run_queue->timer_queue)) __piccolo_expire_timers(run_queue);
+    if(run_queue->blocked_changed) __piccolo_check_blocked(run_queue);
+
+    if((task->task_flags & PICCOLO_TASK_BLOCKING) && !run_queue->ready_count) {
+        // We would have to idle or steal. Leave that to the scheduler loop.
+        piccolo_run_queue_unlock(run_queue, lock_value);
+        return NULL;
+    }
+    if(!(task->task_flags & PICCOLO_TASK_BLOCKING) && !over_budget && !__piccolo_must_switch(run_queue, task, keep_place)) {
+        // Only tasks it may keep running ahead of were woken
+        piccolo_run_queue_unlock(run_queue, lock_value);
+        run_queue->statistics.resumes++;
+        return stack_ptr;
+    }
+    PICCOLO_TRACE(PICCOLO_TRACE_SWITCH_OUT, task, task->task_flags);
+    __piccolo_account_run(task, core, preempted);
+    task->task_flags &= ~PICCOLO_TASK_RUNNING;
+    if(task->task_flags & PICCOLO_TASK_BLOCKING) piccolo_run_queue_block(run_queue, task);
+    else if(keep_place) piccolo_run_queue_put_back(run_queue, task);
+    else piccolo_run_queue_make_ready(run_queue, task);
+
+    next_task = piccolo_run_queue_take_ready(run_queue);
+    next_task->task_flags = PICCOLO_TASK_RUNNING;
+    next_task->switched_at = time_us_32();
+    piccolo_ctx.this_task[core] = next_task;
+    run_queue->statistics.dispatches++;
+    run_queue->statistics.fast_switches++;
+    piccolo_run_queue_unlock(run_queue, lock_value);
+    PICCOLO_TRACE(PICCOLO_TRACE_SWITCH_IN, next_task, 1);
+
+    run_queue->preempt = false;
+    __piccolo_continue_time_slice();
+    return next_task->stack_ptr;
+}
+
+/**
+ * @brief Turn the fast task to task switch on or off
+ * 
+ * @param enable true to switch tasks in the PendSV handler, false to always go through the scheduler loop
+ * 
+ * Only has an effect if \ref PICCOLO_OS_FAST_SWITCH is true. Turning it off is useful for comparing the two.
+ */
+void piccolo_fast_switch(bool enable) {
+    piccolo_ctx.fast_switch = enable;
+}
+
+/**
+ * @brief Take a ready task from the other core's run queue
+ * 
+ * @param core the core doing the stealing
+ * @return piccolo_os_task_t* the task taken, now belonging to `core` and marked as running on it, or NULL if 
+ * there was none
+ * \ingroup Intern
+ * The global lock is held while the task moves, so only one task migrates at a time.
+ * The caller must not hold either run queue lock.
+ * 
+ * Takes the highest priority task which may run on `core`. If it is the only task waiting on the other 
+ * core, it is left there until it has waited \ref PICCOLO_OS_MIGRATION_DELAY, since its own core will
+ * probably get to it first.
+ */
+piccolo_os_task_t *__time_critical_func(__piccolo_steal_task)(uint core) {
+    piccolo_os_run_queue_t *victim = &piccolo_ctx.run_queue[core ^ 1];
+    piccolo_os_task_t *task = NULL;
+    uint32_t lock_value, victim_lock_value, bitmap, priority, now;
+
+    if(!victim->stealable_count) return NULL;   // nothing we may take, don't bother locking
+
+    lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    victim_lock_value = piccolo_run_queue_lock(victim);
+    now = time_us_32();
+    for(bitmap = victim->ready_bitmap; bitmap && !task; bitmap &= ~(1u << priority)) {
+        priority = 31 - __builtin_clz(bitmap);
+        for(task = victim->ready_queue[priority].head; task; task = task->queue_next)
+            if(piccolo_task_can_run_on(task, core)
+                    && (victim->ready_count > 1 || now - task->ready_at >= PICCOLO_OS_MIGRATION_DELAY)) break;
+    }
+    if(task) {
+        // running on this core before the victim's lock is released, as a task taken from our own queue is
+        piccolo_run_queue_remove_ready(victim, task);
+        task->core = core;
+        task->statistics.migrations++;
+        task->task_flags = PICCOLO_TASK_RUNNING;
+        task->switched_at = time_us_32();
+        piccolo_ctx.this_task[core] = task;
+        piccolo_ctx.run_queue[core].statistics.dispatches++;
+    }
+    piccolo_run_queue_unlock(victim, victim_lock_value);
+    spin_unlock(piccolo_ctx.piccolo_lock, lock_value);
+
+    if(task) piccolo_ctx.run_queue[core].statistics.steals++;
+    return task;
+}
+
+/**
+ * @brief Get the scheduler statistics for a core
+ * 
+ * @param core the core (0 or 1)
+ * @param statistics filled in with a copy of the core's counters
+ * 
+ * The counters only ever increase (and wrap), so take two snapshots and subtract
+ * to see what happened in between.
+ */
+void piccolo_get_core_statistics(uint core, piccolo_os_core_statistics_t *statistics) {
+    piccolo_os_run_queue_t *run_queue = &piccolo_ctx.run_queue[core & 1];
+    uint32_t lock_value;
+
+    lock_value = spin_lock_blocking(run_queue->lock);
+    *statistics = run_queue->statistics;
+    spin_unlock(run_queue->lock, lock_value);
+}
+
+/**
+ * @brief Get the most stack a task has used so far
+ * 
+ * @param task the task
+ * @return uint32_t the largest number of bytes of its stack the task has used 
+ * (or the whole stack size if \ref PICCOLO_OS_STACK_PAINTING is off)
+ * 
+ * Looks for the lowest stack word which no longer holds the paint. A task which happens to 
+ * store the paint value itself at the bottom of what it uses will read a little low, 
+ * so leave some margin when shrinking a stack to fit.
+ * 
+ * @note In the host simulation tasks run on host stacks, never on the one painted here, so it reads 0.
+ */
+uint32_t piccolo_get_stack_high_water(piccolo_os_task_t *task) {
+#if PICCOLO_OS_STACK_PAINTING
+    uint32_t words = task->stack_size / sizeof(uint32_t);
+    uint32_t i = 1;
+
+    while(i < words && task->stack[i] == PICCOLO_OS_STACK_PAINT) i++;
+    return (words - i) * sizeof(uint32_t);
+#else
+    return task->stack_size;
+#endif
+}
+
+/**
+ * @brief Take a snapshot of every task, for a task manager
+ * 
+ * @param info filled in with up to `count` task snapshots, in task creation order
+ * @param count the number of entries in `info`
+ * @return uint32_t the number of tasks which exist (which may be more than `count`)
+ * 
+ * The task list is locked while it is copied, so no task can end or be created meanwhile, and each 
+ * task is copied with its core's run queue lock held, so its statistics are consistent. The time
+ * slice a running task is in is included in its run time. Like the core statistics the times only 
+ * increase, so to find how busy each task has been, take two snapshots and subtract.
+ */
+uint32_t piccolo_get_task_info(piccolo_os_task_info_t *info, uint32_t count) {
+    piccolo_os_run_queue_t *run_queue;
+    piccolo_os_task_t *task;
+    uint32_t lock_value, run_queue_lock_value, ran, tasks = 0;
+
+    lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    for(task = piccolo_ctx.task_list_head; task; task = task->next_task, tasks++) {
+        if(tasks >= count) continue;
+        // tasks only move between cores with the global lock held, so task->core can't change under us
+        run_queue = &piccolo_ctx.run_queue[task->core];
+        run_queue_lock_value = piccolo_run_queue_lock(run_queue);
+        info[tasks].task = task;
+        info[tasks].name = task->name;
+        info[tasks].task_flags = task->task_flags;
+        info[tasks].priority = task->priority;
+        info[tasks].core = task->core;
+        info[tasks].affinity = task->affinity;
+        info[tasks].statistics = task->statistics;
+        if(task->task_flags & PICCOLO_TASK_RUNNING) {
+            ran = time_us_32() - task->switched_at;
+            info[tasks].statistics.run_us += ran;
+            info[tasks].statistics.core_run_us[task->core] += ran;
+        }
+        piccolo_run_queue_unlock(run_queue, run_queue_lock_value);
+    }
+    spin_unlock(piccolo_ctx.piccolo_lock, lock_value);
+    return tasks;
+}
+
 /**
  * @brief Core 1 code to initialize and immediately start the piccolo scheduler
  * \ingroup Intern
@@ -636,50 +1552,60 @@ void __piccolo_start_core1(void) {
  * Start the second processor if multi-core mode is enabled.
  * Switch to handler mode and begin the round robin scheduler. 
  * 
- * The scheduler starts with the task after the last task run by either core
- * and looks for a task which is not running (on the other core) and not blocked. Along the way it checks
- * if sleeping tasks or tasks blocked for signaling should be unblocked. The first task found ready to run, gets run
+ * Each core schedules from its own run queue, holding only that run queue's lock.
+ * Tasks which are not running wait either on a ready queue (one per priority, with a bitmap
+ * of the non-empty queues) or are blocked. The scheduler takes the task at the head of the
+ * highest priority ready queue, so choosing a task costs the same no matter how many tasks exist.
+ * If a core has nothing ready to run, it steals a ready task from the other core, taking the global
+ * lock only for that migration. Only tasks whose affinity allows it are taken, and a task which is 
+ * the only one waiting on its core is left there for \ref PICCOLO_OS_MIGRATION_DELAY first. A task whose
+ * affinity no longer allows its core is handed to the other core when it stops running.
+ * Tasks with a timeout running are kept in a timer queue ordered by wakeup time, so only the tasks
+ * which are due get woken, and the earliest wakeup is always at hand to size the idle time. Tasks waiting on
+ * signals are never checked by the scheduler: sending a signal moves a blocked receiver to its ready queue, and taking one 
+ * does the same for blocked senders. Tasks waiting on event groups are only checked when an event group has changed. The task found gets run
  * with the preemption timer reset and armed if preemption is enabled. After the task runs the
  * scheduler checks if it has ended. (Marked as a zombie.) If so, the task is
- * removed from the scheduler's task list and sent to the garbage collector to free the task's memory.
- * 
- * If no task is ready to run an idle task will be started to sleep for the minimum of \ref PICCOLO_OS_MAX_IDLE
- * or the smallest time remaining of any timeout. Sleep is the Pico sleep
- * routine, so the core goes to sleep for power reduction. If \ref PICCOLO_OS_MAX_IDLE is set to zero, 
+ * removed from the scheduler's task list and its memory goes straight back to its task pool.
+ * Otherwise it goes to the tail of its ready queue, or to the blocked queue if it is now waiting.
+ * A task preempted by a task of higher priority, or by a tick before its priority's time slice is 
+ * over, goes back to the head of its ready queue instead, so it runs again before the others of its priority.
+ * 
+ * If \ref PICCOLO_OS_FAST_SWITCH is true, yields and preemption are handled by PendSV, which usually 
+ * switches straight to the next task (see `__piccolo_fast_switch()`) and only comes back to this loop 
+ * when a task ends, or the core has nothing left to run.
+ * 
+ * If no task is ready to run an idle task will be started to sleep until the earliest timeout (no longer 
+ * than \ref PICCOLO_OS_MAX_IDLE unless \ref PICCOLO_OS_TICKLESS_IDLE is set). SysTick is off, and the core waits 
+ * for events with a hardware alarm set for the end of the sleep, so it goes to sleep for power 
+ * reduction, and wakes early when a task on this core is made ready. If \ref PICCOLO_OS_MAX_IDLE is set to zero, 
  * idle will not run. 
  * 
- * If \ref PICCOLO_OS_NO_IDLE_FOR_SIGNALS is true (the default), the idle task *will not* be run if *any* task is blocked
- * waiting to send or receive a signal in order to minimize system response time.
- * Setting \ref PICCOLO_OS_NO_IDLE_FOR_SIGNALS to false will improve power consumption but potentially delay the response
- * of any task waiting for a signal. This may make good sense for low power applications without
- * serious response time concerns.
+ * If \ref PICCOLO_OS_NO_IDLE_FOR_SIGNALS is true, the idle task *will not* be run if *any* task is blocked
+ * waiting on a signal or an event group. Since waking a task ends the idle time, this is no longer 
+ * needed for response time, so the default is false.
  * 
  * @note Runs on **both** cores if multi-core is enabled
  * 
  */
 void __time_critical_func(piccolo_start)() {
     
-    uint32_t lock_value;
-    piccolo_os_task_t  *last_task, *current_task = NULL, *temp;
-    enum piccolo_task_flag_values current_flags;
+    uint32_t lock_value, lock_values[2];
+    uint core = get_core_num();
+    piccolo_os_run_queue_t *run_queue = &piccolo_ctx.run_queue[core];
+    piccolo_os_task_t  *current_task = NULL;
+    uint32_t *stack_ptr;
+    piccolo_timer_node_t *wakeup;
     uint32_t minimum_wait;
     int64_t time_to_wait;
-    bool idle;
+    bool idle, preempted;
     #define Idle_Stack_Size 256
     uint32_t Idle_Stack[Idle_Stack_Size];   // a dummy stack for the idle task
 
     /*
-     * If we are core 0, do some one time initialization,
-     * then launch core 1 if we are in multi-core mode
+     * If we are core 0, launch core 1 if we are in multi-core mode
      */
     if(!get_core_num()) {
-        piccolo_ctx.garbage_man = piccolo_create_task(__piccolo_garbage_man); // create the garbage collector
-        // just in case malloc didn't panic, we should if there was no space
-        if(piccolo_ctx.garbage_man==NULL) panic("Piccolo cannot create garbage collector task!\n");
-        piccolo_ctx.garbage_man->signal_limit = INT32_MAX;
-        // Initalize the last task run to the tail of the chain after task creation
-        piccolo_ctx.current_task = piccolo_ctx.task_list_tail; 
-        
 #if PICCOLO_OS_MULTICORE
         multicore_launch_core1( __piccolo_start_core1); // if we ARE core 0
 #endif
@@ -703,15 +1629,13 @@ void __time_critical_func(piccolo_start)() {
      * SVC and Systick preemption are asynchronous and *could both* occur. We want to make sure that only
      * one happens, otherwise we could schedule twice and skip a task (at best). If they try to occur on top
      * of each other, SVC will alway eventually win because it had a lower exception number.
-     * So it is sufficient to clear any pending systick pending flag. 
+     * So it is sufficient to clear any pending systick pending flag, and PendSV, which a task pends when it 
+     * makes a task of higher priority ready (this switch does that work). Systick keeps running (it cannot 
+     * interrupt us), so the next task gets the rest of the time slice. Another tick may come while we
+     * work, so the flag is cleared again just before the task runs.
      * 
      */
-    systick_hw->csr = 0;    //Disable timer and IRQ   
-    __dsb();                // make sure systick is disabled
-    __isb();                // and it is really off
-
-    // clear the systick pending bit if it got set
-    hw_set_bits  ((io_rw_32 *)(PPB_BASE + M0PLUS_ICSR_OFFSET),M0PLUS_ICSR_PENDSTCLR_BITS);
+    hw_set_bits  ((io_rw_32 *)(PPB_BASE + M0PLUS_ICSR_OFFSET),M0PLUS_ICSR_PENDSTCLR_BITS | M0PLUS_ICSR_PENDSVCLR_BITS);
 
     /*
      * Before manipulating the scheduler variables to find a task to run, lock out the other core!
@@ -719,118 +1643,94 @@ void __time_critical_func(piccolo_start)() {
      * lock_value will contain interrupt status.
      */
     idle = true;    // assume there is nothing to do...
-    minimum_wait = PICCOLO_OS_MAX_IDLE;
     do {
-        lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+        lock_value = piccolo_run_queue_lock(run_queue);
 
+        // Wake the tasks whose timeout expired. Only read the time if any timeout is running.
+        if(piccolo_timer_queue_peek(&run_queue->timer_queue)) __piccolo_expire_timers(run_queue);
 
-        // Note that piccolo_ctx.current_task is volatile, but since we have the lock, current_task is NOT
-        current_task = (piccolo_os_task_t *) piccolo_ctx.current_task;  // last task to run (NULL is bad!)
-        last_task = current_task;                                       // save starting point of our search
-        // Note that there may NOT be any tasks. None were created or all have ended is possible
+        // Only look through the tasks waiting on event groups if one may have become ready:
+        // an event group was changed.
+        if(run_queue->blocked_changed) __piccolo_check_blocked(run_queue);
 
-        // get the next task to run
-        // And we should check for timeouts, signal waits etc.
-        do {
-            if (current_task != NULL) current_task =  current_task->next_task;     // next task in list
-            if (current_task == NULL) current_task =  piccolo_ctx.task_list_head; // reset to list head
-            if (current_task == NULL) break;    // STILL no tasks found. Idle until?
-
-            // Is the task running? (Presumably on a different core!)
-            current_flags = current_task->task_flags;
-            if (current_flags & PICCOLO_TASK_RUNNING) continue; // the other core is running it, skip it
-
-            if(current_flags & PICCOLO_TASK_BLOCKING) {  // Is any blocking flag set?
-                //  Is there a task timer running?
-                if(current_flags & PICCOLO_TASK_SLEEPING) {
-                    time_to_wait = absolute_time_diff_us(get_absolute_time(),current_task->wakeup);
-                    if(time_to_wait <=0) { // Has timer hit now?
-                        // Time to wake up. clear sleeping and blocked
-                        current_flags = 0;
-                        current_task->task_flags = current_flags;
-                    }
-                    else {
-                        // keep track of the shortest time left for any task
-                        if(time_to_wait < minimum_wait) minimum_wait = time_to_wait;
-                    }
-                }
-
-                //  Is it blocked waiting for a signal?
-                if(current_flags & PICCOLO_TASK_GET_SIGNAL_BLOCKED) {
-#if PICCOLO_OS_NO_IDLE_FOR_SIGNALS
-                    minimum_wait = 0;
+        // Note that there may NOT be any tasks. None were created or all have ended is possible
+        current_task = piccolo_run_queue_take_ready(run_queue);
+        if(current_task) {
+            // Mark it running before the lock is released, so a task changing its affinity, priority or
+            // EDF parameters on the other core never sees it on no queue and not running
+            current_task->task_flags = PICCOLO_TASK_RUNNING;
+            current_task->switched_at = time_us_32();
+            piccolo_ctx.this_task[core] = current_task;   // so we can find who we are at run time
+            run_queue->statistics.dispatches++;
+        }
+        else {
+            // Nothing to run. Idle no longer than the earliest timeout, which is at the root of the timer queue
+#if PICCOLO_OS_TICKLESS_IDLE && PICCOLO_OS_MAX_IDLE
+            minimum_wait = PICCOLO_OS_IDLE_FOREVER;
+#else
+            minimum_wait = PICCOLO_OS_MAX_IDLE;
 #endif
-                    // is there data?
-                    if(current_task->signal_in != current_task->signal_out) { //in=out => empty
-                        // YES, clear block flags and run it
-                        current_flags = 0;
-                        current_task->task_flags = current_flags;
-                    }
-                } else {
-
-                    //  Or is it blocked waiting to send a signal? (Can't be both)
-                    if(current_flags & PICCOLO_TASK_SEND_SIGNAL_BLOCKED) {
+            if((wakeup = piccolo_timer_queue_peek(&run_queue->timer_queue))) {
+                time_to_wait = absolute_time_diff_us(get_absolute_time(), wakeup->deadline);
+                if(time_to_wait < minimum_wait) minimum_wait = (time_to_wait > 0)? time_to_wait : 0;
+            }
 #if PICCOLO_OS_NO_IDLE_FOR_SIGNALS
-                        minimum_wait = 0;
+            if(run_queue->blocked_queue.head) minimum_wait = 0;     // someone is waiting on a signal or event
 #endif
-                        // is there room for data?
-                        if(((current_task->task_sending_to->signal_in+1 == 
-                            current_task->task_sending_to->signal_limit)?0:current_task->task_sending_to->signal_in+1 )
-                            != current_task->task_sending_to->signal_out) { //((in+1)%limit == out)=>full
-                            // Yes, clear blocks and run it
-                            current_flags = 0;
-                            current_task->task_flags = current_flags;
-                        }
-                    }
-                }
-            }
-
-            //  It the task ready to run?
-            if (!(current_flags)) {
-                /*
-                 * We found a ready task not already running. Mark it running
-                 * Set idle to false, and break the search loop
-                 */
-                current_task->task_flags = PICCOLO_TASK_RUNNING;
-                piccolo_ctx.current_task = current_task;    // start other schedulers looking in right spot
-                piccolo_ctx.this_task[get_core_num()] = current_task;   // so we can find who we are at run time
-                idle = false;
-                break;
-            }
-
-        } while (current_task != last_task);
+        }
         // and unlock and reenable interrupts
-        spin_unlock(piccolo_ctx.piccolo_lock,lock_value);
+        piccolo_run_queue_unlock(run_queue, lock_value);
+
+#if PICCOLO_OS_MULTICORE
+        // If we have nothing to do, see if the other core has more than it can handle.
+        if(!current_task) {
+            current_task = __piccolo_steal_task(core);
+            // The other core has tasks we may take, but not yet. Look again when they have waited long enough.
+            if(!current_task && piccolo_ctx.run_queue[core ^ 1].stealable_count
+                    && minimum_wait > PICCOLO_OS_MIGRATION_DELAY) minimum_wait = PICCOLO_OS_MIGRATION_DELAY;
+        }
+#endif
+        if(current_task) {
+            /*
+             * We found a ready task, already marked running (under the lock of the queue it came from).
+             * Set idle to false, and leave the search loop
+             */
+            PICCOLO_TRACE(PICCOLO_TRACE_SWITCH_IN, current_task, 0);
+            idle = false;
+        }
 
         /*
          * If we could not find a task, idle is set. If idle sleeping is enabled (PICCOLO_OS_MAX_IDLE not zero),
          * go to low power mode by starting a task in Thread (user) mode which will
-         * actually sleep for PICCOLO_OS_MAX_IDLE, or the minimum timeout time pending.
-         * Remember that a timer or an IRQ can unblock a task by signaling. This implies that the 
-         * system may not respond for one PICCOLO_OS_MAX_IDLE slice time.
+         * actually sleep until the minimum timeout time pending (no longer than PICCOLO_OS_MAX_IDLE unless
+         * PICCOLO_OS_TICKLESS_IDLE is set). A timer or an IRQ which makes a task ready ends the sleep early.
          */
         if(!idle) break;
         else if( minimum_wait) {
+            systick_hw->csr = 0;    // no time slices while we sleep
             __piccolo_pre_switch(__piccolo_os_create_task(
                     (Idle_Stack + Idle_Stack_Size),(void (*)(void)) __piccolo_idle,(uint32_t) minimum_wait));
         }
     } while (idle);
 
     /*
-     * There is a task to run. Reset the systick timer, for preemption and then run the task
+     * There is a task to run. Make sure the systick timer is running, for preemption and then run the task
      * 
      */
-    systick_hw->rvr = PICCOLO_OS_TIME_SLICE; // set for interval
-    // NOTE: setting Time Slice to 0 will disable Systick and turn off preemptive scheduling!
-    systick_hw->cvr = 0;    // reset the current counter
-    __dsb();                // make sure systick is set
-    __isb();                // and it is really ready
-    systick_hw->csr = 3;    // Enable systick timer and IRQ, select 1 usec clock    
+    __piccolo_continue_time_slice();
 
     // At long last, run the task...
+    stack_ptr = __piccolo_pre_switch(current_task->stack_ptr);
+
+    // The fast switch may have run other tasks since. The one which came back to us is the running one.
+    current_task = (piccolo_os_task_t *) piccolo_ctx.this_task[core];
+    current_task->stack_ptr = stack_ptr;
 
-    current_task->stack_ptr =
-        __piccolo_pre_switch(current_task->stack_ptr);
+    // make sure the task stayed within its stack
+    __piccolo_check_stack(current_task);
+    preempted = run_queue->preempt;
+    run_queue->preempt = false;
+    PICCOLO_TRACE(PICCOLO_TRACE_SWITCH_OUT, current_task, current_task->task_flags);
 
     /*
      * The task is preempted or yielded. Since we ran it, we own it, so here
@@ -841,11 +1741,16 @@ void __time_critical_func(piccolo_start)() {
 
     /*
      * Did the currently running task end? If so, remove it from the scheduler chain,
-     * add it to the zombie list and wake up the garbage collector. If not, turn off the running flag.
+     * and give its memory back to its task pool. If not, turn off the running flag
+     * and put it on the blocked queue if it is waiting for something, or back on its ready queue.
      * 
      */
     if(current_task->task_flags & PICCOLO_TASK_ZOMBIE) {
         lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+        // charge its last slice, as for any task which stops running
+        lock_values[0] = piccolo_run_queue_lock(run_queue);
+        __piccolo_account_run(current_task, core, preempted);
+        piccolo_run_queue_unlock(run_queue, lock_values[0]);
         if(current_task->prev_task) 
             current_task->prev_task->next_task = current_task->next_task;
         else
@@ -854,17 +1759,48 @@ void __time_critical_func(piccolo_start)() {
             current_task->next_task->prev_task = current_task->prev_task;
         else
             piccolo_ctx.task_list_tail = current_task->prev_task;
-        if(current_task == piccolo_ctx.current_task) {
-            if(!(piccolo_ctx.current_task = current_task->next_task)) piccolo_ctx.current_task = piccolo_ctx.task_list_head;
-            }
+        // its share of the core is free for other EDF tasks
+        if(current_task->edf.period_us) piccolo_ctx.run_queue[core].edf_load -= current_task->edf.load;
 
-        current_task->next_task = (piccolo_os_task_t *) piccolo_ctx.zombies;
-        piccolo_ctx.zombies = current_task;
+        piccolo_task_pool_release(current_task);
+        piccolo_ctx.this_task[core] = (piccolo_os_task_t *) (uintptr_t) core;  // no task runs on this core now
         spin_unlock(piccolo_ctx.piccolo_lock,lock_value);
-        piccolo_send_signal(piccolo_ctx.garbage_man);
+        PICCOLO_TRACE(PICCOLO_TRACE_TASK_END, current_task, 0);
 
     }
-    else current_task->task_flags &= ~PICCOLO_TASK_RUNNING;
+    else if(!piccolo_task_can_run_on(current_task, core)) {
+        // Its affinity was changed while it ran. Move it to the other core, blocked or ready.
+        lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+        lock_values[0] = piccolo_run_queue_lock(&piccolo_ctx.run_queue[0]);
+        lock_values[1] = piccolo_run_queue_lock(&piccolo_ctx.run_queue[1]);
+        __piccolo_account_run(current_task, core, preempted);
+        current_task->task_flags &= ~PICCOLO_TASK_RUNNING;
+        if(current_task->task_flags & PICCOLO_TASK_BLOCKING) {
+            current_task->blocked_at = time_us_32();
+            current_task->wait_reason = piccolo_wait_reason(current_task->task_flags);
+        }
+        current_task->core = core ^ 1;
+        current_task->statistics.migrations++;
+        run_queue->statistics.migrations++;
+        piccolo_run_queue_attach(&piccolo_ctx.run_queue[core ^ 1], current_task);
+        piccolo_ctx.this_task[core] = (piccolo_os_task_t *) (uintptr_t) core;
+        piccolo_run_queue_unlock(&piccolo_ctx.run_queue[1], lock_values[1]);
+        piccolo_run_queue_unlock(&piccolo_ctx.run_queue[0], lock_values[0]);
+        spin_unlock(piccolo_ctx.piccolo_lock, lock_value);
+        __sev();
+    }
+    else {
+        lock_value = piccolo_run_queue_lock(run_queue);
+        __piccolo_account_run(current_task, core, preempted);
+        current_task->task_flags &= ~PICCOLO_TASK_RUNNING;
+        if(current_task->task_flags & PICCOLO_TASK_BLOCKING) piccolo_run_queue_block(run_queue, current_task);
+        else if(__piccolo_keeps_place(current_task, preempted)) piccolo_run_queue_put_back(run_queue, current_task);
+        else piccolo_run_queue_make_ready(run_queue, current_task);
+        // No task runs on this core now. (Set with the lock held, so a task waking this one sees it
+        // either running or on a queue.)
+        piccolo_ctx.this_task[core] = (piccolo_os_task_t *) (uintptr_t) core;
+        piccolo_run_queue_unlock(run_queue, lock_value);
+    }
 
   }
   return; // shuts doxygen up about no return...
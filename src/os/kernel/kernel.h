@@ -22,7 +22,10 @@
 #ifndef PICCOLO_OS_H
 #define PICCOLO_OS_H
 #include "hardware/sync.h"
+#include "hardware/regs/addressmap.h"
+#include "hardware/regs/m0plus.h"
 #include "pico/stdlib.h"
+#include "timer_queue.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -38,15 +41,71 @@ extern "C" {
  * @brief Size of a task stack in 32 bit words. 
  * @note Must be **even**, for exception frame stack alignment!
  * 
+ * This is the stack size of tasks made by `piccolo_create_task()`. Tasks made by 
+ * `piccolo_create_task_ex()` can have any size of stack down to \ref PICCOLO_OS_MINIMUM_STACK_SIZE.
  */
 #define PICCOLO_OS_STACK_SIZE 1024
 
+/**
+ * @brief Smallest task stack in bytes accepted by `piccolo_create_task_ex()`.
+ * 
+ * The initial exception frame takes 68 bytes. Interrupt handlers run on the main stack,
+ * so a task stack only needs room for the task's own calls and one exception frame.
+ */
+#define PICCOLO_OS_MINIMUM_STACK_SIZE 128
+
+/**
+ * @brief If true, fill each task stack with \ref PICCOLO_OS_STACK_PAINT when the task is created.
+ * 
+ * `piccolo_get_stack_high_water()` finds how much of the stack a task has used by looking for 
+ * the deepest word which no longer holds the paint. Painting costs one store per stack word 
+ * when the task is created.
+ */
+#define PICCOLO_OS_STACK_PAINTING true
+
+/** Value painted into the unused words of a task stack **/
+#define PICCOLO_OS_STACK_PAINT 0xA5A5A5A5
+
+/**
+ * @brief If true, the scheduler checks the task stack every time a task stops running.
+ * 
+ * The lowest word of every task stack holds \ref PICCOLO_OS_STACK_CANARY. If the canary has
+ * been overwritten, or the saved stack pointer is below it, the task has overflowed its stack
+ * and the scheduler panics, naming the task.
+ */
+#define PICCOLO_OS_STACK_CHECK true
+
+/** Value kept in the lowest word of every task stack **/
+#define PICCOLO_OS_STACK_CANARY 0xC0DEFACE
+
+/**
+ * @brief Number of task pool size classes.
+ * 
+ * Tasks are allocated from pools with stacks of \ref PICCOLO_OS_MINIMUM_STACK_SIZE bytes, and
+ * twice that, and so on for this many sizes (so the largest stack is 64 KBytes with 10 classes). 
+ * A requested stack size is rounded up to the next class.
+ */
+#define PICCOLO_OS_POOL_CLASSES 10
+
+/**
+ * @brief Smallest block in bytes in the frame pools (a power of 2), and the number of frame pool size classes
+ * 
+ * `piccolo_frame_allocate()` rounds a size up to the next power of 2 from this, so the largest frame 
+ * is 4 KBytes with 8 classes. The C++ coroutine tasks (`coroutine.hpp`) take their frames from these pools.
+ */
+#define PICCOLO_OS_MINIMUM_FRAME_SIZE 32
+#define PICCOLO_OS_FRAME_CLASSES 8
+
 /** Exception return behavior value **/
 #define PICCOLO_OS_THREAD_PSP 0xFFFFFFFD
 
 /**
- * @brief The OS time slice, in microseconds 
+ * @brief The OS tick, and the default time slice, in microseconds 
  * 
+    Systick ticks once per tick, and is not reset when tasks switch, so a task which is switched 
+    in gets the rest of the current tick. Each priority has a time slice of a whole number of ticks, one unless
+    `piccolo_set_time_slice()` says otherwise. A task of higher priority made ready on another core preempts
+    at the next tick, so this also bounds that latency.
     Setting time slice to zero will disable Systick and preemptive scheduling!
 */
 #define PICCOLO_OS_TIME_SLICE 1000
@@ -59,16 +118,46 @@ extern "C" {
 #define PICCOLO_OS_MAX_IDLE 700
 
 /**
- * @brief If true, scheduler will not idle if tasks are blocking for signals.
+ * @brief If true, an idle core sleeps until its next timeout, however long that is.
+ * 
+ * The core is only woken by its idle alarm at the earliest timeout, or by an interrupt or another task
+ * making a task ready. With no timeouts running it sleeps until that happens. If false, it wakes
+ * at least every \ref PICCOLO_OS_MAX_IDLE microseconds.
+ */
+#define PICCOLO_OS_TICKLESS_IDLE true
+
+/** Idle time meaning "until something happens" (no timeout is running) **/
+#define PICCOLO_OS_IDLE_FOREVER UINT32_MAX
+
+/**
+ * @brief If true, scheduler will not idle if tasks are blocking for signals or event groups.
  * 
  * If set to false, the scheduler will run the idle task for the minimum of
  * PICCOLO_OS_MAX_IDLE or the smallest time remaining for any task with a timeout
- * running. This will improve power consumption but potentially delay the response
- * of any task waiting for a signal. This may make good sense for applications without
- * serious response time concerns.
+ * running. Sending a signal or setting event flags wakes an idle core at once, 
+ * so idling does not delay the response of a task waiting for them.
+ * 
+ */
+#define PICCOLO_OS_NO_IDLE_FOR_SIGNALS false
+
+/**
+ * @brief If true, yield and preemption switch straight from one task to the next in the PendSV handler.
  * 
+ * This skips the round trip through the scheduler loop in `piccolo_start()`, which saves and restores the
+ * kernel's registers as well as the task's. The loop is still used when a task ends, or when the core has
+ * nothing left to run. If false, every switch goes through the loop.
  */
-#define PICCOLO_OS_NO_IDLE_FOR_SIGNALS true
+#define PICCOLO_OS_FAST_SWITCH true
+
+/**
+ * @brief True when the kernel is built for the host simulation in `src/os/host`, rather than the RP2040.
+ * 
+ * Set by the host build. The host port (`host/port.c`) then provides the context switch, the two 
+ * cores, SysTick and the rest of the hardware the kernel uses.
+ */
+#ifndef PICCOLO_OS_HOST
+#define PICCOLO_OS_HOST false
+#endif
 
 /**
  * @brief Enable/disable multi-core scheduling
@@ -76,6 +165,75 @@ extern "C" {
 **/
 #define PICCOLO_OS_MULTICORE true
 
+/**
+ * @brief How long (in usec) a task must have been ready before an idle core takes it from the other core.
+ * 
+ * Soft affinity: a task stays on the core it last ran on unless that core can't get to it. A task which
+ * was made ready a moment ago will most likely run on its own core at the next switch, so it is left there,
+ * unless its core has more than one task waiting. Zero lets an idle core take any ready task at once.
+ */
+#define PICCOLO_OS_MIGRATION_DELAY 500
+
+/**
+ * @brief How much of a core (in percent) the EDF tasks admitted to it may claim between them.
+ * 
+ * A task joins the EDF class (`piccolo_set_edf()`) only if its budget divided by its relative deadline,
+ * added to that of the EDF tasks already on the core, stays within this. Below 100, EDF deadlines are met 
+ * with room left for the kernel, interrupts and the best effort tasks.
+ */
+#define PICCOLO_OS_EDF_MAX_LOAD 90
+
+/**
+ * @brief Stack size in bytes of the task on each core which runs the lightweight tasks.
+ * 
+ * Lightweight tasks (`piccolo_lite_create()`) have no stack of their own. Each core's lightweight tasks run, 
+ * one at a time, on the stack of that core's runner task, which is created with the first lightweight task
+ * on the core. So this must hold the deepest call any of them makes.
+ */
+#define PICCOLO_OS_LITE_STACK_SIZE 1024
+
+/**
+ * @brief Stack size in bytes of the timer task, which runs the software timer callbacks.
+ * 
+ * The callbacks of all the software timers (`piccolo_timer_create()`) run one at a time on the stack of a 
+ * single kernel task, created with the first timer. So this must hold the deepest call any of them makes.
+ */
+#define PICCOLO_OS_TIMER_STACK_SIZE 1024
+
+/**
+ * @brief Priority of the timer task.
+ * 
+ * The highest, so that a callback runs as soon as its timer expires, whatever else is ready.
+ * A callback which takes long holds up all the tasks of lower priority on its core.
+ */
+#define PICCOLO_OS_TIMER_PRIORITY (PICCOLO_OS_PRIORITY_LEVELS - 1)
+
+/**
+ * @brief Work items each core's deferred work queue holds. A power of 2.
+ * 
+ * Interrupt service handlers hand work on to the worker task of their core through its queue 
+ * (`piccolo_work_post()`). Work posted while the worker is this far behind is dropped.
+ */
+#define PICCOLO_OS_WORK_QUEUE_SIZE 64
+
+/**
+ * @brief Bytes of data each deferred work item carries to its function. A multiple of 4.
+ */
+#define PICCOLO_OS_WORK_PAYLOAD 8
+
+/**
+ * @brief Stack size in bytes of each core's worker task, which runs the deferred work.
+ */
+#define PICCOLO_OS_WORK_STACK_SIZE 1024
+
+/**
+ * @brief Priority of the worker tasks.
+ * 
+ * Just below the timer task, so deferred work runs as soon as the interrupt service handler which 
+ * posted it returns, ahead of all the other tasks.
+ */
+#define PICCOLO_OS_WORK_PRIORITY (PICCOLO_OS_PRIORITY_LEVELS - 2)
+
 /**
  * @brief Signal channel size. (max is INT32_MAX)
  * 
@@ -86,9 +244,133 @@ extern "C" {
  */
 #define PICCOLO_OS_MAX_SIGNAL 10
 
+/**
+ * @brief Number of scheduler priority levels. (max is 32)
+ * 
+ * Each level has its own ready queue, and one bit in the ready bitmap
+ * which is set while that queue is not empty. Higher numbers run first, and a task
+ * runs only while no task of higher priority is ready on its core. Tasks of the same 
+ * priority take turns, a time slice each.
+ */
+#define PICCOLO_OS_PRIORITY_LEVELS 32
+
+/** Priority given to new tasks **/
+#define PICCOLO_OS_DEFAULT_PRIORITY 16
+
+/**
+ * @brief Number of lock wait queues on each core's run queue. (must be a power of 2)
+ * 
+ * Tasks blocked on an SDK mutex or semaphore wait on the queue selected by the lock's address,
+ * so releasing a lock only looks at the tasks which hash to the same queue.
+ */
+#define PICCOLO_OS_LOCK_WAIT_QUEUES 8
+
 /** Piccolo spin lock to use **/
 #define PICCOLO_SPIN_LOCK_ID PICO_SPINLOCK_ID_OS1
 
+/**
+ * @brief Number of spin locks protecting the tasks' signal channels. (must be a power of 2)
+ * 
+ * Sending to a task (or setting its mailbox) takes the lock selected by the task's address, rather than 
+ * the global lock, so senders to different tasks rarely wait for each other, or for task creation and 
+ * migration. Lightweight tasks, software timers, event groups and starting workers still use the global lock.
+ *
+ * The locks come from the 8 spin locks the SDK leaves for `spin_lock_claim_unused()`, as do the 2 run queue
+ * locks, so 2 leaves 4 for the application. If there are too few, the signal locks claimed are shared.
+ */
+#define PICCOLO_OS_SIGNAL_LOCKS 2
+
+/**
+ * @brief If true, measure how long each core's run queue lock is held.
+ * 
+ * Costs two timer reads each time a run queue lock is taken. The acquisition, contention
+ * and steal counts are always kept.
+ */
+#define PICCOLO_OS_LOCK_STATISTICS true
+
+/**
+ * @brief If true, record scheduler events in a trace ring on each core (see trace.h).
+ * 
+ * Each ring takes 16 bytes per event. When false the trace code is compiled out completely.
+ */
+#define PICCOLO_OS_TRACE false
+
+/**
+ * @brief The number of events in each core's trace ring (a power of 2)
+ * 
+ */
+#define PICCOLO_OS_TRACE_EVENTS 512
+
+/**
+ * @brief An event group: 32 event flags which tasks can wait on, in any combination
+ * 
+ */
+typedef struct {
+    volatile uint32_t bits;                     /**< the event flags which are set **/
+} piccolo_event_group_t;
+
+/**
+ * @brief The cores a task may run on, as a mask. Combine with |.
+ * 
+ */
+enum piccolo_os_affinity {
+    PICCOLO_AFFINITY_CORE0 = 0x1,       /**< core 0 **/
+    PICCOLO_AFFINITY_CORE1 = 0x2,       /**< core 1 **/
+    PICCOLO_AFFINITY_ANY = 0x3          /**< either core (the default) **/
+};
+
+/**
+ * @brief Why a task was blocked, for its wait time statistics
+ * 
+ * A task waiting on a signal, event or lock with a timeout is counted as waiting on that, not sleeping.
+ */
+enum piccolo_os_wait_reason {
+    PICCOLO_WAIT_SLEEP,                 /**< `piccolo_sleep()` and friends **/
+    PICCOLO_WAIT_GET_SIGNAL,            /**< waiting for a signal or message **/
+    PICCOLO_WAIT_SEND_SIGNAL,           /**< waiting for room to send a signal or message **/
+    PICCOLO_WAIT_EVENT,                 /**< waiting on an event group **/
+    PICCOLO_WAIT_LOCK,                  /**< waiting on an SDK mutex, semaphore or other lock **/
+    PICCOLO_WAIT_REASONS                /**< the number of reasons **/
+};
+
+/**
+ * @brief Where a task's time has gone. Kept by the schedulers.
+ * 
+ */
+typedef struct {
+    uint64_t run_us;                            /**< total time the task has run **/
+    uint64_t core_run_us[2];                    /**< time the task has run on each core **/
+    uint64_t wait_us[PICCOLO_WAIT_REASONS];     /**< time the task has spent blocked, by \ref piccolo_os_wait_reason **/
+    uint32_t yields;                            /**< switches away from the task because it yielded or blocked **/
+    uint32_t preemptions;                       /**< switches away from the task because its time slice ended **/
+    uint32_t migrations;                        /**< times the task was moved to the other core's run queue **/
+    uint32_t last_core;                         /**< core the task last ran on **/
+    uint32_t edf_jobs;                          /**< EDF jobs the task has finished **/
+    uint32_t edf_misses;                        /**< EDF jobs finished after their deadline **/
+    uint32_t edf_overruns;                      /**< EDF jobs which ran past their budget **/
+} piccolo_os_task_statistics_t;
+
+/**
+ * @brief A task's place in the earliest deadline first (EDF) class
+ * 
+ * Each period the task is released to do one job, which may run for its budget and must be done
+ * by its deadline. While the job is within budget it runs ahead of every best effort task, the job 
+ * with the earliest deadline first. Past its budget, it runs at the task's priority until the next release.
+ */
+typedef struct {
+    uint32_t period_us;                         /**< time between releases, or 0 if the task is not in the EDF class **/
+    uint32_t budget_us;                         /**< run time each job may take **/
+    uint32_t deadline_us;                       /**< time after its release by which each job must be done **/
+    uint32_t load;                              /**< budget / deadline in millionths of a core, counted against its core **/
+    uint32_t affinity;                          /**< the task's affinity before it was pinned to its core **/
+    absolute_time_t release;                    /**< when the current job was released **/
+    uint32_t used_us;                           /**< run time charged to the current job so far **/
+    uint32_t started_at;                        /**< time the current job started, if `started_running` **/
+    bool started_running;                       /**< the current job started part way through the running slice **/
+    bool scheduled;                             /**< the current job is within budget, so is scheduled by deadline **/
+    piccolo_timer_node_t node;                  /**< on the EDF ready queue, by the absolute deadline of the job **/
+} piccolo_os_edf_t;
+
 /**
  * @brief Piccolo OS task data structure
  * 
@@ -99,28 +381,247 @@ struct piccolo_os_task_t {
     volatile uint32_t task_flags;               /**< Task Status **/
     struct piccolo_os_task_t *next_task;        /**< next task in scheduler chain **/
     struct piccolo_os_task_t *prev_task;        /**< previous task in scheduler chain **/
+    struct piccolo_os_task_t *queue_next;       /**< next task in the ready or blocked queue **/
+    struct piccolo_os_task_t *queue_prev;       /**< previous task in the ready or blocked queue **/
+    uint32_t priority;                          /**< ready queue the task is placed on **/
+    uint32_t core;                              /**< core whose run queue the task is on **/
+    uint32_t affinity;                          /**< cores the task may run on (\ref piccolo_os_affinity) **/
+    uint32_t slice_left;                        /**< ticks left in its time slice, or 0 if its priority has no limit **/
+    uint32_t ready_at;                          /**< time the task was last made ready, for soft affinity **/
     struct piccolo_os_task_t *task_sending_to;  /**< task that this one if blocked trying to signal **/
-    absolute_time_t wakeup;                     /**< end of sleep time or timeout **/
+    piccolo_timer_node_t wakeup;                /**< end of sleep time or timeout (in the timer queue while sleeping) **/
+    piccolo_os_edf_t edf;                       /**< EDF period, budget and current job **/
     volatile uint32_t signal_in;                /**< input values for the task's input signal channel **/
     volatile uint32_t signal_out;               /**< output values for the task's input signal channel **/
     uint32_t signal_limit;                      /**< maximum (-1) number of signals the task can queue **/
+    volatile uint32_t senders_blocked;          /**< number of tasks blocked sending to the task's full signal channel **/
+    uint8_t *mailbox;                           /**< message slots, one per signal channel position, or NULL **/
+    uint32_t message_size;                      /**< size of each message slot in bytes **/
+    piccolo_event_group_t *event_group;         /**< event group the task is blocked waiting on **/
+    uint32_t event_bits;                        /**< event flags the task is waiting for **/
+    bool event_wait_all;                        /**< true if all of `event_bits` must be set, not just one **/
+    void *lock_waiting_on;                      /**< SDK lock (`lock_core_t`) the task is blocked waiting on **/
     uint32_t *stack_ptr;                        /**< the task stack pointer **/
-    uint32_t __attribute__((aligned(8))) stack[PICCOLO_OS_STACK_SIZE];       /**< the task stack space **/
+    uint32_t *stack;                            /**< the task stack space (allocated along with the task) **/
+    uint32_t stack_size;                        /**< size of the task stack in bytes **/
+    const char *name;                           /**< task name for debugging output, or NULL **/
+    piccolo_os_task_statistics_t statistics;    /**< where the task's time has gone **/
+    uint32_t switched_at;                       /**< time the task last started running **/
+    uint32_t blocked_at;                        /**< time the task was last blocked **/
+    uint32_t wait_reason;                       /**< \ref piccolo_os_wait_reason it was blocked for **/
 }  piccolo_os_task_t;
 
+/**
+ * @brief A snapshot of one task, from `piccolo_get_task_info()`
+ * 
+ */
+typedef struct {
+    piccolo_os_task_t *task;                    /**< the task identifier **/
+    const char *name;                           /**< its name, or NULL **/
+    uint32_t task_flags;                        /**< its status **/
+    uint32_t priority;                          /**< its priority **/
+    uint32_t core;                              /**< the core whose run queue it is on **/
+    uint32_t affinity;                          /**< the cores it may run on **/
+    piccolo_os_task_statistics_t statistics;    /**< where its time has gone, including any time slice it is in now **/
+} piccolo_os_task_info_t;
+
+/**
+ * @brief A FIFO queue of tasks, linked through `queue_next` and `queue_prev`
+ * 
+ */
+typedef struct {
+    piccolo_os_task_t *head;            /**< first task in the queue (next to run) **/
+    piccolo_os_task_t *tail;            /**< last task in the queue **/
+} piccolo_os_task_queue_t;
+
+/**
+ * @brief Scheduler statistics for one core
+ * 
+ */
+typedef struct {
+    uint32_t dispatches;                /**< tasks started on the core **/
+    uint32_t steals;                    /**< tasks the core took from the other core's ready queues **/
+    uint32_t migrations;                /**< tasks moved to the other core because their affinity ruled this one out **/
+    uint32_t fast_switches;             /**< dispatches made by the PendSV handler, without the scheduler loop **/
+    uint32_t resumes;                   /**< yields and ticks which went straight back to the same task, the only one ready **/
+    uint32_t lock_acquisitions;         /**< times the core's run queue lock was taken (by either core) **/
+    uint32_t lock_contended;            /**< acquisitions which had to wait for the other core **/
+    uint64_t lock_hold_us;              /**< total time the run queue lock was held (if \ref PICCOLO_OS_LOCK_STATISTICS) **/
+    uint64_t idle_us;                   /**< total time the core spent asleep in the idle task **/
+    uint32_t idle_wakeups;              /**< times the core woke from the idle task **/
+} piccolo_os_core_statistics_t;
+
+/**
+ * @brief Task pool statistics for one size class
+ * 
+ */
+typedef struct {
+    uint32_t stack_size;                /**< size of the stacks in this class, in bytes **/
+    uint32_t allocated;                 /**< task blocks taken from the heap for this class **/
+    uint32_t free;                      /**< blocks in the pool waiting for a new task **/
+    uint32_t reused;                    /**< tasks created from a block in the pool (without the heap) **/
+    uint32_t reclaimed;                 /**< tasks which ended and had their block returned to the pool **/
+} piccolo_os_pool_statistics_t;
+
+/**
+ * @brief The pool of free task blocks (task structure and stack) of one size class
+ * 
+ */
+typedef struct {
+    piccolo_os_task_t *free;                    /**< free blocks, linked through `next_task` **/
+    piccolo_os_pool_statistics_t statistics;    /**< counters for \ref piccolo_get_pool_statistics **/
+} piccolo_os_task_pool_t;
+
+/**
+ * @brief The run queue of one core
+ * 
+ * Each core schedules from its own run queue, protected by its own spin lock. A task 
+ * which is not running is on exactly one run queue. If it can run it is on one of the 
+ * ready queues (one per priority, with a bitmap of the non-empty queues). If it is blocked 
+ * it is on the blocked queue if it waits on a signal, and in the timer queue if it has a 
+ * timeout running. A task blocked on an SDK mutex or semaphore is on a lock wait queue instead, which the
+ * scheduler never looks through. Releasing the lock wakes it.
+ */
+typedef struct {
+    spin_lock_t *lock;                          /**< protects everything in the run queue **/
+    uint32_t ready_bitmap;                      /**< bit `i` is set if `ready_queue[i]` is not empty **/
+    volatile uint32_t ready_count;              /**< number of tasks on the ready queues **/
+    volatile uint32_t stealable_count;          /**< how many of them may also run on the other core **/
+    piccolo_os_task_queue_t ready_queue[PICCOLO_OS_PRIORITY_LEVELS]; /**< tasks ready to run, one queue per priority **/
+    piccolo_timer_queue_t edf_queue;            /**< ready EDF jobs within budget, earliest deadline first, ahead of the ready queues **/
+    uint32_t edf_load;                          /**< sum of the loads of the EDF tasks on the core (global lock) **/
+    piccolo_os_task_queue_t blocked_queue;      /**< tasks waiting to send or receive signals **/
+    piccolo_os_task_queue_t lock_wait_queue[PICCOLO_OS_LOCK_WAIT_QUEUES]; /**< tasks waiting on SDK locks, by lock address **/
+    volatile bool blocked_changed;              /**< set when a task waiting on an event group may have become ready **/
+    bool preempt;                               /**< a task of higher priority than the running one was made ready by this core **/
+    piccolo_timer_queue_t timer_queue;          /**< tasks with a timeout running, earliest wakeup first **/
+    uint32_t lock_taken_at;                     /**< time the lock was last taken, for \ref PICCOLO_OS_LOCK_STATISTICS **/
+    uint idle_alarm;                            /**< hardware alarm which ends the core's idle time **/
+    piccolo_os_core_statistics_t statistics;    /**< counters for \ref piccolo_get_core_statistics **/
+} piccolo_os_run_queue_t;
+
+/**
+ * @brief A lightweight task: a function run to its next wait on the stack of its core's runner task
+ * 
+ * The structure is all the memory the task needs. It is written by the kernel, except that the 
+ * task function may set `argument`.
+ */
+// \cond force_doxygen_to_list
+typedef /*\endcond**/
+struct piccolo_lite_task_t {
+    struct piccolo_lite_task_t *next;           /**< next task on the runner's ready list **/
+    uint32_t (*function)(struct piccolo_lite_task_t *lite); /**< the task function. Returns what it waits on. **/
+    void *argument;                             /**< for the task function **/
+    uint16_t resume;                            /**< where the task function carries on (`__LINE__`), 0 to start **/
+    uint8_t flags;                              /**< what the task waits on (\ref piccolo_lite_flag_values) **/
+    uint8_t core;                               /**< the core whose runner runs it **/
+    volatile uint32_t signals;                  /**< signals sent to the task and not yet taken **/
+    piccolo_timer_node_t wakeup;                /**< end of sleep time or timeout (in the runner's timer queue while sleeping) **/
+    void *lock_waiting_on;                      /**< the SDK lock (`lock_core_t`) it waits on (`piccolo_lite_wait_lock()`), or NULL **/
+    struct piccolo_lite_task_t *lock_next;      /**< next task on the runner's list of lock waiters **/
+} piccolo_lite_task_t;
+
+/**
+ * @brief What runs the lightweight tasks of one core. Protected by the global lock.
+ * 
+ */
+typedef struct {
+    piccolo_os_task_t *task;                    /**< the runner task, NULL before it is needed, 1 while it is created **/
+    piccolo_lite_task_t *ready_head;            /**< lightweight tasks ready to run, in the order they became ready **/
+    piccolo_lite_task_t *ready_tail;            /**< last of them **/
+    piccolo_timer_queue_t timer_queue;          /**< lightweight tasks with a timeout running, earliest wakeup first **/
+    piccolo_lite_task_t *lock_waiters;          /**< lightweight tasks waiting on SDK locks **/
+    uint32_t count;                             /**< lightweight tasks on the core which have not ended **/
+    bool waiting;                               /**< the runner is blocked, or about to block, until it is signalled **/
+} piccolo_os_lite_runner_t;
+
+/**
+ * @brief A software timer: a callback run by the timer task when the timer expires, once or periodically
+ * 
+ * The structure is all the memory the timer needs. It is written by the kernel, except that the callback
+ * may set `argument`.
+ */
+// \cond force_doxygen_to_list
+typedef /*\endcond**/
+struct piccolo_timer_t {
+    piccolo_timer_node_t expiry;                /**< when it next expires (in the timer task's queue while it runs) **/
+    void (*callback)(struct piccolo_timer_t *timer); /**< run by the timer task each time the timer expires **/
+    void *argument;                             /**< for the callback **/
+    uint32_t delay_us;                          /**< from starting the timer to its first expiry **/
+    uint32_t period_us;                         /**< from one expiry to the next, or 0 for a one-shot timer **/
+    uint32_t missed;                            /**< expiries skipped because the callback would have run a period late **/
+    bool active;                                /**< the timer is running **/
+} piccolo_timer_t;
+
+/**
+ * @brief What runs the software timers. Protected by the global lock.
+ * 
+ */
+typedef struct {
+    piccolo_os_task_t *task;                    /**< the timer task, NULL before it is needed, 1 while it is created **/
+    piccolo_timer_queue_t timer_queue;          /**< the running timers, earliest expiry first **/
+    bool waiting;                               /**< the timer task is blocked, or about to block, until it is signalled **/
+} piccolo_os_timer_service_t;
+
+/**
+ * @brief A deferred work item: a function to run in a worker task, with its argument and data
+ * 
+ */
+typedef struct {
+    void (*function)(void *argument, const void *payload); /**< run by the worker **/
+    void *argument;                             /**< for the function **/
+    uint32_t payload[PICCOLO_OS_WORK_PAYLOAD / sizeof(uint32_t)]; /**< the data posted with it **/
+} piccolo_os_work_t;
+
+/**
+ * @brief Counters kept by a core's deferred work queue
+ * 
+ */
+typedef struct {
+    uint32_t posted;                            /**< work items posted **/
+    uint32_t dropped;                           /**< work items not posted because the queue was full **/
+    uint32_t batches;                           /**< times the worker has emptied the queue **/
+    uint32_t wakeups;                           /**< times a post has had to signal the worker **/
+    uint32_t most_queued;                       /**< the most work items waiting at once **/
+} piccolo_os_work_statistics_t;
+
+/**
+ * @brief The deferred work queue of one core: a ring posted to only by that core, and run by its worker task
+ * 
+ * Posts change it with interrupts disabled, and the worker, which only runs on the core, reads `head` as
+ * one word. So it needs no spin lock.
+ */
+typedef struct {
+    piccolo_os_work_t item[PICCOLO_OS_WORK_QUEUE_SIZE]; /**< the ring. Item `i` is in `item[i % PICCOLO_OS_WORK_QUEUE_SIZE]` **/
+    volatile uint32_t head;                     /**< number of items posted **/
+    volatile uint32_t tail;                     /**< number of items run (so their slots are free) **/
+    volatile bool waiting;                      /**< the worker is blocked, or about to block, until it is signalled **/
+    piccolo_os_task_t *worker;                  /**< the worker task, NULL before it is started, 1 while it is created **/
+    piccolo_os_work_statistics_t statistics;    /**< what the queue has done **/
+} piccolo_os_work_queue_t;
+
 /**
  * @brief Piccolo OS internal data structure
  * 
+ * Every task is on the `task_list_head` chain, which is protected by the global `piccolo_lock`. 
+ * The global lock also protects the task pools, and is taken to move a task from one core's run queue to 
+ * the other's. The signal channels have their own locks (\ref PICCOLO_OS_SIGNAL_LOCKS).
  */
 
 struct {
   piccolo_os_task_t* task_list_head;   /**< pointer to the first task in scheduler list **/
   piccolo_os_task_t* task_list_tail;   /**< pointer to the last task in scheduler list **/
   volatile piccolo_os_task_t* this_task[2];     /**< `this_task[i]` points to task being run on core `i`. **/
-  volatile piccolo_os_task_t *current_task;     /**< last task started on either core for round-robin scheduling **/
-  piccolo_os_task_t *zombies;          /**< (singly linked) list of dead tasks for garbage collection **/
-   piccolo_os_task_t *garbage_man;              /**< Garbage collector task (so schedulers can signal him) **/
-  spin_lock_t *piccolo_lock;                    /**< spin lock instance **/
+  piccolo_os_run_queue_t run_queue[2];          /**< `run_queue[i]` holds the tasks scheduled by core `i` **/
+  piccolo_os_task_pool_t pool[PICCOLO_OS_POOL_CLASSES]; /**< free task blocks, one pool per stack size class **/
+  void *frame_pool[PICCOLO_OS_FRAME_CLASSES];   /**< free frame blocks of each size class, linked through their first word **/
+  spin_lock_t *piccolo_lock;                    /**< global lock: the task list, and tasks moving between cores **/
+  spin_lock_t *signal_lock[PICCOLO_OS_SIGNAL_LOCKS]; /**< protect the senders' side of the signal channels, by task address **/
+  volatile bool fast_switch;                    /**< true if the PendSV handler may switch tasks itself **/
+  uint32_t time_slice[PICCOLO_OS_PRIORITY_LEVELS]; /**< ticks in the time slice of each priority, 0 for no limit **/
+  piccolo_os_lite_runner_t lite_runner[2];      /**< `lite_runner[i]` runs the lightweight tasks of core `i` **/
+  piccolo_os_timer_service_t timer_service;     /**< runs the software timers **/
+  piccolo_os_work_queue_t work_queue[2];        /**< `work_queue[i]` holds the work deferred by core `i` **/
 } typedef piccolo_os_internals_t;
 
 // Define Task Flag values
@@ -131,9 +632,24 @@ enum piccolo_task_flag_values
     PICCOLO_TASK_SLEEPING   = 0x4,      ///< Task has a timeout running
     PICCOLO_TASK_GET_SIGNAL_BLOCKED     = 0x8,  ///< Task blocked getting signal
     PICCOLO_TASK_SEND_SIGNAL_BLOCKED    = 0x10, ///< Task block sending signal
-    PICCOLO_TASK_BLOCKING = (PICCOLO_TASK_SLEEPING | PICCOLO_TASK_GET_SIGNAL_BLOCKED | PICCOLO_TASK_SEND_SIGNAL_BLOCKED) \
+    PICCOLO_TASK_EVENT_BLOCKED          = 0x20, ///< Task blocked waiting on an event group
+    PICCOLO_TASK_LOCK_BLOCKED           = 0x40, ///< Task blocked waiting on an SDK mutex or semaphore
+    PICCOLO_TASK_WAITING = (PICCOLO_TASK_GET_SIGNAL_BLOCKED | PICCOLO_TASK_SEND_SIGNAL_BLOCKED | PICCOLO_TASK_EVENT_BLOCKED), \
+                                        ///<Task is on the blocked queue
+    PICCOLO_TASK_BLOCKING = (PICCOLO_TASK_SLEEPING | PICCOLO_TASK_WAITING | PICCOLO_TASK_LOCK_BLOCKED) \
                                         ///<Task blocked for some reason
 };
+
+// Define lightweight task flag values, which the task function returns to say what it waits on
+enum piccolo_lite_flag_values
+{
+    PICCOLO_LITE_READY      = 0x0,      ///< Task can run again (it yielded)
+    PICCOLO_LITE_SLEEPING   = 0x1,      ///< Task has a timeout running
+    PICCOLO_LITE_GET_SIGNAL_BLOCKED = 0x2,  ///< Task blocked getting signal
+    PICCOLO_LITE_ENDED      = 0x4,      ///< Task has ended. Its structure can be reused.
+    PICCOLO_LITE_SUSPENDED  = 0x8,      ///< Task blocked until `piccolo_lite_wake()`
+    PICCOLO_LITE_WOKEN      = 0x10      ///< `piccolo_lite_wake()` was called while the task ran, so it does not suspend
+};
 /**@}**/
 /** @defgroup Cinter The Piccolo OS Plus APIs
  * 
@@ -160,13 +676,44 @@ void piccolo_start();
  * Once a task is running, it can yield the processor to the next task voluntarily. It can also 
  * suspend execution (sleep) for a time and allow other tasks to execute.
  * 
+ * A task runs on either core unless its affinity says otherwise. A task can be pinned to one core 
+ * when it is created (`piccolo_create_task_on()`) or at any time after (`piccolo_set_affinity()`), 
+ * so it keeps its core's state to itself or has a core to itself, while other tasks float. 
+ * 
+ * Tasks are created with priority \ref PICCOLO_OS_DEFAULT_PRIORITY. A task given a higher priority
+ * (`piccolo_set_priority()`) preempts lower priority tasks as soon as it is ready: at once if it was made 
+ * ready on its own core, or at the next tick if by the other core. So a task handling touch or refilling
+ * an audio buffer waits for no more than the tasks of its own priority or higher, however many run 
+ * below it. Tasks of one priority take turns a time slice at a time (`piccolo_set_time_slice()`).
+ * 
+ * Periodic deadline work (refilling audio frames, drawing for vsync) can join the earliest deadline 
+ * first class with `piccolo_set_edf()`, giving its period, the run time each period needs (its budget) 
+ * and its deadline. A task is admitted only if its core can meet all its EDF deadlines (see 
+ * \ref PICCOLO_OS_EDF_MAX_LOAD). EDF jobs run ahead of all other tasks, and each job ends with
+ * `piccolo_edf_wait()`. Missed deadlines and budget overruns are counted in the task statistics.
+ * 
  * @note To send a signal to a task, the sender must have the pointer to the task returned by `piccolo_create_task()`.
  * 
   */
 
 ///@{
 piccolo_os_task_t* piccolo_create_task(void (*pointer_to_task_function)(void));
+piccolo_os_task_t* piccolo_create_task_ex(void (*pointer_to_task_function)(void *), void *argument,
+    uint32_t stack_size, const char *name);
+piccolo_os_task_t* piccolo_create_task_on(void (*pointer_to_task_function)(void *), void *argument,
+    uint32_t stack_size, const char *name, uint32_t affinity);
+bool piccolo_set_affinity(piccolo_os_task_t *task, uint32_t affinity);
+uint32_t piccolo_get_affinity(piccolo_os_task_t *task);
+bool piccolo_set_priority(piccolo_os_task_t *task, uint32_t priority);
+bool piccolo_set_edf(piccolo_os_task_t *task, uint32_t period_us, uint32_t budget_us, uint32_t deadline_us);
+void piccolo_edf_wait(void);
+uint32_t piccolo_get_priority(piccolo_os_task_t *task);
+void piccolo_set_time_slice(uint32_t priority, uint32_t slice_us);
 void piccolo_end_task();
+#if PICCOLO_OS_HOST
+void __piccolo_host_yield(void);
+uint32_t __piccolo_host_interrupts_disabled(void);
+#endif
 
 
 
@@ -174,12 +721,21 @@ void piccolo_end_task();
  * @brief Yields the processor to another task.
  * 
  * The scheduler will switch to the next ready task in a "round robin" manner.
+ * With \ref PICCOLO_OS_FAST_SWITCH this pends PendSV, which is taken at once.
  * 
  */
 __force_inline static void piccolo_yield(void) {
+#if PICCOLO_OS_HOST
+    __piccolo_host_yield();
+#elif PICCOLO_OS_FAST_SWITCH
+    *(io_rw_32 *)(PPB_BASE + M0PLUS_ICSR_OFFSET) = M0PLUS_ICSR_PENDSVSET_BITS;
+    __asm volatile ("dsb" ::: "memory");
+    __asm volatile ("isb" );
+#else
     __asm volatile ("nop" );
     __asm volatile ("svc 0");
     __asm volatile ("nop" );
+#endif
     return;
 }
 
@@ -190,6 +746,7 @@ __force_inline static void piccolo_yield(void) {
 void piccolo_syscall(void);
 void piccolo_sleep(uint32_t sleep_time_ms);
 void piccolo_sleep_until(absolute_time_t until);
+void piccolo_fast_switch(bool enable);
 ///@}
 
 /** @name Task Signals
@@ -214,6 +771,247 @@ int32_t piccolo_get_signal_all();
 int32_t piccolo_get_signal_all_blocking();
 int32_t piccolo_get_signal_all_blocking_timeout(uint32_t timeout_ms);
 
+///@}
+
+/** @name Task Mailboxes
+ * 
+ * A task can give its signal channel a mailbox, so that every signal carries a message of a fixed size.
+ * The messages are copied into (and out of) a ring of slots alongside the signal channel, so sending and 
+ * receiving a message is a single operation. For messages the size of a pointer, buffers can be handed 
+ * from task to task without copying them.
+ * Like signals, messages can be sent (but not waited for!) by interrupt service handlers and timer callbacks.
+ */
+
+///@{
+
+/**
+ * @brief Size in bytes of the buffer needed for a mailbox
+ * 
+ * @param message_size size of one message in bytes
+ * @param message_count maximum number of messages the mailbox can hold
+ */
+#define PICCOLO_MAILBOX_BUFFER_SIZE(message_size, message_count) ((message_size) * ((message_count) + 1))
+
+void piccolo_set_mailbox(piccolo_os_task_t *task, void *buffer, uint32_t message_size, uint32_t message_count);
+int32_t piccolo_send_message(piccolo_os_task_t *toTask, const void *message);
+int32_t piccolo_send_message_blocking(piccolo_os_task_t *toTask, const void *message);
+int32_t piccolo_send_message_blocking_timeout(piccolo_os_task_t *toTask, const void *message, uint32_t timeout_ms);
+int32_t piccolo_get_message(void *message);
+int32_t piccolo_get_message_blocking(void *message);
+int32_t piccolo_get_message_blocking_timeout(void *message, uint32_t timeout_ms);
+
+///@}
+
+/** @name Event Groups
+ * 
+ * An event group holds 32 event flags. Tasks, interrupt service handlers and timer callbacks can set and clear 
+ * the flags, and a task can block until any one, or all, of a set of flags are set, with a timeout. 
+ * One task can then sleep on many sources (each setting its own flag) without polling, and many tasks can wait on
+ * the same group.
+ */
+
+///@{
+
+void piccolo_event_group_init(piccolo_event_group_t *group);
+uint32_t piccolo_event_group_set(piccolo_event_group_t *group, uint32_t bits);
+uint32_t piccolo_event_group_clear(piccolo_event_group_t *group, uint32_t bits);
+uint32_t piccolo_event_group_get(piccolo_event_group_t *group);
+uint32_t piccolo_event_group_wait_any(piccolo_event_group_t *group, uint32_t bits, bool clear, uint32_t timeout_ms);
+uint32_t piccolo_event_group_wait_all(piccolo_event_group_t *group, uint32_t bits, bool clear, uint32_t timeout_ms);
+
+///@}
+
+/** @name Lightweight tasks
+ * 
+ * A lightweight task has no stack of its own, so it costs only its \ref piccolo_lite_task_t. Its function runs 
+ * up to the point where it waits, and returns. When the wait is over the function is called again, and carries
+ * on from where it left off. The lightweight tasks of each core are run one at a time, in turn, by the core's 
+ * runner task, on its stack (\ref PICCOLO_OS_LITE_STACK_SIZE). The runner is scheduled like any other task, 
+ * so the lightweight tasks get the processor at its priority (`piccolo_lite_runner()` gives it, to change that).
+ * 
+ * The function is written between `PICCOLO_LITE_BEGIN()` and `PICCOLO_LITE_END()`, and waits only with the
+ * `PICCOLO_LITE_` macros, directly in its body (not in a function it calls, nor inside a `switch` of its own).
+ * Its local variables are lost at each wait, so anything it needs afterwards belongs in the structure `argument`
+ * points to. A lightweight task has a signal channel: tasks, interrupt service handlers and other lightweight tasks
+ * send it signals with `piccolo_lite_send_signal()`, and it waits for them with `PICCOLO_LITE_WAIT_SIGNAL()`. 
+ * A task which has some other condition to wait for can suspend (`PICCOLO_LITE_SUSPEND()`) until whoever 
+ * changes it calls `piccolo_lite_wake()`. To wait for an SDK lock (a semaphore, say) to be released, it registers
+ * with `piccolo_lite_wait_lock()`, tries the lock once more, and suspends if it is still taken.
+ * 
+ * @code
+ * uint32_t debounce(piccolo_lite_task_t *lite) {
+ *     PICCOLO_LITE_BEGIN(lite);
+ *     while(true) {
+ *         PICCOLO_LITE_WAIT_SIGNAL(lite, 0);          // an edge from the button interrupt
+ *         while(piccolo_lite_get_signal(lite));
+ *         PICCOLO_LITE_SLEEP(lite, 20);
+ *         ((button_t *) lite->argument)->pressed = !gpio_get(BUTTON_PIN);
+ *     }
+ *     PICCOLO_LITE_END(lite);
+ * }
+ * @endcode
+ */
+
+///@{
+
+/** Start of a lightweight task function: carry on from where it last waited **/
+#define PICCOLO_LITE_BEGIN(lite) switch((lite)->resume) { case 0:
+
+/** End of a lightweight task function. Reaching it ends the task. **/
+#define PICCOLO_LITE_END(lite) } (lite)->resume = 0; return PICCOLO_LITE_ENDED
+
+/** Return from the task function waiting on `flags`, to carry on after this when the wait is over. One per line! **/
+#define __PICCOLO_LITE_WAIT(lite, flags) do { (lite)->resume = __LINE__; return (flags); case __LINE__:; } while(0)
+
+/** Let the other lightweight tasks of the core run, then carry on **/
+#define PICCOLO_LITE_YIELD(lite) __PICCOLO_LITE_WAIT(lite, PICCOLO_LITE_READY)
+
+/** Sleep for `ms` milliseconds **/
+#define PICCOLO_LITE_SLEEP(lite, ms) do { (lite)->wakeup.deadline = make_timeout_time_ms(ms); \
+    __PICCOLO_LITE_WAIT(lite, PICCOLO_LITE_SLEEPING); } while(0)
+
+/** Sleep until the absolute time `until` **/
+#define PICCOLO_LITE_SLEEP_UNTIL(lite, until) do { (lite)->wakeup.deadline = (until); \
+    __PICCOLO_LITE_WAIT(lite, PICCOLO_LITE_SLEEPING); } while(0)
+
+/** Wait until `piccolo_lite_wake()` is called (or has been, since the task function was called) **/
+#define PICCOLO_LITE_SUSPEND(lite) __PICCOLO_LITE_WAIT(lite, PICCOLO_LITE_SUSPENDED)
+
+/** Wait until there is a signal to take, or `timeout_ms` milliseconds (0 for no timeout). Takes no signal. **/
+#define PICCOLO_LITE_WAIT_SIGNAL(lite, timeout_ms) do { if(!(lite)->signals) { \
+    if(timeout_ms) (lite)->wakeup.deadline = make_timeout_time_ms(timeout_ms); \
+    __PICCOLO_LITE_WAIT(lite, PICCOLO_LITE_GET_SIGNAL_BLOCKED | ((timeout_ms) ? PICCOLO_LITE_SLEEPING : 0)); } } while(0)
+
+bool piccolo_lite_create(piccolo_lite_task_t *lite, uint32_t (*function)(piccolo_lite_task_t *lite), void *argument);
+bool piccolo_lite_create_on(piccolo_lite_task_t *lite, uint32_t (*function)(piccolo_lite_task_t *lite), void *argument,
+    uint32_t affinity);
+int32_t piccolo_lite_send_signal(piccolo_lite_task_t *lite);
+int32_t piccolo_lite_get_signal(piccolo_lite_task_t *lite);
+void piccolo_lite_wake(piccolo_lite_task_t *lite);
+void piccolo_lite_wait_lock(piccolo_lite_task_t *lite, void *lock);
+piccolo_os_task_t *piccolo_lite_runner(uint core);
+
+///@}
+
+/** @name Software timers
+ * 
+ * A software timer calls a function once a time has passed, once (a one-shot timer) or every period 
+ * (a periodic timer), without a task of its own. The callbacks of all the timers are run by one kernel task,
+ * the timer task, in the order the timers expire, on its stack (\ref PICCOLO_OS_TIMER_STACK_SIZE) and at its
+ * priority (\ref PICCOLO_OS_TIMER_PRIORITY). So a timer costs only its \ref piccolo_timer_t, and thousands of
+ * them cost no more to keep than a few: the running timers are kept in a deadline ordered heap.
+ * 
+ * A periodic timer expires a whole number of periods after it was started, however late its callbacks run,
+ * so it does not drift. If the timer task falls a period or more behind, the expiries it missed are
+ * counted (`missed`) rather than run late, one after another.
+ * 
+ * A callback must not block: it should do a little work, or hand the work on by signalling a task, setting
+ * an event group, or starting and stopping timers. Timers can be started, stopped and reset by tasks, 
+ * lightweight tasks, interrupt service handlers and callbacks (their own timer's, too).
+ * 
+ * @code
+ * void heartbeat(piccolo_timer_t *timer) {
+ *     gpio_xor_mask(1u << LED_PIN);
+ * }
+ * 
+ * piccolo_timer_create(&heartbeat_timer, heartbeat, NULL);
+ * piccolo_timer_start(&heartbeat_timer, 500000, 500000);       // every half second
+ * @endcode
+ */
+
+///@{
+
+bool piccolo_timer_create(piccolo_timer_t *timer, void (*callback)(piccolo_timer_t *timer), void *argument);
+void piccolo_timer_start(piccolo_timer_t *timer, uint32_t delay_us, uint32_t period_us);
+bool piccolo_timer_stop(piccolo_timer_t *timer);
+void piccolo_timer_reset(piccolo_timer_t *timer);
+bool piccolo_timer_active(piccolo_timer_t *timer);
+piccolo_os_task_t *piccolo_timer_task(void);
+
+///@}
+
+/** @name Deferred work
+ * 
+ * An interrupt service handler should do no more than it must with interrupts held off, and hand the rest on. 
+ * `piccolo_work_post()` queues a function, with an argument and up to \ref PICCOLO_OS_WORK_PAYLOAD bytes of data,
+ * for the worker task of the handler's core to run. Posting only disables interrupts for a few instructions 
+ * and takes no spin lock, except to signal the worker when it has run out of work. The worker runs 
+ * everything queued in one go, so a burst of interrupts costs one task switch.
+ * 
+ * Deferred work runs in a task (\ref PICCOLO_OS_WORK_PRIORITY), so it may take locks and send signals, but like
+ * a timer callback it must not block for long: the rest of its core's work waits for it. Work can be posted 
+ * by tasks and timer callbacks too.
+ * 
+ * @code
+ * void uart_line(void *argument, const void *payload) {
+ *     ...                                          // parse the bytes, send a message to the shell task
+ * }
+ * 
+ * void uart_handler(void) {
+ *     uint8_t bytes[PICCOLO_OS_WORK_PAYLOAD];
+ *     uint32_t count = 0;
+ *     while(uart_is_readable(uart0) && count < sizeof(bytes)) bytes[count++] = uart_getc(uart0);
+ *     piccolo_work_post(uart_line, (void *) (uintptr_t) count, bytes, count);
+ * }
+ * @endcode
+ */
+
+///@{
+
+bool piccolo_work_start(void);
+bool piccolo_work_post(void (*function)(void *argument, const void *payload), void *argument, const void *payload,
+    uint32_t size);
+void piccolo_get_work_statistics(uint core, piccolo_os_work_statistics_t *statistics);
+piccolo_os_task_t *piccolo_work_worker(uint core);
+
+///@}
+
+/** @name Statistics
+ * 
+ * Counters kept by the schedulers, to see how the two cores share the work and how much they
+ * get in each other's way, and by the task pools. The stack high water mark of a task shows
+ * how small its stack could be. The task snapshot shows how much of the processors each task takes,
+ * and how long it waits.
+ */
+
+///@{
+
+void piccolo_get_core_statistics(uint core, piccolo_os_core_statistics_t *statistics);
+void piccolo_get_pool_statistics(uint size_class, piccolo_os_pool_statistics_t *statistics);
+uint32_t piccolo_get_stack_high_water(piccolo_os_task_t *task);
+uint32_t piccolo_get_task_info(piccolo_os_task_info_t *info, uint32_t count);
+///@}
+
+/** @name Tracing
+ * 
+ * With \ref PICCOLO_OS_TRACE the schedulers record task switches, blocking, signals, task creation
+ * and idling. The dump is printed on stdio, for `tools/trace_to_json.py` to turn into a Chrome trace.
+ */
+
+///@{
+
+void piccolo_trace_dump(void);
+void piccolo_trace_clear(void);
+
+///@}
+
+/** @name Task pools
+ * 
+ * Task structures and their stacks are kept in pools by stack size. A block taken from the heap for a task 
+ * is never given back to the heap. When the task ends the scheduler returns the block to its pool, where the
+ * next task of that size reuses it. Reserving blocks ahead of time makes task creation independent of the heap.
+ * 
+ * Other small kernel objects of varying size, such as C++ coroutine frames, come from frame pools which work 
+ * the same way: a freed frame goes back to the pool of its size class, never to the heap.
+ */
+
+///@{
+
+uint32_t piccolo_reserve_tasks(uint32_t stack_size, uint32_t count);
+void *piccolo_frame_allocate(uint32_t size);
+void piccolo_frame_free(void *frame, uint32_t size);
+uint32_t piccolo_reserve_frames(uint32_t size, uint32_t count);
+
 ///@}
 /**@}**/
 
@@ -0,0 +1,364 @@
+/**
+ * @file lite_task.c
+ * @brief Piccolo OS lightweight tasks
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * A lightweight task is a function which returns each time it has to wait, saying what for, and is called
+ * again when the wait is over (see the `PICCOLO_LITE_` macros in kernel.h). Each core has a runner task which
+ * keeps a ready list and a timer queue of its lightweight tasks, and calls their functions one at a time on
+ * its own stack. With nothing ready it blocks on its signal channel until the next timeout, and waking a
+ * lightweight task signals it. The lists and the lightweight tasks' signal counts are protected by the
+ * global `piccolo_lock`, as are their waits on SDK locks.
+ */
+
+#include "hardware/sync.h"
+
+#include "kernel.h"
+
+extern piccolo_os_internals_t piccolo_ctx;
+
+/**
+ * @brief Append a lightweight task to its runner's ready list
+ *
+ * @param runner the runner of the task's core
+ * @param lite the task, which is on no list
+ * @return true if the runner is blocked, and must be signalled (after the lock is released)
+ * \ingroup Intern
+ * Called with the global lock held.
+ */
+static bool __piccolo_lite_make_ready(piccolo_os_lite_runner_t *runner, piccolo_lite_task_t *lite) {
+    piccolo_lite_task_t **link;
+    bool wake = runner->waiting;
+
+    if(lite->lock_waiting_on) {
+        // woken by something else (a timeout, say) while waiting on a lock: stop waiting on it
+        for(link = &runner->lock_waiters; *link != lite; link = &(*link)->lock_next);
+        *link = lite->lock_next;
+        lite->lock_waiting_on = NULL;
+    }
+    lite->flags = PICCOLO_LITE_READY;
+    lite->next = NULL;
+    if(runner->ready_tail) runner->ready_tail->next = lite;
+    else runner->ready_head = lite;
+    runner->ready_tail = lite;
+    runner->waiting = false;
+    return wake;
+}
+
+/**
+ * @brief Put a lightweight task which has just returned where what it waits on says
+ *
+ * @param runner the runner of the task's core
+ * @param lite the task
+ * @param flags what its function returned (\ref piccolo_lite_flag_values)
+ * \ingroup Intern
+ * Called with the global lock held. A task waiting for a signal which has already arrived, or suspending when
+ * it has been woken since it was called, is ready at once.
+ */
+static void __piccolo_lite_block(piccolo_os_lite_runner_t *runner, piccolo_lite_task_t *lite, uint32_t flags) {
+    if(flags & PICCOLO_LITE_ENDED) {
+        lite->flags = PICCOLO_LITE_ENDED;
+        runner->count--;
+    }
+    else if(!flags || ((flags & PICCOLO_LITE_GET_SIGNAL_BLOCKED) && lite->signals)
+            || ((flags & PICCOLO_LITE_SUSPENDED) && (lite->flags & PICCOLO_LITE_WOKEN)))
+        __piccolo_lite_make_ready(runner, lite);
+    else {
+        lite->flags = flags;
+        if(flags & PICCOLO_LITE_SLEEPING) piccolo_timer_queue_insert(&runner->timer_queue, &lite->wakeup);
+    }
+}
+
+/**
+ * @brief The runner task of a core: runs its lightweight tasks
+ *
+ * @param argument the core's \ref piccolo_os_lite_runner_t
+ * \ingroup Intern
+ * Wakes the lightweight tasks whose timeouts have passed, then runs the task at the head of the ready list.
+ * With none ready, it blocks on its signal channel, with a timeout at the earliest lightweight task timeout.
+ * It is pinned to its core, and never ends.
+ */
+static void __piccolo_lite_run(void *argument) {
+    piccolo_os_lite_runner_t *runner = (piccolo_os_lite_runner_t *) argument;
+    piccolo_os_task_t *task = piccolo_get_task_id();
+    piccolo_timer_node_t *node;
+    piccolo_lite_task_t *lite;
+    uint32_t lock, flags;
+
+    // Its creator may not have recorded it yet. It must be, before anyone is told to signal it.
+    lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    runner->task = task;
+    spin_unlock(piccolo_ctx.piccolo_lock, lock);
+
+    while(1) {
+        lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+        while((node = piccolo_timer_queue_peek(&runner->timer_queue)) && time_reached(node->deadline)) {
+            piccolo_timer_queue_pop(&runner->timer_queue);
+            __piccolo_lite_make_ready(runner, piccolo_timer_owner(node, piccolo_lite_task_t, wakeup));
+        }
+        lite = runner->ready_head;
+        if(lite) {
+            runner->ready_head = lite->next;
+            if(!lite->next) runner->ready_tail = NULL;
+        }
+        else {
+            // block until a lightweight task is made ready, or the next timeout
+            runner->waiting = true;
+            if(node) task->wakeup.deadline = node->deadline;
+            task->task_flags |= PICCOLO_TASK_GET_SIGNAL_BLOCKED | (node ? PICCOLO_TASK_SLEEPING : 0);
+        }
+        spin_unlock(piccolo_ctx.piccolo_lock, lock);
+
+        if(!lite) {
+            piccolo_yield();
+            piccolo_get_signal_all();
+            continue;
+        }
+        flags = lite->function(lite);
+        lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+        __piccolo_lite_block(runner, lite, flags);
+        spin_unlock(piccolo_ctx.piccolo_lock, lock);
+    }
+}
+
+/**
+ * @brief Make sure a core has a runner task
+ *
+ * @param core the core
+ * @return true if it has one
+ * \ingroup Intern
+ * The runner is created the first time it is needed. If another task is creating it, waits for that.
+ * (Before `piccolo_start()` nothing else can be, so it never has to wait then.)
+ */
+static bool __piccolo_lite_runner_start(uint core) {
+    piccolo_os_lite_runner_t *runner = &piccolo_ctx.lite_runner[core];
+    piccolo_os_task_t *task;
+    uint32_t lock;
+
+    while(1) {
+        lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+        task = runner->task;
+        if(!task) runner->task = (piccolo_os_task_t *) 1;    // ours to create
+        spin_unlock(piccolo_ctx.piccolo_lock, lock);
+        if((uintptr_t) task > 1) return true;
+        if(!task) break;
+        piccolo_sleep(1);   // not yield, which would not let a creator of lower priority finish
+    }
+    task = piccolo_create_task_on(__piccolo_lite_run, runner, PICCOLO_OS_LITE_STACK_SIZE, "lite", 1u << core);
+    lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    runner->task = task;
+    spin_unlock(piccolo_ctx.piccolo_lock, lock);
+    return task != NULL;
+}
+
+/**
+ * @brief Start a lightweight task which may only run on the given cores
+ *
+ * @param lite the task structure, which must stay put until the task has ended
+ * @param function the task function, written with the `PICCOLO_LITE_` macros
+ * @param argument for the task function, as `lite->argument`
+ * @param affinity the cores the task may run on (\ref piccolo_os_affinity). It runs on the one with
+ * fewer lightweight tasks.
+ * @return true if the task was started, false if there is no room for a runner task, or no core which runs tasks
+ *
+ * Call from a task, or before `piccolo_start()`.
+ */
+bool piccolo_lite_create_on(piccolo_lite_task_t *lite, uint32_t (*function)(piccolo_lite_task_t *lite), void *argument,
+                            uint32_t affinity) {
+    piccolo_os_lite_runner_t *runner;
+    uint32_t lock;
+    uint core = 0;
+    bool wake;
+
+    affinity &= PICCOLO_OS_MULTICORE ? PICCOLO_AFFINITY_ANY : PICCOLO_AFFINITY_CORE0;
+    if(!affinity) return false;
+    if(affinity == PICCOLO_AFFINITY_CORE1
+       || (affinity == PICCOLO_AFFINITY_ANY && piccolo_ctx.lite_runner[1].count < piccolo_ctx.lite_runner[0].count))
+        core = 1;
+    if(!__piccolo_lite_runner_start(core)) return false;
+
+    runner = &piccolo_ctx.lite_runner[core];
+    lite->function = function;
+    lite->argument = argument;
+    lite->resume = 0;
+    lite->core = core;
+    lite->signals = 0;
+    lite->lock_waiting_on = NULL;
+    lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    runner->count++;
+    wake = __piccolo_lite_make_ready(runner, lite);
+    spin_unlock(piccolo_ctx.piccolo_lock, lock);
+    if(wake) piccolo_send_signal(runner->task);
+    return true;
+}
+
+/**
+ * @brief Start a lightweight task
+ *
+ * @param lite the task structure, which must stay put until the task has ended
+ * @param function the task function, written with the `PICCOLO_LITE_` macros
+ * @param argument for the task function, as `lite->argument`
+ * @return true if the task was started, false if there is no room for a runner task
+ *
+ * As `piccolo_lite_create_on()`, on either core.
+ */
+bool piccolo_lite_create(piccolo_lite_task_t *lite, uint32_t (*function)(piccolo_lite_task_t *lite), void *argument) {
+    return piccolo_lite_create_on(lite, function, argument, PICCOLO_AFFINITY_ANY);
+}
+
+/**
+ * @brief Send a signal to a lightweight task
+ *
+ * @param lite the task
+ * @return 1 if the signal was sent, <0 if there is no room (the channel holds \ref PICCOLO_OS_MAX_SIGNAL - 1,
+ * like a task's), or the task has ended
+ *
+ * A task waiting for a signal is made ready. Safe to call from tasks, lightweight tasks, interrupt service
+ * handlers and timer callbacks.
+ */
+int32_t piccolo_lite_send_signal(piccolo_lite_task_t *lite) {
+    piccolo_os_lite_runner_t *runner = &piccolo_ctx.lite_runner[lite->core];
+    uint32_t lock;
+    bool wake = false;
+    int32_t result = 1;
+
+    lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    if((lite->flags & PICCOLO_LITE_ENDED) || lite->signals >= PICCOLO_OS_MAX_SIGNAL - 1) result = -1;
+    else {
+        lite->signals++;
+        if(lite->flags & PICCOLO_LITE_GET_SIGNAL_BLOCKED) {
+            if(lite->flags & PICCOLO_LITE_SLEEPING) piccolo_timer_queue_remove(&runner->timer_queue, &lite->wakeup);
+            wake = __piccolo_lite_make_ready(runner, lite);
+        }
+    }
+    spin_unlock(piccolo_ctx.piccolo_lock, lock);
+    if(wake) piccolo_send_signal(runner->task);
+    return result;
+}
+
+/**
+ * @brief Make a lightweight task ready, whatever it waits on
+ *
+ * @param lite the task
+ *
+ * A blocked task is made ready (and finds no signal, if it was waiting for one). A task which is ready or running 
+ * is left alone, except that the next time it suspends (`PICCOLO_LITE_SUSPEND()`) it carries on at once. 
+ * Safe to call from tasks, lightweight tasks, interrupt service handlers and timer callbacks.
+ */
+void piccolo_lite_wake(piccolo_lite_task_t *lite) {
+    piccolo_os_lite_runner_t *runner = &piccolo_ctx.lite_runner[lite->core];
+    uint32_t lock;
+    bool wake = false;
+
+    lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    if(lite->flags & (PICCOLO_LITE_SLEEPING | PICCOLO_LITE_GET_SIGNAL_BLOCKED | PICCOLO_LITE_SUSPENDED)) {
+        if(lite->flags & PICCOLO_LITE_SLEEPING) piccolo_timer_queue_remove(&runner->timer_queue, &lite->wakeup);
+        wake = __piccolo_lite_make_ready(runner, lite);
+    }
+    else if(!(lite->flags & PICCOLO_LITE_ENDED)) lite->flags |= PICCOLO_LITE_WOKEN;
+    spin_unlock(piccolo_ctx.piccolo_lock, lock);
+    if(wake) piccolo_send_signal(runner->task);
+}
+
+/**
+ * @brief Have a lightweight task wait on an SDK lock
+ *
+ * @param lite the task, which calls this from its task function
+ * @param lock the lock (`lock_core_t`, such as `&semaphore->core`), or NULL to stop waiting
+ *
+ * When the lock is next released the task is woken, as by `piccolo_lite_wake()`, and stops waiting on it. So
+ * the task registers first, then tries the lock, and if it is still taken suspends (`PICCOLO_LITE_SUSPEND()`,
+ * with `PICCOLO_LITE_SLEEPING` for a timeout). A release in between makes it carry on at once. Being made
+ * ready by anything else (the timeout) also ends the wait.
+ */
+void piccolo_lite_wait_lock(piccolo_lite_task_t *lite, void *lock) {
+    piccolo_os_lite_runner_t *runner = &piccolo_ctx.lite_runner[lite->core];
+    piccolo_lite_task_t **link;
+    uint32_t lock_value;
+
+    lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    if(lite->lock_waiting_on) {
+        for(link = &runner->lock_waiters; *link != lite; link = &(*link)->lock_next);
+        *link = lite->lock_next;
+    }
+    lite->lock_waiting_on = lock;
+    if(lock) {
+        lite->lock_next = runner->lock_waiters;
+        runner->lock_waiters = lite;
+    }
+    spin_unlock(piccolo_ctx.piccolo_lock, lock_value);
+}
+
+/**
+ * @brief Wake the lightweight tasks waiting on an SDK lock
+ *
+ * @param lock the lock (`lock_core_t`) which was released
+ * \ingroup Intern
+ * Called by `piccolo_lock_notify()` when some runner has lock waiters. Suspended tasks are made ready, and
+ * running ones carry on when they suspend.
+ */
+void __piccolo_lite_lock_notify(void *lock) {
+    piccolo_os_lite_runner_t *runner;
+    piccolo_lite_task_t **link, *lite;
+    uint32_t lock_value;
+    bool wake[2] = {false, false};
+
+    lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    for(uint core = 0; core < 2; core++) {
+        runner = &piccolo_ctx.lite_runner[core];
+        for(link = &runner->lock_waiters; (lite = *link);) {
+            if(lite->lock_waiting_on != lock) {
+                link = &lite->lock_next;
+                continue;
+            }
+            *link = lite->lock_next;
+            lite->lock_waiting_on = NULL;
+            if(lite->flags & PICCOLO_LITE_SUSPENDED) {
+                if(lite->flags & PICCOLO_LITE_SLEEPING) piccolo_timer_queue_remove(&runner->timer_queue, &lite->wakeup);
+                wake[core] |= __piccolo_lite_make_ready(runner, lite);
+            }
+            else lite->flags |= PICCOLO_LITE_WOKEN;
+        }
+    }
+    spin_unlock(piccolo_ctx.piccolo_lock, lock_value);
+    for(uint core = 0; core < 2; core++)
+        if(wake[core]) piccolo_send_signal(piccolo_ctx.lite_runner[core].task);
+}
+
+/**
+ * @brief Take a signal sent to a lightweight task, if there is one
+ *
+ * @param lite the task, which calls this from its task function
+ * @return 1 if a signal was taken, 0 if there was none
+ */
+int32_t piccolo_lite_get_signal(piccolo_lite_task_t *lite) {
+    uint32_t lock;
+    int32_t result = 0;
+
+    if(!lite->signals) return 0;
+    lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    if(lite->signals) {
+        lite->signals--;
+        result = 1;
+    }
+    spin_unlock(piccolo_ctx.piccolo_lock, lock);
+    return result;
+}
+
+/**
+ * @brief Get the runner task of a core
+ *
+ * @param core the core (0 or 1)
+ * @return piccolo_os_task_t* the task which runs the core's lightweight tasks, or NULL if there is none yet
+ *
+ * Its priority is the priority of the lightweight tasks, and its stack high water mark shows how much of
+ * \ref PICCOLO_OS_LITE_STACK_SIZE they use.
+ */
+piccolo_os_task_t *piccolo_lite_runner(uint core) {
+    piccolo_os_task_t *task = piccolo_ctx.lite_runner[core & 1].task;
+
+    return (uintptr_t) task > 1 ? task : NULL;
+}
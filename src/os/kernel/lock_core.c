@@ -11,6 +11,7 @@
  */
 
 #include "kernel.h"
+#include "run_queue.h"
 
 extern piccolo_os_internals_t piccolo_ctx;
 
@@ -25,9 +26,13 @@ extern piccolo_os_internals_t piccolo_ctx;
  */
 
 __force_inline static uint32_t get_interrupts_disabled(void) {
+#if PICCOLO_OS_HOST
+    return __piccolo_host_interrupts_disabled();
+#else
     uint32_t status;
     __asm volatile ("mrs %0, PRIMASK" : "=r" (status)::);
     return status;
+#endif
 }
 
 
@@ -54,38 +59,147 @@ lock_owner_id_t __time_critical_func(piccolo_lock_get_owner_id)(){
 }
 
 /**
- * @brief If a valid task is running, yield. Then return
+ * @brief Check whether the caller is a task which can block
  * 
- * Remember the SDK caller checks anyway, so if we don't have a valid task running
- * we will just return (and we will spin in a loop with the SDK).
+ * @param save the interrupt status from when the lock's spin lock was taken
+ * @return piccolo_os_task_t* the running task, or NULL if the caller must not block
  * 
+ * Only a task running in thread mode, which had interrupts enabled when it took the spin lock, 
+ * can block. When no task is running (before `piccolo_start()`, or in the scheduler and the idle task)
+ * the running "task" is the core number.
+ * @note Interrupts are disabled, so we cannot be moved to the other core.
  */
-void __time_critical_func(piccolo_lock_wait)(void) {
-    if(piccolo_lock_get_owner_id()>1 && !get_interrupts_disabled()) piccolo_yield();
+static piccolo_os_task_t *__piccolo_lock_blockable_task(uint32_t save) {
+    piccolo_os_task_t *task = (piccolo_os_task_t *) piccolo_ctx.this_task[get_core_num()];
+
+    if((uintptr_t) task <= 1 || (save & 1) || __get_current_exception()) return NULL;
+    return task;
+}
+
+/**
+ * @brief Mark the running task as waiting on a lock, before the lock's spin lock is unlocked
+ * 
+ * @param lock the lock (`lock_core_t`)
+ * @param save the interrupt status from when the lock's spin lock was taken
+ * @return true if the task will block, and should call `piccolo_lock_wait()` after unlocking
+ * 
+ * Called with the lock's spin lock held. Marking the task first means a `piccolo_lock_notify()`
+ * for the lock, which can only start once the spin lock is free, will see the task waiting.
+ */
+bool __time_critical_func(piccolo_lock_prepare_wait)(void *lock, uint32_t save) {
+    piccolo_os_task_t *task = __piccolo_lock_blockable_task(save);
+
+    if(!task) return false;
+    task->lock_waiting_on = lock;
+    task->task_flags |= PICCOLO_TASK_LOCK_BLOCKED;
+    return true;
+}
+
+/**
+ * @brief Mark the running task as waiting on a lock with a timeout, before the lock's spin lock is unlocked
+ * 
+ * @param lock the lock (`lock_core_t`)
+ * @param save the interrupt status from when the lock's spin lock was taken
+ * @param timeout_timestamp when to give up waiting
+ * @return true if the task will block, and should call `piccolo_lock_wait_until()` after unlocking
+ */
+bool __time_critical_func(piccolo_lock_prepare_wait_until)(void *lock, uint32_t save, absolute_time_t timeout_timestamp) {
+    piccolo_os_task_t *task = __piccolo_lock_blockable_task(save);
+
+    if(!task || time_reached(timeout_timestamp)) return false;
+    task->lock_waiting_on = lock;
+    task->wakeup.deadline = timeout_timestamp;
+    task->task_flags |= PICCOLO_TASK_LOCK_BLOCKED | PICCOLO_TASK_SLEEPING;
+    return true;
+}
+
+/**
+ * @brief Block on the lock the task was marked as waiting on
+ * 
+ * @param blocking the result of `piccolo_lock_prepare_wait()`
+ * 
+ * The scheduler puts the task on the lock's wait queue, where it costs nothing until the lock
+ * is released. If the caller is not a task which can block (the idle task, for example), wait
+ * for an event as the SDK does.
+ */
+void __time_critical_func(piccolo_lock_wait)(bool blocking) {
+    if(blocking) piccolo_yield();
+    else __wfe();
     return;
 }
 
 /**
- * @brief If a valid task is running, yield. Then return the timeout status.
+ * @brief Block on the lock the task was marked as waiting on, until it is released or the timeout expires
  * 
- * @param timeout_timestamp 
+ * @param blocking the result of `piccolo_lock_prepare_wait_until()`
+ * @param timeout_timestamp when to give up waiting
  * @return true if the timeout has expired
  * @return false if the timeout has not expired
  * 
  * The SDK caller will keep trying to acquire the lock until it succeeds or the timeout expires. 
- * We will yield if a valid task is running until one or the other occurs.
+ * If the caller is not a task which can block, wait for an event or the timeout as the SDK does.
  */
-bool __time_critical_func(piccolo_lock_wait_until)(absolute_time_t timeout_timestamp){
-    if(piccolo_lock_get_owner_id()>1 && !get_interrupts_disabled()) piccolo_yield();
+bool __time_critical_func(piccolo_lock_wait_until)(bool blocking, absolute_time_t timeout_timestamp){
+    if(!blocking) return best_effort_wfe_or_timeout(timeout_timestamp);
+    piccolo_yield();
     return time_reached(timeout_timestamp);
 }
 
 /**
- * @brief Default idle routine for the lock system. If a valid task is running, yield. Then return.
+ * @brief Wake every task waiting on a lock
+ * 
+ * @param lock the lock (`lock_core_t`) which was released
+ * 
+ * Looks through the lock's wait queue on each core, and makes the tasks waiting on this lock ready.
+ * A task may have been marked as waiting but not have yielded yet. It is still running, so just
+ * clearing its flags is enough to keep it from blocking. Both are done under the run queue lock 
+ * of the task's core, which the scheduler holds when it blocks a task.
+ * The SDK caller checks the lock again when it wakes, so waking too many tasks does no harm.
+ * Tasks waiting on the lock may be moved between cores meanwhile, but are woken when they arrive
+ * (see \ref piccolo_run_queue_attach). Lightweight tasks waiting on the lock (`piccolo_lite_wait_lock()`)
+ * are woken too.
+ * 
+ * @note May be called from interrupt service handlers.
+ */
+void __time_critical_func(piccolo_lock_notify)(void *lock) {
+    piccolo_os_run_queue_t *run_queue;
+    piccolo_os_task_queue_t *queue;
+    piccolo_os_task_t *task, *next_task;
+    uint32_t lock_value;
+
+    for(uint core = 0; core < 2; core++) {
+        run_queue = &piccolo_ctx.run_queue[core];
+        queue = piccolo_run_queue_lock_waiters(run_queue, lock);
+        // Don't take the run queue lock if nobody on this core can be waiting. The running task first: the
+        // scheduler queues a waiter before it replaces the running task, so one read between the two is seen.
+        task = (piccolo_os_task_t *) piccolo_ctx.this_task[core];
+        __dmb();
+        if(!queue->head && ((uintptr_t) task <= 1 || !(task->task_flags & PICCOLO_TASK_LOCK_BLOCKED))) continue;
+
+        lock_value = piccolo_run_queue_lock(run_queue);
+        for(task = queue->head; task; task = next_task) {
+            next_task = task->queue_next;
+            if(task->lock_waiting_on == lock) piccolo_run_queue_wake(run_queue, task);
+        }
+        task = (piccolo_os_task_t *) piccolo_ctx.this_task[core];
+        if((uintptr_t) task > 1 && task->core == core && (task->task_flags & PICCOLO_TASK_RUNNING)
+                && (task->task_flags & PICCOLO_TASK_LOCK_BLOCKED) && task->lock_waiting_on == lock)
+            task->task_flags &= ~(PICCOLO_TASK_LOCK_BLOCKED | PICCOLO_TASK_SLEEPING);
+        piccolo_run_queue_unlock(run_queue, lock_value);
+    }
+    __dmb();    // the release before the look at the lightweight lock waiters, which register before trying the lock
+    if(piccolo_ctx.lite_runner[0].lock_waiters || piccolo_ctx.lite_runner[1].lock_waiters)
+        __piccolo_lite_lock_notify(lock);
+    __sev();    // wake an idle core a task was made ready on, and any caller waiting for an event, as the SDK does
+}
+
+/**
+ * @brief Default idle routine for the lock system. If a valid task is running, sleep until the requested time.
  * 
+ * @param until when the caller has something to do again
  */
-void __time_critical_func(piccolo_lock_yield)(void) {
-    if(piccolo_lock_get_owner_id()>1 && !get_interrupts_disabled()) piccolo_yield();
+void __time_critical_func(piccolo_lock_yield_until)(absolute_time_t until) {
+    if(piccolo_lock_get_owner_id()>1 && !get_interrupts_disabled() && !__get_current_exception()) piccolo_sleep_until(until);
     return;
 }
 
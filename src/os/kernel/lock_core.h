@@ -34,7 +34,7 @@
  * 
  * **For Piccolo OS, it will hold a task identifier (core number or task structure address)**
  */
-#define lock_owner_id_t int32_t
+#define lock_owner_id_t intptr_t
 #endif
 #ifndef LOCK_INVALID_OWNER_ID
 /*! \brief  marker value to use for a lock_owner_id_t which does not refer to any valid owner
@@ -52,9 +52,12 @@ extern "C" {
 #endif
 
 lock_owner_id_t piccolo_lock_get_owner_id();
-void piccolo_lock_wait();
-bool piccolo_lock_wait_until(absolute_time_t timeout_timestamp);
-void piccolo_lock_yield();
+bool piccolo_lock_prepare_wait(void *lock, uint32_t save);
+bool piccolo_lock_prepare_wait_until(void *lock, uint32_t save, absolute_time_t timeout_timestamp);
+void piccolo_lock_wait(bool blocking);
+bool piccolo_lock_wait_until(bool blocking, absolute_time_t timeout_timestamp);
+void piccolo_lock_notify(void *lock);
+void piccolo_lock_yield_until(absolute_time_t until);
 
 #ifdef __cplusplus
 }
@@ -105,7 +108,8 @@ void piccolo_lock_yield();
  * By default this macro simply unlocks the spin lock, and then performs a WFE, but may be overridden
  * (e.g. to actually block the RTOS task).
  * 
- * **For Piccolo OS, if a valid task is running, yield. Then return.**
+ * **For Piccolo OS, if a valid task is running, it is marked as waiting on the lock before the spin lock is unlocked,
+ * and then blocks on the lock's wait queue until `lock_internal_spin_unlock_with_notify` wakes it. Otherwise just return.**
  *
  * \param lock the lock_core for the primitive which needs to block
  * \param save the uint32_t value that should be passed to spin_unlock when the spin lock is unlocked. (i.e. the `PRIMASK`
@@ -113,7 +117,33 @@ void piccolo_lock_yield();
  */
 
 
-#define lock_internal_spin_unlock_with_wait(lock, save) ({spin_unlock((lock)->spin_lock, save);piccolo_lock_wait();})
+#define lock_internal_spin_unlock_with_wait(lock, save) ({ \
+    bool piccolo_blocking = piccolo_lock_prepare_wait(lock, save);                          \
+    spin_unlock((lock)->spin_lock, save); piccolo_lock_wait(piccolo_blocking);              \
+})
+#endif
+
+#ifndef lock_internal_spin_unlock_with_notify
+/*! \brief   Atomically unlock the lock's spin lock, and send a notification
+ *  \ingroup lock_core
+ *
+ * _Atomic_ here refers to the fact that it should not be possible for this notification to happen during a
+ * lock_internal_spin_unlock_with_wait in a way that that wait does not see the notification (i.e. causing
+ * a missed notification). In other words this method should always wake up any lock_internal_spin_unlock_with_wait
+ * which started before this call completes.
+ *
+ * By default this macro simply unlocks the spin lock, and then performs a SEV, but may be overridden
+ * (e.g. to actually un-block RTOS task(s)).
+ * 
+ * **For Piccolo OS, make every task waiting on the lock ready to run.**
+ *
+ * \param lock the lock_core for the primitive which needs to block
+ * \param save the uint32_t value that should be passed to spin_unlock when the spin lock is unlocked. (i.e. the PRIMASK
+ *             state when the spin lock was acquire)
+ */
+#define lock_internal_spin_unlock_with_notify(lock, save) ({ \
+    spin_unlock((lock)->spin_lock, save); piccolo_lock_notify(lock);                        \
+})
 #endif
 
 #ifndef lock_internal_spin_unlock_with_best_effort_wait_or_timeout
@@ -133,7 +163,8 @@ void piccolo_lock_yield();
  * By default this simply unlocks the spin lock, and then calls  best_effort_wfe_or_timeout
  * but may be overridden (e.g. to actually block the RTOS task with a timeout).
  *
- *  **For Piccolo OS, if a valid task is running, yield. Then return the timeout status.**
+ *  **For Piccolo OS, if a valid task is running, block it on the lock's wait queue with a timeout, as for
+ *  `lock_internal_spin_unlock_with_wait`. Then return the timeout status.**
  * 
  * \param lock the lock_core for the primitive which needs to block
  * \param save the uint32_t value that should be passed to spin_unlock when the spin lock is unlocked. (i.e. the PRIMASK
@@ -142,7 +173,8 @@ void piccolo_lock_yield();
  * \return true if the timeout has been reached
  */
 #define lock_internal_spin_unlock_with_best_effort_wait_or_timeout(lock, save, until) ({ \
-    spin_unlock((lock)->spin_lock,save); piccolo_lock_wait_until(until);                       \
+    bool piccolo_blocking = piccolo_lock_prepare_wait_until(lock, save, until);             \
+    spin_unlock((lock)->spin_lock,save); piccolo_lock_wait_until(piccolo_blocking, until);  \
 })
 #endif
 
@@ -157,12 +189,12 @@ void piccolo_lock_yield();
  * RTOS which is able to block the current task until the scheduler tick before
  * the given time)
  * 
- * **For Piccolo OS, if a valid task is running, yield. Then return.**
+ * **For Piccolo OS, if a valid task is running, sleep until the requested time. Then return.**
  *
  * \param until the absolute_time_t value
  * 
  */
-#define sync_internal_yield_until_before(until) (piccolo_lock_yield();)
+#define sync_internal_yield_until_before(until) piccolo_lock_yield_until(until)
 #endif
 
 /**@}**/
@@ -0,0 +1,111 @@
+/**
+ * @file mailbox.c
+ * @brief Piccolo OS task mailboxes
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * A mailbox adds a message slot to each position of a task's signal channel ring.
+ * The sender fills the slot for the signal before it makes the signal visible, and the
+ * receiver empties it before it frees the position, so the signal channel's own
+ * synchronization covers the message too.
+ */
+
+#include <string.h>
+#include "hardware/sync.h"
+
+#include "kernel.h"
+#include "run_queue.h"
+
+extern piccolo_os_internals_t piccolo_ctx;
+
+/**
+ * @brief Give a task a mailbox
+ *
+ * @param task the task which will receive the messages
+ * @param buffer space for the messages, of \ref PICCOLO_MAILBOX_BUFFER_SIZE(message_size, message_count) bytes.
+ * It belongs to the task until the task ends.
+ * @param message_size size of each message in bytes
+ * @param message_count maximum number of messages waiting in the mailbox
+ *
+ * The task's signal channel is emptied and resized to hold `message_count` signals. From then on every
+ * signal sent to the task carries a message (a plain signal carries zeroes). Set the mailbox up before
+ * anything sends to the task, usually just after creating it.
+ */
+void piccolo_set_mailbox(piccolo_os_task_t *task, void *buffer, uint32_t message_size, uint32_t message_count) {
+    uint32_t lock = spin_lock_blocking(piccolo_signal_lock(task));
+
+    task->mailbox = (uint8_t *) buffer;
+    task->message_size = message_size;
+    task->signal_limit = message_count + 1;
+    task->signal_in = task->signal_out = 0;
+    spin_unlock(piccolo_signal_lock(task), lock);
+}
+
+/**
+ * @brief Send a message to the specified task
+ *
+ * @param toTask pointer to task to send to
+ * @param message the message to copy into the task's mailbox
+ * @return 1 if message sent. <0 if no room (-2 if the task has no mailbox)
+ *
+ * Safe to call from interrupt service handlers and timer callbacks.
+ */
+int32_t piccolo_send_message(piccolo_os_task_t *toTask, const void *message) {
+    return __piccolo_send_signal(toTask, false, 0, message);
+}
+
+/**
+ * @brief Send a message to the specified task. If the mailbox is full, block until it is not.
+ *
+ * @param toTask pointer to task to send to
+ * @param message the message to copy into the task's mailbox
+ * @return 1 to indicate success (-2 if the task has no mailbox)
+ */
+int32_t piccolo_send_message_blocking(piccolo_os_task_t *toTask, const void *message) {
+    return __piccolo_send_signal(toTask, true, 0, message);
+}
+
+/**
+ * @brief Send a message to the specified task. If the mailbox is full, block with a timeout until it is not.
+ *
+ * @param toTask pointer to task to send to
+ * @param message the message to copy into the task's mailbox
+ * @param timeout_ms maximum time in ms to wait if the mailbox is full.
+ * @return 1 if message sent. <0 if a timeout occurred (-2 if the task has no mailbox)
+ */
+int32_t piccolo_send_message_blocking_timeout(piccolo_os_task_t *toTask, const void *message, uint32_t timeout_ms) {
+    return __piccolo_send_signal(toTask, true, timeout_ms, message);
+}
+
+/**
+ * @brief Attempt to get a message from the current task's mailbox
+ *
+ * @param message where to copy the message
+ * @return 1 if a message was received, 0 if none were waiting (-2 if the task has no mailbox)
+ */
+int32_t piccolo_get_message(void *message) {
+    return __piccolo_get_signal(false, 0, false, message);
+}
+
+/**
+ * @brief Get a message from the current task's mailbox. If none are waiting, block until one arrives.
+ *
+ * @param message where to copy the message
+ * @return 1 for the message received (-2 if the task has no mailbox)
+ */
+int32_t piccolo_get_message_blocking(void *message) {
+    return __piccolo_get_signal(true, 0, false, message);
+}
+
+/**
+ * @brief Get a message from the current task's mailbox. If none are waiting, block with a timeout until one arrives.
+ *
+ * @param message where to copy the message
+ * @param timeout_ms maximum time in ms to wait for a message
+ * @return 1 if a message was received, 0 if a timeout occurred (-2 if the task has no mailbox)
+ */
+int32_t piccolo_get_message_blocking_timeout(void *message, uint32_t timeout_ms) {
+    return __piccolo_get_signal(true, timeout_ms, false, message);
+}
@@ -0,0 +1,484 @@
+/**
+ * @file run_queue.h
+ * @brief Piccolo OS per core run queue operations
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Inline helpers used by the kernel to move tasks between the ready, blocked and timer
+ * queues of a core's run queue. Except for the lock functions themselves, all of them
+ * must be called with the run queue lock held.
+ */
+
+#ifndef PICCOLO_RUN_QUEUE_H
+#define PICCOLO_RUN_QUEUE_H
+
+#include "hardware/timer.h"
+#include "kernel.h"
+
+extern piccolo_os_internals_t piccolo_ctx;
+
+/** @defgroup Intern The Piccolo Plus Internals
+ *
+ * @{
+ */
+
+/**
+ * @brief Take a run queue lock, keeping the lock statistics
+ *
+ * @param run_queue the run queue to lock
+ * @return uint32_t the interrupt status to pass to \ref piccolo_run_queue_unlock
+ */
+__force_inline static uint32_t piccolo_run_queue_lock(piccolo_os_run_queue_t *run_queue) {
+    bool contended = is_spin_locked(run_queue->lock);
+    uint32_t lock_value = spin_lock_blocking(run_queue->lock);
+
+    run_queue->statistics.lock_acquisitions++;
+    if(contended) run_queue->statistics.lock_contended++;
+#if PICCOLO_OS_LOCK_STATISTICS
+    run_queue->lock_taken_at = time_us_32();
+#endif
+    return lock_value;
+}
+
+/**
+ * @brief Release a run queue lock, keeping the lock statistics
+ *
+ * @param run_queue the run queue to unlock
+ * @param lock_value the interrupt status returned by \ref piccolo_run_queue_lock
+ */
+__force_inline static void piccolo_run_queue_unlock(piccolo_os_run_queue_t *run_queue, uint32_t lock_value) {
+#if PICCOLO_OS_LOCK_STATISTICS
+    run_queue->statistics.lock_hold_us += time_us_32() - run_queue->lock_taken_at;
+#endif
+    spin_unlock(run_queue->lock, lock_value);
+}
+
+/**
+ * @brief Append a task to the tail of a task queue
+ *
+ * @param queue the queue to append to
+ * @param task the task to append
+ */
+__force_inline static void piccolo_task_queue_append(piccolo_os_task_queue_t *queue, piccolo_os_task_t *task) {
+    task->queue_next = NULL;
+    task->queue_prev = queue->tail;
+    if(queue->tail) queue->tail->queue_next = task;
+    else queue->head = task;
+    queue->tail = task;
+}
+
+/**
+ * @brief Remove a task from anywhere in a task queue
+ *
+ * @param queue the queue the task is on
+ * @param task the task to remove
+ */
+__force_inline static void piccolo_task_queue_remove(piccolo_os_task_queue_t *queue, piccolo_os_task_t *task) {
+    if(task->queue_prev) task->queue_prev->queue_next = task->queue_next;
+    else queue->head = task->queue_next;
+    if(task->queue_next) task->queue_next->queue_prev = task->queue_prev;
+    else queue->tail = task->queue_prev;
+}
+
+/**
+ * @brief Put a task on the head of a task queue
+ *
+ * @param queue the queue to push onto
+ * @param task the task to push
+ */
+__force_inline static void piccolo_task_queue_push(piccolo_os_task_queue_t *queue, piccolo_os_task_t *task) {
+    task->queue_prev = NULL;
+    task->queue_next = queue->head;
+    if(queue->head) queue->head->queue_prev = task;
+    else queue->tail = task;
+    queue->head = task;
+}
+
+/**
+ * @brief Which core a run queue belongs to
+ *
+ * @param run_queue the run queue
+ * @return uint the core number
+ */
+__force_inline static uint piccolo_run_queue_core(piccolo_os_run_queue_t *run_queue) {
+    return run_queue - piccolo_ctx.run_queue;
+}
+
+/**
+ * @brief The cores which run tasks
+ *
+ * @return uint32_t a \ref piccolo_os_affinity mask of them
+ */
+__force_inline static uint32_t piccolo_cores(void) {
+    return PICCOLO_OS_MULTICORE ? PICCOLO_AFFINITY_ANY : PICCOLO_AFFINITY_CORE0;
+}
+
+/**
+ * @brief Check a task's affinity
+ *
+ * @param task the task
+ * @param core a core
+ * @return true if the task may run on the core
+ */
+__force_inline static bool piccolo_task_can_run_on(piccolo_os_task_t *task, uint core) {
+    return (task->affinity >> core) & 1;
+}
+
+/**
+ * @brief Check whether one task should run before another
+ *
+ * @param task a task
+ * @param other another task
+ * @return true if `task` is an EDF job within budget and `other` is not, or both are and `task` has the 
+ * earlier deadline, or neither is and `task` has higher priority
+ */
+__force_inline static bool piccolo_task_before(piccolo_os_task_t *task, piccolo_os_task_t *other) {
+    if(task->edf.scheduled != other->edf.scheduled) return task->edf.scheduled;
+    if(task->edf.scheduled)
+        return to_us_since_boot(task->edf.node.deadline) < to_us_since_boot(other->edf.node.deadline);
+    return task->priority > other->priority;
+}
+
+/**
+ * @brief Preempt the task running on this core for a task which should run before it
+ *
+ * @param run_queue the run queue a task has just been made ready on
+ * @param task that task
+ *
+ * If the task running on the run queue's core should give way (\ref piccolo_task_before), and that core is this 
+ * one, PendSV is pended. It is taken as soon as interrupts are enabled: at once if the running task made the task
+ * ready, or when the interrupt handler which did returns. A task made ready by the other core waits for the next tick.
+ * (Without \ref PICCOLO_OS_FAST_SWITCH, always the next tick.)
+ */
+__force_inline static void piccolo_run_queue_preempt(piccolo_os_run_queue_t *run_queue, piccolo_os_task_t *task) {
+#if PICCOLO_OS_FAST_SWITCH
+    uint core = piccolo_run_queue_core(run_queue);
+    piccolo_os_task_t *running = (piccolo_os_task_t *) piccolo_ctx.this_task[core];
+
+    if(core == get_core_num() && (uintptr_t) running > 1 && (running->task_flags & PICCOLO_TASK_RUNNING)
+            && piccolo_task_before(task, running)) {
+        run_queue->preempt = true;
+        hw_set_bits((io_rw_32 *)(PPB_BASE + M0PLUS_ICSR_OFFSET), M0PLUS_ICSR_PENDSVSET_BITS);
+    }
+#endif
+}
+
+/**
+ * @brief Count a task just put on a ready queue
+ *
+ * @param run_queue the run queue of the task's core
+ * @param task the task
+ *
+ * Tasks which may run on the other core too are counted, so an idle core knows whether there is
+ * anything here it could take.
+ */
+__force_inline static void piccolo_run_queue_count_ready(piccolo_os_run_queue_t *run_queue, piccolo_os_task_t *task) {
+    task->ready_at = time_us_32();
+    if(piccolo_task_can_run_on(task, piccolo_run_queue_core(run_queue) ^ 1)) run_queue->stealable_count++;
+    if(++run_queue->ready_count > 1) __sev();  // more than we can run. An idle core can take one.
+}
+
+/**
+ * @brief Put a task on the tail of the ready queue for its priority, with a new time slice
+ *
+ * @param run_queue the run queue of the task's core
+ * @param task the task which is ready to run
+ *
+ * An EDF job within budget goes on the EDF queue instead, by its deadline. If the task should run before
+ * the one running, that one is preempted.
+ */
+__force_inline static void piccolo_run_queue_make_ready(piccolo_os_run_queue_t *run_queue, piccolo_os_task_t *task) {
+    if(task->edf.scheduled) piccolo_timer_queue_insert(&run_queue->edf_queue, &task->edf.node);
+    else {
+        piccolo_task_queue_append(&run_queue->ready_queue[task->priority], task);
+        run_queue->ready_bitmap |= 1u << task->priority;
+    }
+    task->slice_left = piccolo_ctx.time_slice[task->priority];
+    piccolo_run_queue_count_ready(run_queue, task);
+    piccolo_run_queue_preempt(run_queue, task);
+}
+
+/**
+ * @brief Put a task which was preempted back on the head of the ready queue for its priority
+ *
+ * @param run_queue the run queue of the task's core
+ * @param task the task which stopped running
+ *
+ * It runs again, with what is left of its time slice, as soon as no task of higher priority is ready.
+ * (An EDF job within budget just goes back on the EDF queue, where its deadline keeps its place.)
+ */
+__force_inline static void piccolo_run_queue_put_back(piccolo_os_run_queue_t *run_queue, piccolo_os_task_t *task) {
+    if(task->edf.scheduled) piccolo_timer_queue_insert(&run_queue->edf_queue, &task->edf.node);
+    else {
+        piccolo_task_queue_push(&run_queue->ready_queue[task->priority], task);
+        run_queue->ready_bitmap |= 1u << task->priority;
+    }
+    piccolo_run_queue_count_ready(run_queue, task);
+}
+
+/**
+ * @brief Take a task off its ready queue
+ *
+ * @param run_queue the run queue of the task's core
+ * @param task a task on one of the ready queues
+ */
+__force_inline static void piccolo_run_queue_remove_ready(piccolo_os_run_queue_t *run_queue, piccolo_os_task_t *task) {
+    piccolo_os_task_queue_t *queue = &run_queue->ready_queue[task->priority];
+
+    if(task->edf.scheduled) piccolo_timer_queue_remove(&run_queue->edf_queue, &task->edf.node);
+    else {
+        piccolo_task_queue_remove(queue, task);
+        if(queue->head == NULL) run_queue->ready_bitmap &= ~(1u << task->priority);
+    }
+    if(piccolo_task_can_run_on(task, piccolo_run_queue_core(run_queue) ^ 1)) run_queue->stealable_count--;
+    run_queue->ready_count--;
+}
+
+/**
+ * @brief Find the task which should run next, without taking it
+ *
+ * @param run_queue the run queue
+ * @return piccolo_os_task_t* the EDF job with the earliest deadline, if any is ready, otherwise the task
+ * at the head of the highest priority non-empty ready queue, or NULL if no task is ready.
+ *
+ * The root of the EDF queue, or the highest set bit of the ready bitmap, gives the task, so the cost 
+ * does not depend on how many tasks exist or are blocked.
+ */
+__force_inline static piccolo_os_task_t *piccolo_run_queue_peek_ready(piccolo_os_run_queue_t *run_queue) {
+    if(run_queue->edf_queue.root) return piccolo_timer_owner(run_queue->edf_queue.root, piccolo_os_task_t, edf.node);
+    if(!run_queue->ready_bitmap) return NULL;
+    return run_queue->ready_queue[31 - __builtin_clz(run_queue->ready_bitmap)].head;
+}
+
+/**
+ * @brief Take the next task to run from the ready queues
+ *
+ * @param run_queue the run queue to take from
+ * @return piccolo_os_task_t* the task \ref piccolo_run_queue_peek_ready finds, or NULL if no task is ready.
+ */
+__force_inline static piccolo_os_task_t *piccolo_run_queue_take_ready(piccolo_os_run_queue_t *run_queue) {
+    piccolo_os_task_t *task = piccolo_run_queue_peek_ready(run_queue);
+
+    if(task) piccolo_run_queue_remove_ready(run_queue, task);
+    return task;
+}
+
+/**
+ * @brief Find the spin lock which protects a task's signal channel
+ *
+ * @param task the task
+ * @return spin_lock_t* the lock senders to the task take. Its receiver takes none.
+ */
+__force_inline static spin_lock_t *piccolo_signal_lock(piccolo_os_task_t *task) {
+    // Task blocks of one size class are often a power of 2 apart, so mix the address bits
+    return piccolo_ctx.signal_lock[(((uint32_t) (uintptr_t) task * 0x9e3779b1u) >> 24) & (PICCOLO_OS_SIGNAL_LOCKS - 1)];
+}
+
+/**
+ * @brief Find the lock wait queue for an SDK lock
+ *
+ * @param run_queue the run queue
+ * @param lock the lock (`lock_core_t`)
+ * @return piccolo_os_task_queue_t* the queue that tasks waiting on the lock are put on
+ */
+__force_inline static piccolo_os_task_queue_t *piccolo_run_queue_lock_waiters(piccolo_os_run_queue_t *run_queue, void *lock) {
+    return &run_queue->lock_wait_queue[((uintptr_t) lock >> 3) & (PICCOLO_OS_LOCK_WAIT_QUEUES - 1)];
+}
+
+/**
+ * @brief Check whether an event group wait condition holds
+ *
+ * @param group_bits the flags set in the event group
+ * @param wait_bits the flags being waited for
+ * @param wait_all true if all of `wait_bits` must be set, false if any one will do
+ * @return true if the waiting task can run
+ */
+__force_inline static bool piccolo_event_group_satisfied(uint32_t group_bits, uint32_t wait_bits, bool wait_all) {
+    return wait_all ? (group_bits & wait_bits) == wait_bits : (group_bits & wait_bits) != 0;
+}
+
+/**
+ * @brief Check whether a task waiting on a signal or an event group can run
+ *
+ * @param task the task, with one of the \ref PICCOLO_TASK_WAITING flags set
+ * @return true if there is a signal to receive, room to send the signal the task is blocked on,
+ * or the event flags it is waiting for are set
+ */
+__force_inline static bool piccolo_task_wait_satisfied(piccolo_os_task_t *task) {
+    piccolo_os_task_t *to_task;
+    uint32_t inptr;
+
+    //  Is it blocked waiting for a signal? Is there data? (in=out => empty)
+    if(task->task_flags & PICCOLO_TASK_GET_SIGNAL_BLOCKED) return task->signal_in != task->signal_out;
+
+    //  Or is it waiting on an event group? Are any (or all) of its flags set?
+    if(task->task_flags & PICCOLO_TASK_EVENT_BLOCKED)
+        return piccolo_event_group_satisfied(task->event_group->bits, task->event_bits, task->event_wait_all);
+
+    //  Or is it blocked waiting to send a signal? Is there room? ((in+1)%limit == out)=>full
+    to_task = task->task_sending_to;
+    inptr = to_task->signal_in + 1;
+    if(inptr == to_task->signal_limit) inptr = 0;
+    return inptr != to_task->signal_out;
+}
+
+/**
+ * @brief Find which \ref piccolo_os_wait_reason a task's blocking flags count as
+ *
+ * @param flags the task flags, with at least one blocking flag set
+ * @return uint32_t the wait reason
+ *
+ * The blocking flags are in the same order as the reasons, starting from \ref PICCOLO_TASK_SLEEPING,
+ * so the highest flag set (the thing waited on, rather than its timeout) gives the reason.
+ */
+__force_inline static uint32_t piccolo_wait_reason(uint32_t flags) {
+    return (31 - __builtin_clz(flags & PICCOLO_TASK_BLOCKING)) - (31 - __builtin_clz(PICCOLO_TASK_SLEEPING));
+}
+
+/**
+ * @brief Put a blocked task on the timer, blocked and lock wait queues its flags call for
+ *
+ * @param run_queue the run queue of the task's core
+ * @param task the task with blocking flags set
+ */
+__force_inline static void piccolo_run_queue_queue_blocked(piccolo_os_run_queue_t *run_queue, piccolo_os_task_t *task) {
+    if(task->task_flags & PICCOLO_TASK_SLEEPING) piccolo_timer_queue_insert(&run_queue->timer_queue, &task->wakeup);
+    if(task->task_flags & PICCOLO_TASK_WAITING) piccolo_task_queue_append(&run_queue->blocked_queue, task);
+    if(task->task_flags & PICCOLO_TASK_LOCK_BLOCKED)
+        piccolo_task_queue_append(piccolo_run_queue_lock_waiters(run_queue, task->lock_waiting_on), task);
+}
+
+/**
+ * @brief Take a blocked task off the timer, blocked and lock wait queues it is on
+ *
+ * @param run_queue the run queue of the task's core
+ * @param task the task with blocking flags set
+ */
+__force_inline static void piccolo_run_queue_unqueue_blocked(piccolo_os_run_queue_t *run_queue, piccolo_os_task_t *task) {
+    if(task->task_flags & PICCOLO_TASK_SLEEPING) piccolo_timer_queue_remove(&run_queue->timer_queue, &task->wakeup);
+    if(task->task_flags & PICCOLO_TASK_WAITING)
+        piccolo_task_queue_remove(&run_queue->blocked_queue, task);
+    if(task->task_flags & PICCOLO_TASK_LOCK_BLOCKED)
+        piccolo_task_queue_remove(piccolo_run_queue_lock_waiters(run_queue, task->lock_waiting_on), task);
+}
+
+/**
+ * @brief Put a task which has just stopped running on the blocked and timer queues
+ *
+ * @param run_queue the run queue of the task's core
+ * @param task the task with blocking flags set
+ *
+ * A task waiting on a signal or an event group goes on the blocked queue, unless its wait condition 
+ * is already satisfied (a signal may have arrived before it yielded), when it is made ready at once.
+ * After this, signal senders and receivers wake the task directly, and event groups mark the blocked
+ * queue for checking. A task waiting on an SDK lock goes on the lock's wait queue, where only releasing 
+ * the lock will find it. A task with a timeout goes in the timer queue.
+ */
+__force_inline static void piccolo_run_queue_block(piccolo_os_run_queue_t *run_queue, piccolo_os_task_t *task) {
+    if((task->task_flags & PICCOLO_TASK_WAITING) && piccolo_task_wait_satisfied(task)) {
+        task->task_flags = 0;
+        piccolo_run_queue_make_ready(run_queue, task);
+        return;
+    }
+    piccolo_run_queue_queue_blocked(run_queue, task);
+    task->blocked_at = time_us_32();
+    task->wait_reason = piccolo_wait_reason(task->task_flags);
+}
+
+/**
+ * @brief Unblock a blocked task and make it ready
+ *
+ * @param run_queue the run queue of the task's core
+ * @param task the task, which is blocked and not running
+ *
+ * Takes the task off the blocked, lock wait and timer queues it is on, clears its blocking flags
+ * and puts it on its ready queue. The time it was blocked is added to its statistics.
+ */
+__force_inline static void piccolo_run_queue_wake(piccolo_os_run_queue_t *run_queue, piccolo_os_task_t *task) {
+    piccolo_run_queue_unqueue_blocked(run_queue, task);
+    task->task_flags = 0;
+    task->statistics.wait_us[task->wait_reason] += time_us_32() - task->blocked_at;
+    piccolo_run_queue_make_ready(run_queue, task);
+}
+
+/**
+ * @brief Let a task blocked on `flag` run
+ *
+ * @param run_queue the run queue of `core`
+ * @param core the core whose run queue lock is held
+ * @param task the task to release
+ * @param flag the blocking flag the task must be waiting on
+ * @return true if the task was waiting on `flag`
+ *
+ * If the task is blocked on this core it is made ready. A task may have set its flags but still be running
+ * (it has not yielded yet). Then just clearing its flags keeps it from blocking, since the scheduler only
+ * looks at them with the run queue lock held. Wakes the core if it is idle.
+ */
+__force_inline static bool piccolo_run_queue_release(piccolo_os_run_queue_t *run_queue, uint core,
+                                                      piccolo_os_task_t *task, uint32_t flag) {
+    if(task->core != core || !(task->task_flags & flag)) return false;
+    if(task->task_flags & PICCOLO_TASK_RUNNING) task->task_flags &= ~PICCOLO_TASK_BLOCKING;
+    else piccolo_run_queue_wake(run_queue, task);
+    __sev();
+    return true;
+}
+
+/**
+ * @brief Take a task which is not running off whatever queues of its core it is on
+ *
+ * @param run_queue the run queue of the task's core
+ * @param task the task, which is ready or blocked but not running
+ *
+ * With \ref piccolo_run_queue_attach, moves a task from one core to another without waking it.
+ */
+__force_inline static void piccolo_run_queue_detach(piccolo_os_run_queue_t *run_queue, piccolo_os_task_t *task) {
+    if(task->task_flags & PICCOLO_TASK_BLOCKING) piccolo_run_queue_unqueue_blocked(run_queue, task);
+    else piccolo_run_queue_remove_ready(run_queue, task);
+}
+
+/**
+ * @brief Put a task taken off by \ref piccolo_run_queue_detach on the queues of its (new) core
+ *
+ * @param run_queue the run queue of the task's core
+ * @param task the task, with `blocked_at` and `wait_reason` set if it is blocked
+ *
+ * A blocked task stays blocked, and the time it has been blocked for keeps counting. But releasing
+ * a lock or setting event flags looks at one core at a time, and may have looked here before the task
+ * arrived. So a task waiting on a lock is woken to try again (which does no harm), and one whose wait
+ * is already satisfied is made ready.
+ */
+__force_inline static void piccolo_run_queue_attach(piccolo_os_run_queue_t *run_queue, piccolo_os_task_t *task) {
+    if(task->task_flags & PICCOLO_TASK_BLOCKING) {
+        if(!(task->task_flags & PICCOLO_TASK_LOCK_BLOCKED)
+                && !((task->task_flags & PICCOLO_TASK_WAITING) && piccolo_task_wait_satisfied(task))) {
+            piccolo_run_queue_queue_blocked(run_queue, task);
+            return;
+        }
+        task->task_flags = 0;
+        task->statistics.wait_us[task->wait_reason] += time_us_32() - task->blocked_at;
+    }
+    piccolo_run_queue_make_ready(run_queue, task);
+}
+
+/**
+ * @brief Tell the schedulers that a task waiting on an event group may now be able to run
+ *
+ * A task blocked on an event group sits on the blocked queue of the core it last ran on,
+ * so both are told, and woken if they are idle.
+ */
+__force_inline static void piccolo_blocked_changed(void) {
+    piccolo_ctx.run_queue[0].blocked_changed = true;
+    piccolo_ctx.run_queue[1].blocked_changed = true;
+    __sev();
+}
+
+/** Kernel functions shared between its source files (see kernel.c and lite_task.c) **/
+int32_t __piccolo_send_signal(piccolo_os_task_t* task, bool block, uint32_t timeout_ms, const void *message);
+int32_t __piccolo_get_signal(bool block, uint32_t timeout_ms, bool get_all, void *message);
+void __piccolo_lite_lock_notify(void *lock);
+
+/**@}**/
+
+#endif
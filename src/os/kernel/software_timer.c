@@ -0,0 +1,243 @@
+/**
+ * @file software_timer.c
+ * @brief Piccolo OS software timers
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * The running software timers are kept in one timer queue, earliest expiry first, by a single kernel task,
+ * the timer task. It runs the callbacks of the timers which have expired, then blocks on its signal channel
+ * until the next expiry. Starting a timer which expires before the one it is waiting for signals it, so it
+ * can wait for the new one instead. Everything is protected by the global lock, which is never held while
+ * a callback runs.
+ */
+
+#include "pico/stdlib.h"
+
+#include "kernel.h"
+
+extern piccolo_os_internals_t piccolo_ctx;
+
+/**
+ * @brief Put a timer in the timer task's queue, to expire at `expiry.deadline`
+ *
+ * @param service the timer service
+ * @param timer the timer, which is not in the queue
+ * @return true if the timer task must be signalled (after the lock is released) to wait for it instead
+ * \ingroup Intern
+ * Called with the global lock held.
+ */
+static bool __piccolo_timer_insert(piccolo_os_timer_service_t *service, piccolo_timer_t *timer) {
+    bool wake;
+
+    timer->active = true;
+    piccolo_timer_queue_insert(&service->timer_queue, &timer->expiry);
+    wake = service->waiting && piccolo_timer_queue_peek(&service->timer_queue) == &timer->expiry;
+    if(wake) service->waiting = false;
+    return wake;
+}
+
+/**
+ * @brief Work out when a periodic timer which has just expired expires next
+ *
+ * @param timer the timer
+ * \ingroup Intern
+ * A period after the expiry, not after now, so the timer keeps in step however late the timer task is.
+ * If even that has passed, the expiries which have are skipped (and counted), rather than run one after another.
+ */
+static void __piccolo_timer_next(piccolo_timer_t *timer) {
+    absolute_time_t next = delayed_by_us(timer->expiry.deadline, timer->period_us);
+    int64_t late = absolute_time_diff_us(next, get_absolute_time());
+    uint32_t skipped;
+
+    if(late >= 0) {
+        skipped = late / timer->period_us + 1;
+        timer->missed += skipped;
+        next = delayed_by_us(next, (uint64_t) skipped * timer->period_us);
+    }
+    timer->expiry.deadline = next;
+}
+
+/**
+ * @brief The timer task: runs the callbacks of the software timers as they expire
+ *
+ * @param argument the timer service
+ * \ingroup Intern
+ * A periodic timer is put back in the queue before its callback runs, so the callback may stop or restart it.
+ * With no timer expired, it blocks on its signal channel, with a timeout at the earliest expiry. It never ends.
+ */
+static void __piccolo_timer_run(void *argument) {
+    piccolo_os_timer_service_t *service = (piccolo_os_timer_service_t *) argument;
+    piccolo_os_task_t *task = piccolo_get_task_id();
+    piccolo_timer_node_t *node;
+    piccolo_timer_t *timer;
+    void (*callback)(piccolo_timer_t *timer);
+    uint32_t lock;
+
+    // Its creator may not have recorded it yet. It must be, before anyone is told to signal it.
+    lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    service->task = task;
+    spin_unlock(piccolo_ctx.piccolo_lock, lock);
+
+    while(1) {
+        lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+        service->waiting = false;
+        node = piccolo_timer_queue_peek(&service->timer_queue);
+        if(node && time_reached(node->deadline)) {
+            piccolo_timer_queue_pop(&service->timer_queue);
+            timer = piccolo_timer_owner(node, piccolo_timer_t, expiry);
+            if(timer->period_us) {
+                __piccolo_timer_next(timer);
+                piccolo_timer_queue_insert(&service->timer_queue, &timer->expiry);
+            }
+            else timer->active = false;
+            callback = timer->callback;
+            spin_unlock(piccolo_ctx.piccolo_lock, lock);
+            callback(timer);
+            continue;
+        }
+        // block until a timer expires, or one which expires sooner is started
+        service->waiting = true;
+        if(node) task->wakeup.deadline = node->deadline;
+        task->task_flags |= PICCOLO_TASK_GET_SIGNAL_BLOCKED | (node ? PICCOLO_TASK_SLEEPING : 0);
+        spin_unlock(piccolo_ctx.piccolo_lock, lock);
+        piccolo_yield();
+        piccolo_get_signal_all();
+    }
+}
+
+/**
+ * @brief Make sure there is a timer task
+ *
+ * @return true if there is one
+ * \ingroup Intern
+ * The timer task is created the first time it is needed. If another task is creating it, waits for that.
+ */
+static bool __piccolo_timer_service_start(void) {
+    piccolo_os_timer_service_t *service = &piccolo_ctx.timer_service;
+    piccolo_os_task_t *task;
+    uint32_t lock;
+
+    while(1) {
+        lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+        task = service->task;
+        if(!task) service->task = (piccolo_os_task_t *) 1;  // ours to create
+        spin_unlock(piccolo_ctx.piccolo_lock, lock);
+        if((uintptr_t) task > 1) return true;
+        if(!task) break;
+        piccolo_sleep(1);   // not yield, which would not let a creator of lower priority finish
+    }
+    task = piccolo_create_task_ex(__piccolo_timer_run, service, PICCOLO_OS_TIMER_STACK_SIZE, "timer");
+    if(task) piccolo_set_priority(task, PICCOLO_OS_TIMER_PRIORITY);
+    lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    service->task = task;
+    spin_unlock(piccolo_ctx.piccolo_lock, lock);
+    return task != NULL;
+}
+
+/**
+ * @brief Set up a software timer, which is not running
+ *
+ * @param timer the timer structure, which must stay put while the timer runs
+ * @param callback run by the timer task each time the timer expires, with the timer
+ * @param argument for the callback, as `timer->argument`
+ * @return true if the timer was set up, false if there is no room for the timer task
+ *
+ * The structure must be zeroed (a static one is), or hold a timer set up before, which is stopped first if it
+ * is still running. Call from a task, or before `piccolo_start()`.
+ */
+bool piccolo_timer_create(piccolo_timer_t *timer, void (*callback)(piccolo_timer_t *timer), void *argument) {
+    uint32_t lock;
+
+    if(!__piccolo_timer_service_start()) return false;
+    lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    if(timer->active) piccolo_timer_queue_remove(&piccolo_ctx.timer_service.timer_queue, &timer->expiry);
+    timer->callback = callback;
+    timer->argument = argument;
+    timer->delay_us = timer->period_us = 0;
+    timer->missed = 0;
+    timer->active = false;
+    spin_unlock(piccolo_ctx.piccolo_lock, lock);
+    return true;
+}
+
+/**
+ * @brief Start a software timer, or start it again from now if it is running
+ *
+ * @param timer the timer
+ * @param delay_us microseconds from now to its first expiry
+ * @param period_us microseconds from one expiry to the next, or 0 to expire once
+ *
+ * Safe to call from tasks, lightweight tasks, interrupt service handlers and timer callbacks.
+ */
+void piccolo_timer_start(piccolo_timer_t *timer, uint32_t delay_us, uint32_t period_us) {
+    piccolo_os_timer_service_t *service = &piccolo_ctx.timer_service;
+    uint32_t lock;
+    bool wake;
+
+    lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    if(timer->active) piccolo_timer_queue_remove(&service->timer_queue, &timer->expiry);
+    timer->delay_us = delay_us;
+    timer->period_us = period_us;
+    timer->expiry.deadline = make_timeout_time_us(delay_us);
+    wake = __piccolo_timer_insert(service, timer);
+    spin_unlock(piccolo_ctx.piccolo_lock, lock);
+    if(wake) piccolo_send_signal(service->task);
+}
+
+/**
+ * @brief Stop a software timer
+ *
+ * @param timer the timer
+ * @return true if it was running, false if it had already stopped (a one-shot timer which has expired)
+ *
+ * Its callback does not run again, unless it is already running. Safe to call from anywhere
+ * `piccolo_timer_start()` is.
+ */
+bool piccolo_timer_stop(piccolo_timer_t *timer) {
+    uint32_t lock;
+    bool active;
+
+    lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    active = timer->active;
+    if(active) piccolo_timer_queue_remove(&piccolo_ctx.timer_service.timer_queue, &timer->expiry);
+    timer->active = false;
+    spin_unlock(piccolo_ctx.piccolo_lock, lock);
+    return active;
+}
+
+/**
+ * @brief Start a software timer again from now, with the delay and period it was last started with
+ *
+ * @param timer the timer
+ *
+ * A watchdog: a one-shot timer which is reset more often than its delay never expires.
+ * Safe to call from anywhere `piccolo_timer_start()` is.
+ */
+void piccolo_timer_reset(piccolo_timer_t *timer) {
+    piccolo_timer_start(timer, timer->delay_us, timer->period_us);
+}
+
+/**
+ * @brief Find out whether a software timer is running
+ *
+ * @param timer the timer
+ * @return true if it has been started, and not stopped nor (if it is a one-shot timer) expired
+ */
+bool piccolo_timer_active(piccolo_timer_t *timer) {
+    return timer->active;
+}
+
+/**
+ * @brief Get the timer task
+ *
+ * @return piccolo_os_task_t* the task which runs the timer callbacks, or NULL if there is none yet
+ *
+ * Its stack high water mark shows how much of \ref PICCOLO_OS_TIMER_STACK_SIZE the callbacks use.
+ */
+piccolo_os_task_t *piccolo_timer_task(void) {
+    piccolo_os_task_t *task = piccolo_ctx.timer_service.task;
+
+    return (uintptr_t) task > 1 ? task : NULL;
+}
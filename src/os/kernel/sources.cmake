@@ -0,0 +1,21 @@
+# The kernel's C sources, shared by the device build (src/os/CMakeLists.txt) and the
+# host simulation (src/os/host), which has its own context switch instead of context_switch.s
+set(PICCOLO_KERNEL_SOURCES
+	${CMAKE_CURRENT_LIST_DIR}/coroutine.hpp
+	${CMAKE_CURRENT_LIST_DIR}/event_group.c
+	${CMAKE_CURRENT_LIST_DIR}/kernel.c
+	${CMAKE_CURRENT_LIST_DIR}/kernel.h
+	${CMAKE_CURRENT_LIST_DIR}/lite_task.c
+	${CMAKE_CURRENT_LIST_DIR}/lock_core.c
+	${CMAKE_CURRENT_LIST_DIR}/lock_core.h
+	${CMAKE_CURRENT_LIST_DIR}/mailbox.c
+	${CMAKE_CURRENT_LIST_DIR}/run_queue.h
+	${CMAKE_CURRENT_LIST_DIR}/software_timer.c
+	${CMAKE_CURRENT_LIST_DIR}/task_pool.c
+	${CMAKE_CURRENT_LIST_DIR}/task_pool.h
+	${CMAKE_CURRENT_LIST_DIR}/timer_queue.c
+	${CMAKE_CURRENT_LIST_DIR}/timer_queue.h
+	${CMAKE_CURRENT_LIST_DIR}/trace.c
+	${CMAKE_CURRENT_LIST_DIR}/trace.h
+	${CMAKE_CURRENT_LIST_DIR}/work_queue.c
+)
@@ -0,0 +1,263 @@
+/**
+ * @file task_pool.c
+ * @brief Piccolo OS task and stack pools
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Each stack size class has a list of free task blocks. Taking a block from the
+ * list and putting one back are constant time and never touch the heap, so the
+ * scheduler can reclaim a dead task itself, in the exception handler. The heap is
+ * only used (by a task) when a pool is empty, so with a steady mix of tasks the
+ * heap stops changing and cannot fragment. All pool lists are protected by the
+ * global `piccolo_lock`.
+ *
+ * The frame pools do the same for blocks without a stack, such as C++ coroutine frames. 
+ * A free frame holds the link to the next one in its first word.
+ */
+
+#include <stdlib.h>
+#include "hardware/sync.h"
+#include "pico/malloc.h"
+
+#include "kernel.h"
+#include "task_pool.h"
+
+extern piccolo_os_internals_t piccolo_ctx;
+
+/**
+ * @brief Find the size class for a stack size
+ *
+ * \ingroup Intern
+ * @param stack_size requested stack size in bytes
+ * @return int the smallest class with stacks at least that big, or -1 if the size is too large
+ */
+static int __piccolo_pool_class(uint32_t stack_size) {
+    int size_class;
+
+    if(stack_size <= PICCOLO_OS_MINIMUM_STACK_SIZE) return 0;
+    // round up to a power of two, counting from the smallest class
+    size_class = (32 - __builtin_clz(stack_size - 1)) - __builtin_ctz(PICCOLO_OS_MINIMUM_STACK_SIZE);
+    return size_class < PICCOLO_OS_POOL_CLASSES ? size_class : -1;
+}
+
+/**
+ * @brief Allocate a new task block of a class from the heap
+ *
+ * \ingroup Intern
+ * @param size_class the size class
+ * @return piccolo_os_task_t* the new block, with its stack set up, or NULL if the heap is full
+ *
+ * Must be called from a task (not the scheduler or an interrupt), and without the global lock.
+ */
+static piccolo_os_task_t *__piccolo_pool_grow(int size_class) {
+    piccolo_os_task_t *task;
+    uint32_t stack_size = piccolo_ctx.pool[size_class].statistics.stack_size;
+    uint32_t lock_value;
+
+    // leave room to 8 byte align the stack
+    task = (piccolo_os_task_t *) malloc(sizeof(piccolo_os_task_t) + 8 + stack_size);
+    if(task == NULL) return task;
+
+    task->stack = (uint32_t *) ((((uintptr_t) (task + 1)) + 7) & ~((uintptr_t) 7));
+    task->stack_size = stack_size;
+
+    lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    piccolo_ctx.pool[size_class].statistics.allocated++;
+    spin_unlock(piccolo_ctx.piccolo_lock, lock_value);
+    return task;
+}
+
+/**
+ * @brief Set all the task pools to empty
+ *
+ * \ingroup Intern
+ * Called once by `piccolo_init()`.
+ */
+void piccolo_task_pool_init(void) {
+    for(int size_class = 0; size_class < PICCOLO_OS_POOL_CLASSES; size_class++) {
+        piccolo_ctx.pool[size_class].free = NULL;
+        piccolo_ctx.pool[size_class].statistics = (piccolo_os_pool_statistics_t) {0};
+        piccolo_ctx.pool[size_class].statistics.stack_size = PICCOLO_OS_MINIMUM_STACK_SIZE << size_class;
+    }
+    for(int size_class = 0; size_class < PICCOLO_OS_FRAME_CLASSES; size_class++) piccolo_ctx.frame_pool[size_class] = NULL;
+}
+
+/**
+ * @brief Get a task block for a new task
+ *
+ * \ingroup Intern
+ * @param stack_size the stack size the task needs, in bytes
+ * @return piccolo_os_task_t* a task block with `stack` and `stack_size` set, or NULL if
+ * the stack size is too large or there is no memory
+ *
+ * Takes a free block from the pool of the stack size class if there is one, and only
+ * goes to the heap if the pool is empty. Must be called from a task.
+ */
+piccolo_os_task_t *piccolo_task_pool_allocate(uint32_t stack_size) {
+    piccolo_os_task_pool_t *pool;
+    piccolo_os_task_t *task;
+    uint32_t lock_value;
+    int size_class = __piccolo_pool_class(stack_size);
+
+    if(size_class < 0) return NULL;
+    pool = &piccolo_ctx.pool[size_class];
+
+    lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    if((task = pool->free)) {
+        pool->free = task->next_task;
+        pool->statistics.free--;
+        pool->statistics.reused++;
+    }
+    spin_unlock(piccolo_ctx.piccolo_lock, lock_value);
+
+    if(task == NULL) task = __piccolo_pool_grow(size_class);
+    return task;
+}
+
+/**
+ * @brief Return the block of a dead task to its pool
+ *
+ * \ingroup Intern
+ * @param task the task, which must no longer be on the task list or any run queue
+ *
+ * Must be called with the global lock held. It does not use the heap, so the scheduler
+ * calls it as soon as a task ends.
+ */
+void piccolo_task_pool_release(piccolo_os_task_t *task) {
+    piccolo_os_task_pool_t *pool = &piccolo_ctx.pool[__piccolo_pool_class(task->stack_size)];
+
+    task->next_task = pool->free;
+    pool->free = task;
+    pool->statistics.free++;
+    pool->statistics.reclaimed++;
+}
+
+/**
+ * @brief Put blocks for tasks of a stack size in the pool ahead of time
+ *
+ * @param stack_size the stack size of the tasks, in bytes
+ * @param count number of blocks to add to the pool
+ * @return uint32_t the number of blocks added, which is less than `count` if the heap filled up
+ * (or zero if the stack size is larger than the largest class)
+ *
+ * After reserving, creating up to `count` tasks of that size is quick and does not use the heap.
+ * Must be called from a task, or before `piccolo_start()`.
+ */
+uint32_t piccolo_reserve_tasks(uint32_t stack_size, uint32_t count) {
+    piccolo_os_task_t *task;
+    uint32_t reserved, lock_value;
+    int size_class = __piccolo_pool_class(stack_size);
+
+    if(size_class < 0) return 0;
+    for(reserved = 0; reserved < count; reserved++) {
+        if((task = __piccolo_pool_grow(size_class)) == NULL) break;
+        lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+        task->next_task = piccolo_ctx.pool[size_class].free;
+        piccolo_ctx.pool[size_class].free = task;
+        piccolo_ctx.pool[size_class].statistics.free++;
+        spin_unlock(piccolo_ctx.piccolo_lock, lock_value);
+    }
+    return reserved;
+}
+
+/**
+ * @brief Get a copy of the statistics of one task pool
+ *
+ * @param size_class the size class, from 0 (stacks of \ref PICCOLO_OS_MINIMUM_STACK_SIZE bytes)
+ * to \ref PICCOLO_OS_POOL_CLASSES - 1
+ * @param statistics where to put the copy
+ */
+void piccolo_get_pool_statistics(uint size_class, piccolo_os_pool_statistics_t *statistics) {
+    uint32_t lock_value;
+
+    if(size_class >= PICCOLO_OS_POOL_CLASSES) {
+        *statistics = (piccolo_os_pool_statistics_t) {0};
+        return;
+    }
+    lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    *statistics = piccolo_ctx.pool[size_class].statistics;
+    spin_unlock(piccolo_ctx.piccolo_lock, lock_value);
+}
+
+/**
+ * @brief Find the frame pool size class for a size
+ *
+ * \ingroup Intern
+ * @param size requested size in bytes
+ * @return int the smallest class with blocks at least that big, or -1 if the size is too large
+ */
+static int __piccolo_frame_class(uint32_t size) {
+    int size_class;
+
+    if(size <= PICCOLO_OS_MINIMUM_FRAME_SIZE) return 0;
+    size_class = (32 - __builtin_clz(size - 1)) - __builtin_ctz(PICCOLO_OS_MINIMUM_FRAME_SIZE);
+    return size_class < PICCOLO_OS_FRAME_CLASSES ? size_class : -1;
+}
+
+/**
+ * @brief Get a block of memory from the frame pools
+ *
+ * @param size the size needed, in bytes
+ * @return void* a block of at least `size` bytes, 8 byte aligned, or NULL if the size is larger than the 
+ * largest class (\ref PICCOLO_OS_FRAME_CLASSES) or there is no memory
+ *
+ * Takes a free block of the size class if there is one, and only goes to the heap if the pool is empty.
+ * Must be called from a task.
+ */
+void *piccolo_frame_allocate(uint32_t size) {
+    void *frame;
+    uint32_t lock_value;
+    int size_class = __piccolo_frame_class(size);
+
+    if(size_class < 0) return NULL;
+    lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    if((frame = piccolo_ctx.frame_pool[size_class])) piccolo_ctx.frame_pool[size_class] = *(void **) frame;
+    spin_unlock(piccolo_ctx.piccolo_lock, lock_value);
+
+    if(frame == NULL) frame = malloc(PICCOLO_OS_MINIMUM_FRAME_SIZE << size_class);
+    return frame;
+}
+
+/**
+ * @brief Give a block back to its frame pool
+ *
+ * @param frame a block from `piccolo_frame_allocate()`, or NULL
+ * @param size the size it was allocated with
+ *
+ * Does not use the heap, so it is safe to call from interrupt service handlers.
+ */
+void piccolo_frame_free(void *frame, uint32_t size) {
+    uint32_t lock_value;
+    int size_class = __piccolo_frame_class(size);
+
+    if(frame == NULL) return;
+    lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    *(void **) frame = piccolo_ctx.frame_pool[size_class];
+    piccolo_ctx.frame_pool[size_class] = frame;
+    spin_unlock(piccolo_ctx.piccolo_lock, lock_value);
+}
+
+/**
+ * @brief Put blocks of a size in the frame pool ahead of time
+ *
+ * @param size the size of the blocks, in bytes
+ * @param count number of blocks to add to the pool
+ * @return uint32_t the number of blocks added, which is less than `count` if the heap filled up
+ * (or zero if the size is larger than the largest class)
+ *
+ * Must be called from a task, or before `piccolo_start()`.
+ */
+uint32_t piccolo_reserve_frames(uint32_t size, uint32_t count) {
+    uint32_t reserved;
+    void *frame;
+    int size_class = __piccolo_frame_class(size);
+
+    if(size_class < 0) return 0;
+    for(reserved = 0; reserved < count; reserved++) {
+        if((frame = malloc(PICCOLO_OS_MINIMUM_FRAME_SIZE << size_class)) == NULL) break;
+        piccolo_frame_free(frame, size);
+    }
+    return reserved;
+}
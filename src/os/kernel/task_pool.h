@@ -0,0 +1,29 @@
+/**
+ * @file task_pool.h
+ * @brief Piccolo OS task and stack pools
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Kernel interface to the pools of task blocks. A task block is a task structure
+ * with its stack just after it, allocated from the heap once and then reused.
+ */
+
+#ifndef PICCOLO_TASK_POOL_H
+#define PICCOLO_TASK_POOL_H
+
+#include "kernel.h"
+
+/** @defgroup Intern The Piccolo Plus Internals
+ *
+ * @{
+ */
+
+void piccolo_task_pool_init(void);
+piccolo_os_task_t *piccolo_task_pool_allocate(uint32_t stack_size);
+void piccolo_task_pool_release(piccolo_os_task_t *task);
+
+/**@}**/
+
+#endif
@@ -0,0 +1,122 @@
+/**
+ * @file timer_queue.c
+ * @brief Piccolo OS deadline ordered timer queue
+ * @version 1.0
+ * @date 2026-10-17
+ * 
+ * SPDX-License-Identifier: BSD-3-Clause
+ * 
+ * The timer queue is a pairing heap. Insertion and finding the earliest deadline
+ * take constant time, removal takes logarithmic (amortized) time. Nothing is
+ * allocated, so all of these are safe to call from the scheduler with the 
+ * scheduler spin lock held.
+ */
+
+#include "timer_queue.h"
+
+/**
+ * @brief Combine two heaps into one
+ * 
+ * @param first root of a heap, or NULL
+ * @param second root of a heap, or NULL
+ * @return piccolo_timer_node_t* the root of the combined heap
+ * \ingroup Intern
+ * The root with the later deadline becomes the first child of the other.
+ * Both roots must have no siblings.
+ */
+static piccolo_timer_node_t *__time_critical_func(__piccolo_timer_meld)(piccolo_timer_node_t *first, piccolo_timer_node_t *second) {
+    piccolo_timer_node_t *swap;
+
+    if(first == NULL) return second;
+    if(second == NULL) return first;
+    if(to_us_since_boot(second->deadline) < to_us_since_boot(first->deadline)) {
+        swap = first;
+        first = second;
+        second = swap;
+    }
+    second->sibling = first->child;
+    if(first->child) first->child->prev = second;
+    second->prev = first;
+    first->child = second;
+    first->prev = NULL;
+    return first;
+}
+
+/**
+ * @brief Combine a list of sibling heaps into one
+ * 
+ * @param first the first of the siblings, or NULL
+ * @return piccolo_timer_node_t* the root of the combined heap, or NULL
+ * \ingroup Intern
+ * The standard two pass pairing: meld the siblings in pairs from left to right,
+ * then meld the pairs together from right to left. No recursion, so no stack
+ * growth no matter how unbalanced the heap is.
+ */
+static piccolo_timer_node_t *__time_critical_func(__piccolo_timer_merge_pairs)(piccolo_timer_node_t *first) {
+    piccolo_timer_node_t *pairs = NULL, *second, *next, *root = NULL;
+
+    // first pass, pairs are pushed on a list (through sibling) in reverse order
+    while(first) {
+        second = first->sibling;
+        next = second ? second->sibling : NULL;
+        first->sibling = NULL;
+        if(second) second->sibling = NULL;
+        first = __piccolo_timer_meld(first, second);
+        first->sibling = pairs;
+        pairs = first;
+        first = next;
+    }
+    // second pass, meld them back together
+    while(pairs) {
+        next = pairs->sibling;
+        pairs->sibling = NULL;
+        root = __piccolo_timer_meld(root, pairs);
+        pairs = next;
+    }
+    return root;
+}
+
+/**
+ * @brief Add an entry to a timer queue
+ * 
+ * @param queue the timer queue
+ * @param node the entry, with its deadline set. Must not already be in a queue.
+ */
+void __time_critical_func(piccolo_timer_queue_insert)(piccolo_timer_queue_t *queue, piccolo_timer_node_t *node) {
+    node->child = node->sibling = node->prev = NULL;
+    queue->root = __piccolo_timer_meld(queue->root, node);
+}
+
+/**
+ * @brief Remove and return the entry with the earliest deadline
+ * 
+ * @param queue the timer queue
+ * @return piccolo_timer_node_t* the earliest entry, or NULL if the queue is empty
+ */
+piccolo_timer_node_t *__time_critical_func(piccolo_timer_queue_pop)(piccolo_timer_queue_t *queue) {
+    piccolo_timer_node_t *node = queue->root;
+
+    if(node) queue->root = __piccolo_timer_merge_pairs(node->child);
+    return node;
+}
+
+/**
+ * @brief Remove an entry from anywhere in a timer queue
+ * 
+ * @param queue the timer queue
+ * @param node the entry, which must be in this queue
+ */
+void __time_critical_func(piccolo_timer_queue_remove)(piccolo_timer_queue_t *queue, piccolo_timer_node_t *node) {
+    if(node == queue->root) {
+        piccolo_timer_queue_pop(queue);
+        return;
+    }
+    // unlink the entry (and everything below it) from its parent or previous sibling
+    if(node->prev->child == node) node->prev->child = node->sibling;
+    else node->prev->sibling = node->sibling;
+    if(node->sibling) node->sibling->prev = node->prev;
+    node->sibling = NULL;
+
+    // then put everything below it back
+    queue->root = __piccolo_timer_meld(queue->root, __piccolo_timer_merge_pairs(node->child));
+}
@@ -0,0 +1,76 @@
+/**
+ * @file timer_queue.h
+ * @brief Piccolo OS deadline ordered timer queue
+ * @version 1.0
+ * @date 2026-10-17
+ * 
+ * SPDX-License-Identifier: BSD-3-Clause
+ * 
+ * A timer queue holds nodes ordered by deadline, with the earliest deadline always 
+ * available at the root. It is a pairing heap, so nodes are linked into the queue
+ * through the node itself and the queue never needs any memory of its own. 
+ */
+
+#ifndef PICCOLO_TIMER_QUEUE_H
+#define PICCOLO_TIMER_QUEUE_H
+
+#include <stddef.h>
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup Intern The Piccolo Plus Internals
+ * 
+ * @{
+ */
+
+/**
+ * @brief A timer queue entry. Embed it in the structure which is waiting for the deadline.
+ * 
+ */
+// \cond force_doxygen_to_list
+typedef /*\endcond**/
+struct piccolo_timer_node_t {
+    absolute_time_t deadline;               /**< time at which the entry expires **/
+    struct piccolo_timer_node_t *child;     /**< first of the entries expiring no sooner than this one **/
+    struct piccolo_timer_node_t *sibling;   /**< next entry with the same parent **/
+    struct piccolo_timer_node_t *prev;      /**< parent if this is the first child, otherwise previous sibling **/
+} piccolo_timer_node_t;
+
+/**
+ * @brief A timer queue. Initialize `root` to NULL for an empty queue.
+ * 
+ */
+typedef struct {
+    piccolo_timer_node_t *root;             /**< entry with the earliest deadline, or NULL if empty **/
+} piccolo_timer_queue_t;
+
+/**
+ * @brief Get the structure a timer queue entry is embedded in
+ * 
+ */
+#define piccolo_timer_owner(node, type, member) ((type *)((uint8_t *)(node) - offsetof(type, member)))
+
+/**
+ * @brief Get the entry with the earliest deadline without removing it
+ * 
+ * @param queue the timer queue
+ * @return piccolo_timer_node_t* the earliest entry, or NULL if the queue is empty
+ */
+__force_inline static piccolo_timer_node_t *piccolo_timer_queue_peek(piccolo_timer_queue_t *queue) {
+    return queue->root;
+}
+
+void piccolo_timer_queue_insert(piccolo_timer_queue_t *queue, piccolo_timer_node_t *node);
+void piccolo_timer_queue_remove(piccolo_timer_queue_t *queue, piccolo_timer_node_t *node);
+piccolo_timer_node_t *piccolo_timer_queue_pop(piccolo_timer_queue_t *queue);
+
+/**@}**/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,104 @@
+/**
+ * @file trace.c
+ * @brief Piccolo OS scheduler trace
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * The trace rings, and printing them. The dump is plain text so it can be captured
+ * from the serial console:
+ *
+ *     PICCOLO TRACE BEGIN
+ *     task <address> <name>            one line for each task which exists now
+ *     core <core> <events recorded>
+ *     <time> <type> <task> <data>      in hex, oldest first
+ *     PICCOLO TRACE END
+ */
+
+#include <stdio.h>
+#include "hardware/sync.h"
+
+#include "kernel.h"
+#include "trace.h"
+
+extern piccolo_os_internals_t piccolo_ctx;
+
+#if PICCOLO_OS_TRACE
+
+_Static_assert((PICCOLO_OS_TRACE_EVENTS & (PICCOLO_OS_TRACE_EVENTS - 1)) == 0,
+    "PICCOLO_OS_TRACE_EVENTS must be a power of 2");
+
+piccolo_trace_ring_t piccolo_trace_ring[2];
+volatile bool piccolo_trace_paused;
+
+/**
+ * @brief Print the trace rings on stdio
+ *
+ * Recording stops while the rings are printed, then carries on. The task list is printed
+ * with the global lock held, so the other core can't create or remove tasks until it is done.
+ */
+void piccolo_trace_dump(void) {
+    piccolo_trace_ring_t *ring;
+    piccolo_trace_event_t *event;
+    piccolo_os_task_t *task;
+    uint32_t lock_value, head, index;
+    uint core;
+
+    piccolo_trace_paused = true;
+    __dmb();
+    printf("PICCOLO TRACE BEGIN\n");
+
+    lock_value = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+    for(task = piccolo_ctx.task_list_head; task; task = task->next_task)
+        printf("task %08lx %s\n", (uint32_t) (uintptr_t) task, task->name ? task->name : "-");
+    spin_unlock(piccolo_ctx.piccolo_lock, lock_value);
+
+    for(core = 0; core < 2; core++) {
+        ring = &piccolo_trace_ring[core];
+        head = ring->head;
+        printf("core %u %lu\n", core, head);
+        index = (head > PICCOLO_OS_TRACE_EVENTS) ? head - PICCOLO_OS_TRACE_EVENTS : 0;
+        for(; index != head; index++) {
+            event = &ring->event[index % PICCOLO_OS_TRACE_EVENTS];
+            printf("%08lx %lx %08lx %08lx\n", event->time, event->type, event->task, event->data);
+        }
+    }
+
+    printf("PICCOLO TRACE END\n");
+    piccolo_trace_paused = false;
+}
+
+/**
+ * @brief Throw away everything recorded so far
+ *
+ * Best called when the other core is not busy, since its ring is cleared under its feet.
+ */
+void piccolo_trace_clear(void) {
+    piccolo_trace_paused = true;
+    __dmb();
+    piccolo_trace_ring[0].head = 0;
+    piccolo_trace_ring[1].head = 0;
+    piccolo_trace_paused = false;
+}
+
+#else
+
+/**
+ * @brief Print the trace rings on stdio
+ *
+ * Tracing is compiled out (\ref PICCOLO_OS_TRACE is false), so there is nothing to print.
+ */
+void piccolo_trace_dump(void) {
+    printf("PICCOLO TRACE BEGIN\nPICCOLO TRACE END\n");
+}
+
+/**
+ * @brief Throw away everything recorded so far
+ *
+ * Tracing is compiled out, so there is nothing to throw away.
+ */
+void piccolo_trace_clear(void) {
+}
+
+#endif
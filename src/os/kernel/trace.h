@@ -0,0 +1,103 @@
+/**
+ * @file trace.h
+ * @brief Piccolo OS scheduler trace
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * With \ref PICCOLO_OS_TRACE each core records what its scheduler does in a ring of
+ * fixed size events. A core only ever writes to its own ring, so recording takes no
+ * lock, just a few cycles with interrupts masked. When a ring is full the oldest
+ * events are overwritten. `piccolo_trace_dump()` prints the rings, and `tools/trace_to_json.py`
+ * turns the dump into a Chrome trace (chrome://tracing or Perfetto).
+ *
+ * With \ref PICCOLO_OS_TRACE false, `PICCOLO_TRACE()` compiles to nothing.
+ */
+
+#ifndef PICCOLO_TRACE_H
+#define PICCOLO_TRACE_H
+
+#include "kernel.h"
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+
+/** @defgroup Intern The Piccolo Plus Internals
+ *
+ * @{
+ */
+
+/**
+ * @brief Trace event types. (`tools/trace_to_json.py` knows these numbers.)
+ *
+ */
+enum piccolo_trace_type {
+    PICCOLO_TRACE_SWITCH_IN = 1,        /**< task starts running. data: 1 if by the fast switch **/
+    PICCOLO_TRACE_SWITCH_OUT = 2,       /**< task stops running. data: its task flags, so why it stopped **/
+    PICCOLO_TRACE_SIGNAL_SEND = 3,      /**< signal sent. task: the receiver, data: the sender **/
+    PICCOLO_TRACE_TASK_CREATE = 4,      /**< task created. data: its stack size **/
+    PICCOLO_TRACE_TASK_END = 5,         /**< ended task removed by the scheduler **/
+    PICCOLO_TRACE_IDLE_ENTER = 6,       /**< core starts idling. data: the longest it will idle (us) **/
+    PICCOLO_TRACE_IDLE_EXIT = 7,        /**< core stops idling **/
+};
+
+/**
+ * @brief A trace event
+ *
+ */
+typedef struct {
+    uint32_t time;                      /**< low 32 bits of the microsecond timer **/
+    uint32_t type;                      /**< a \ref piccolo_trace_type **/
+    uint32_t task;                      /**< the task, or the core number when no task is involved **/
+    uint32_t data;                      /**< depends on the type **/
+} piccolo_trace_event_t;
+
+/**
+ * @brief One core's trace ring
+ *
+ */
+typedef struct {
+    uint32_t head;                      /**< count of events recorded. The next goes at head % size **/
+    piccolo_trace_event_t event[PICCOLO_OS_TRACE_EVENTS];   /**< the ring **/
+} piccolo_trace_ring_t;
+
+#if PICCOLO_OS_TRACE
+
+extern piccolo_trace_ring_t piccolo_trace_ring[2];
+extern volatile bool piccolo_trace_paused;
+
+/**
+ * @brief Record a trace event in this core's ring
+ *
+ * @param type what happened
+ * @param task the task it happened to
+ * @param data depends on the type
+ *
+ * Interrupts are masked so an interrupt handler on this core can't take the same slot.
+ */
+static inline void piccolo_trace(uint32_t type, uint32_t task, uint32_t data) {
+    piccolo_trace_ring_t *ring = &piccolo_trace_ring[get_core_num()];
+    piccolo_trace_event_t *event;
+    uint32_t irq;
+
+    if(piccolo_trace_paused) return;
+    irq = save_and_disable_interrupts();
+    event = &ring->event[ring->head++ % PICCOLO_OS_TRACE_EVENTS];
+    event->time = time_us_32();
+    event->type = type;
+    event->task = task;
+    event->data = data;
+    restore_interrupts(irq);
+}
+
+#define PICCOLO_TRACE(type, task, data) piccolo_trace((type), (uint32_t) (uintptr_t) (task), (uint32_t) (uintptr_t) (data))
+
+#else
+
+#define PICCOLO_TRACE(type, task, data) ((void) 0)
+
+#endif
+
+/**@}**/
+
+#endif
@@ -0,0 +1,159 @@
+/**
+ * @file work_queue.c
+ * @brief Piccolo OS deferred work queues
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Each core has a ring of work items and a worker task pinned to the core. Work is only ever posted to the
+ * queue of the core it is posted on, with interrupts disabled, so posts on a core never overlap, and never
+ * interrupt the worker halfway through reading an item's slot number. That makes the ring single producer
+ * and single consumer without a spin lock. The worker runs items until the ring is empty, then marks itself
+ * waiting and blocks on its signal channel. A post which finds it waiting signals it; the rest don't.
+ */
+
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#include "kernel.h"
+
+extern piccolo_os_internals_t piccolo_ctx;
+
+/**
+ * @brief A worker task: runs the deferred work of its core
+ *
+ * @param argument the core's \ref piccolo_os_work_queue_t
+ * \ingroup Intern
+ * An item's slot is freed only once its function has returned, so a post can't overwrite it while it runs.
+ * It never ends.
+ */
+static void __piccolo_work_run(void *argument) {
+    piccolo_os_work_queue_t *queue = (piccolo_os_work_queue_t *) argument;
+    piccolo_os_work_t *work;
+    uint32_t interrupts, tail;
+    bool empty;
+
+    while(1) {
+        tail = queue->tail;
+        if(tail != queue->head) {
+            // everything posted so far, as one batch
+            do {
+                work = &queue->item[tail % PICCOLO_OS_WORK_QUEUE_SIZE];
+                work->function(work->argument, work->payload);
+                queue->tail = ++tail;
+            } while(tail != queue->head);
+            queue->statistics.batches++;
+        }
+        interrupts = save_and_disable_interrupts();
+        empty = queue->tail == queue->head;
+        if(empty) queue->waiting = true;     // so the next post signals us
+        restore_interrupts(interrupts);
+        if(empty) piccolo_get_signal_all_blocking();
+    }
+}
+
+/**
+ * @brief Start the worker tasks, which run the deferred work
+ *
+ * @return true if every core which runs tasks has a worker, false if there is no room for one
+ *
+ * Until then, nothing can be posted. Call from a task, or before `piccolo_start()`. Calling it again does nothing.
+ */
+bool piccolo_work_start(void) {
+    piccolo_os_work_queue_t *queue;
+    piccolo_os_task_t *task;
+    uint32_t lock;
+
+    for(uint core = 0; core < (PICCOLO_OS_MULTICORE ? 2 : 1); core++) {
+        queue = &piccolo_ctx.work_queue[core];
+        while(1) {
+            lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+            task = queue->worker;
+            if(!task) queue->worker = (piccolo_os_task_t *) 1;  // ours to create
+            spin_unlock(piccolo_ctx.piccolo_lock, lock);
+            if(task != (piccolo_os_task_t *) 1) break;
+            piccolo_sleep(1);   // not yield, which would not let a creator of lower priority finish
+        }
+        if(task) continue;
+        task = piccolo_create_task_on(__piccolo_work_run, queue, PICCOLO_OS_WORK_STACK_SIZE, "work", 1u << core);
+        if(task) piccolo_set_priority(task, PICCOLO_OS_WORK_PRIORITY);
+        lock = spin_lock_blocking(piccolo_ctx.piccolo_lock);
+        queue->worker = task;
+        spin_unlock(piccolo_ctx.piccolo_lock, lock);
+        if(!task) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Have the worker task of this core run a function
+ *
+ * @param function the function, which is called with `argument` and a copy of the data
+ * @param argument for the function
+ * @param payload the data, copied into the work item, or NULL
+ * @param size bytes of data, at most \ref PICCOLO_OS_WORK_PAYLOAD
+ * @return true if the work was posted, false if the queue is full (the work is dropped, and counted),
+ * the data is too big, or there is no worker
+ *
+ * Never blocks. Safe to call from interrupt service handlers, tasks and timer callbacks. Work posted on a
+ * core runs in the order it was posted.
+ */
+bool piccolo_work_post(void (*function)(void *argument, const void *payload), void *argument, const void *payload,
+                       uint32_t size) {
+    piccolo_os_work_queue_t *queue;
+    piccolo_os_work_t *work;
+    uint32_t interrupts, queued;
+    bool posted = false, wake = false;
+
+    if(size > PICCOLO_OS_WORK_PAYLOAD) return false;
+    interrupts = save_and_disable_interrupts();
+    queue = &piccolo_ctx.work_queue[get_core_num()];
+    queued = queue->head - queue->tail;
+    if((uintptr_t) queue->worker <= 1) ;
+    else if(queued == PICCOLO_OS_WORK_QUEUE_SIZE) queue->statistics.dropped++;
+    else {
+        work = &queue->item[queue->head % PICCOLO_OS_WORK_QUEUE_SIZE];
+        work->function = function;
+        work->argument = argument;
+        if(size) memcpy(work->payload, payload, size);
+        __mem_fence_release();      // the item is complete before the worker can see it
+        queue->head++;
+        queue->statistics.posted++;
+        if(queued >= queue->statistics.most_queued) queue->statistics.most_queued = queued + 1;
+        wake = queue->waiting;
+        if(wake) {
+            queue->waiting = false;
+            queue->statistics.wakeups++;
+        }
+        posted = true;
+    }
+    restore_interrupts(interrupts);
+    if(wake) piccolo_send_signal(queue->worker);
+    return posted;
+}
+
+/**
+ * @brief Get the counters of a core's deferred work queue
+ *
+ * @param core the core (0 or 1)
+ * @param statistics where to copy them
+ */
+void piccolo_get_work_statistics(uint core, piccolo_os_work_statistics_t *statistics) {
+    *statistics = piccolo_ctx.work_queue[core & 1].statistics;
+}
+
+/**
+ * @brief Get the worker task of a core
+ *
+ * @param core the core (0 or 1)
+ * @return piccolo_os_task_t* the task which runs the core's deferred work, or NULL if there is none
+ *
+ * Its stack high water mark shows how much of \ref PICCOLO_OS_WORK_STACK_SIZE the work uses.
+ */
+piccolo_os_task_t *piccolo_work_worker(uint core) {
+    piccolo_os_task_t *task = piccolo_ctx.work_queue[core & 1].worker;
+
+    return (uintptr_t) task > 1 ? task : NULL;
+}
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Turn a Piccolo OS scheduler trace dump into a Chrome trace.
+
+Capture the serial console output of piccolo_trace_dump() to a file, then
+
+    tools/trace_to_json.py console.log > trace.json
+
+and open trace.json in chrome://tracing or https://ui.perfetto.dev. Each core
+is a thread: the tasks it ran are slices, idling is an "idle" slice, and
+blocking, signals, task creation and task ends are instant events.
+Anything in the file outside the BEGIN/END lines is ignored.
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+
+import json
+import sys
+
+# must match enum piccolo_trace_type in src/os/kernel/trace.h
+SWITCH_IN = 1
+SWITCH_OUT = 2
+SIGNAL_SEND = 3
+TASK_CREATE = 4
+TASK_END = 5
+IDLE_ENTER = 6
+IDLE_EXIT = 7
+
+# task flags, from kernel.h
+TASK_FLAGS = [
+    (0x02, "ended"),
+    (0x04, "sleeping"),
+    (0x08, "waiting for a signal"),
+    (0x10, "waiting to send a signal"),
+    (0x20, "waiting for events"),
+    (0x40, "waiting for a lock"),
+]
+
+
+def parse_dump(lines):
+    """Return the task names and each core's events from the last dump in lines."""
+    names, cores, core = {}, {}, None
+    inside = False
+    for line in lines:
+        fields = line.split()
+        if not fields:
+            continue
+        if line.startswith("PICCOLO TRACE BEGIN"):
+            names, cores, core, inside = {}, {}, None, True
+        elif line.startswith("PICCOLO TRACE END"):
+            inside = False
+        elif not inside:
+            continue
+        elif fields[0] == "task":
+            names[int(fields[1], 16)] = " ".join(fields[2:])
+        elif fields[0] == "core":
+            core = int(fields[1])
+            cores[core] = []
+        elif core is not None and len(fields) == 4:
+            cores[core].append(tuple(int(field, 16) for field in fields))
+    return names, cores
+
+
+def unwrap(events):
+    """Yield events with the 32 bit microsecond times made to count up past the wrap."""
+    high, last = 0, None
+    for time, event_type, task, data in events:
+        if last is not None and time < last:
+            high += 1 << 32
+        last = time
+        yield time + high, event_type, task, data
+
+
+def task_name(names, task):
+    if task <= 1:
+        return "core %d" % task
+    return names.get(task, "task %08x" % task)
+
+
+def why(flags):
+    reasons = [name for bit, name in TASK_FLAGS if flags & bit]
+    return ", ".join(reasons) if reasons else "preempted or yielded"
+
+
+def to_chrome(names, cores):
+    """Build the list of Chrome trace events."""
+    out = []
+    for core, events in sorted(cores.items()):
+        out.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": core,
+                    "args": {"name": "core %d" % core}})
+        running = None   # slice open on this core: (name, start)
+        for time, event_type, task, data in unwrap(events):
+            common = {"pid": 0, "tid": core, "ts": time}
+            if event_type in (SWITCH_IN, IDLE_ENTER):
+                if running:
+                    out.append(dict(common, name=running, ph="E"))
+                running = "idle" if event_type == IDLE_ENTER else task_name(names, task)
+                args = ({"max_us": data} if event_type == IDLE_ENTER
+                        else {"fast_switch": bool(data)})
+                out.append(dict(common, name=running, ph="B", args=args))
+            elif event_type in (SWITCH_OUT, IDLE_EXIT):
+                if running:
+                    out.append(dict(common, name=running, ph="E"))
+                    running = None
+                if event_type == SWITCH_OUT:
+                    out.append(dict(common, name="stop: " + why(data), ph="i", s="t",
+                                    args={"task": task_name(names, task),
+                                          "flags": "0x%02x" % data}))
+            elif event_type == SIGNAL_SEND:
+                out.append(dict(common, name="signal", ph="i", s="t",
+                                args={"to": task_name(names, task),
+                                      "from": task_name(names, data)}))
+            elif event_type == TASK_CREATE:
+                out.append(dict(common, name="create", ph="i", s="t",
+                                args={"task": task_name(names, task), "stack": data}))
+            elif event_type == TASK_END:
+                out.append(dict(common, name="end", ph="i", s="t",
+                                args={"task": task_name(names, task)}))
+        if running and events:
+            out.append({"name": running, "ph": "E", "pid": 0, "tid": core,
+                        "ts": out[-1]["ts"]})
+    return out
+
+
+def main():
+    if len(sys.argv) > 2:
+        sys.exit("usage: trace_to_json.py [dump file]")
+    source = open(sys.argv[1], errors="replace") if len(sys.argv) == 2 else sys.stdin
+    with source:
+        names, cores = parse_dump(source)
+    if not cores:
+        sys.exit("no PICCOLO TRACE dump found")
+    json.dump({"traceEvents": to_chrome(names, cores), "displayTimeUnit": "ms"},
+              sys.stdout, indent=1)
+    sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()